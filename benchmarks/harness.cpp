@@ -0,0 +1,139 @@
+#include "harness.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "step_kernel.hpp"
+
+namespace
+{
+std::string JsonString(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+std::string JsonNumber(double value)
+{
+    std::ostringstream out;
+    out << std::setprecision(6) << value;
+    return out.str();
+}
+
+double TimeBatch(uint64_t iterations, const std::function<void()> &body)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+        body();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+BenchmarkParam::BenchmarkParam(std::string name, const char *value)
+    : name(std::move(name)), json_value(JsonString(value)), text_value(value) {}
+BenchmarkParam::BenchmarkParam(std::string name, const std::string &value)
+    : name(std::move(name)), json_value(JsonString(value)), text_value(value) {}
+BenchmarkParam::BenchmarkParam(std::string name, int64_t value)
+    : name(std::move(name)), json_value(std::to_string(value)), text_value(std::to_string(value)) {}
+BenchmarkParam::BenchmarkParam(std::string name, double value)
+    : name(std::move(name)), json_value(JsonNumber(value)), text_value(JsonNumber(value)) {}
+
+BenchmarkRunner::BenchmarkRunner(BenchmarkConfig config) : config(std::move(config)) {}
+
+std::string BenchmarkRunner::FullName(const std::string &name, const std::vector<BenchmarkParam> &params)
+{
+    std::string full_name = name;
+    for (const BenchmarkParam &param : params)
+        full_name += "/" + param.name + "=" + param.text_value;
+    return full_name;
+}
+
+bool BenchmarkRunner::Selected(const std::string &name, const std::vector<BenchmarkParam> &params) const
+{
+    return FullName(name, params).find(config.filter) != std::string::npos;
+}
+
+void BenchmarkRunner::Run(const std::string &name, std::vector<BenchmarkParam> params, double items_per_iteration,
+                          double bytes_per_iteration, const std::function<void()> &body)
+{
+    if (!Selected(name, params))
+        return;
+
+    body(); // warm-up: page faults, lazy initialization, caches
+    uint64_t iterations = 1;
+    while (TimeBatch(iterations, body) < config.min_time && iterations < (uint64_t(1) << 40))
+        iterations *= 2;
+
+    std::vector<double> batch_seconds;
+    for (size_t r = 0; r < std::max<size_t>(config.repetitions, 1); ++r)
+        batch_seconds.push_back(TimeBatch(iterations, body));
+    std::sort(batch_seconds.begin(), batch_seconds.end());
+
+    BenchmarkResult result;
+    result.name = name;
+    result.params = std::move(params);
+    result.iterations = iterations;
+    result.median_ns = batch_seconds[batch_seconds.size() / 2] * 1e9 / iterations;
+    result.min_ns = batch_seconds.front() * 1e9 / iterations;
+    result.items_per_second = items_per_iteration * 1e9 / result.median_ns;
+    result.bytes_per_second = bytes_per_iteration * 1e9 / result.median_ns;
+
+    // Progress goes to stderr, so stdout stays valid JSON
+    std::cerr << FullName(result.name, result.params) << ": " << JsonNumber(result.median_ns / 1e6) << " ms";
+    if (items_per_iteration > 0)
+        std::cerr << ", " << JsonNumber(result.items_per_second) << " items/s";
+    if (bytes_per_iteration > 0)
+        std::cerr << ", " << JsonNumber(result.bytes_per_second / (1 << 20)) << " MiB/s";
+    std::cerr << std::endl;
+    results.push_back(std::move(result));
+}
+
+void BenchmarkRunner::WriteJson(std::ostream &out) const
+{
+    const std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    out << "{\n  \"context\": {\n";
+    out << "    \"date\": " << JsonString(date) << ",\n";
+    out << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "    \"step_backend\": " << JsonString(StepBackendName(ActiveStepBackend())) << ",\n";
+#if defined(__VERSION__)
+    out << "    \"compiler\": " << JsonString(__VERSION__) << ",\n";
+#endif
+#ifdef NDEBUG
+    out << "    \"assertions\": false,\n";
+#else
+    out << "    \"assertions\": true,\n";
+#endif
+    out << "    \"min_time\": " << JsonNumber(config.min_time) << ",\n";
+    out << "    \"repetitions\": " << config.repetitions << "\n  },\n";
+
+    out << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult &result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << JsonString(FullName(result.name, result.params))
+            << ", \"benchmark\": " << JsonString(result.name) << ", \"params\": {";
+        for (size_t p = 0; p < result.params.size(); ++p)
+            out << (p == 0 ? "" : ", ") << JsonString(result.params[p].name) << ": " << result.params[p].json_value;
+        out << "}, \"iterations\": " << result.iterations << ", \"median_ns\": " << JsonNumber(result.median_ns)
+            << ", \"min_ns\": " << JsonNumber(result.min_ns);
+        if (result.items_per_second > 0)
+            out << ", \"items_per_second\": " << JsonNumber(result.items_per_second);
+        if (result.bytes_per_second > 0)
+            out << ", \"bytes_per_second\": " << JsonNumber(result.bytes_per_second);
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One benchmark parameter, its value already rendered as JSON
+struct BenchmarkParam
+{
+    BenchmarkParam(std::string name, const char *value);
+    BenchmarkParam(std::string name, const std::string &value);
+    BenchmarkParam(std::string name, int64_t value);
+    BenchmarkParam(std::string name, double value);
+
+    std::string name;
+    std::string json_value;
+    std::string text_value; // for the benchmark's full name
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    std::vector<BenchmarkParam> params;
+    uint64_t iterations = 0; // per repetition
+    double median_ns = 0.0;  // per iteration, median over the repetitions
+    double min_ns = 0.0;
+    double items_per_second = 0.0; // from the median, 0 if the benchmark counts no items
+    double bytes_per_second = 0.0;
+};
+
+struct BenchmarkConfig
+{
+    std::string filter;     // run benchmarks whose full name contains this
+    double min_time = 0.5;  // seconds per repetition
+    size_t repetitions = 3; // timed repetitions; the median is reported
+};
+
+/**
+ * Minimal timing harness. Each benchmark runs once to warm up, then the iteration count is
+ * doubled until one batch takes min_time, and that batch is timed `repetitions` times.
+ * Results are collected and written as JSON, so runs can be diffed between releases.
+ */
+class BenchmarkRunner
+{
+public:
+    explicit BenchmarkRunner(BenchmarkConfig config);
+
+    // The full name is name/param=value/...; body runs one iteration. items_per_iteration and
+    // bytes_per_iteration turn the time into throughput figures (0 to omit).
+    void Run(const std::string &name, std::vector<BenchmarkParam> params, double items_per_iteration,
+             double bytes_per_iteration, const std::function<void()> &body);
+    // Whether Run() would run this benchmark, so callers can skip expensive setup
+    bool Selected(const std::string &name, const std::vector<BenchmarkParam> &params) const;
+
+    void WriteJson(std::ostream &out) const;
+
+private:
+    static std::string FullName(const std::string &name, const std::vector<BenchmarkParam> &params);
+
+    const BenchmarkConfig config;
+    std::vector<BenchmarkResult> results;
+};
+
+// Keeps the optimizer from dropping a computation whose result is otherwise unused
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
@@ -0,0 +1,455 @@
+// Microbenchmarks for the stepping kernels, grid serialization, entropy tracking, world state
+// initialization, end-to-end RPCs and the sync vs async server under mixed load. Writes JSON to
+// stdout (or --out=FILE); progress goes to stderr.
+//
+//   Benchmarks [--filter=SUBSTRING] [--min-time=SECONDS] [--repetitions=N] [--max-size=EDGE] [--out=FILE]
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <grpcpp/grpcpp.h>
+#include "sim_server.grpc.pb.h"
+#include "double_buffered_grid.hpp"
+#include "entropy_tracker.hpp"
+#include "grid_proto.hpp"
+#include "grid_region.hpp"
+#include "harness.hpp"
+#include "server.hpp"
+#include "temporal_blocking.hpp"
+#include "world_state.hpp"
+
+namespace
+{
+const size_t kEdges[] = {16, 32, 64, 128, 256, 512};
+const double kRuleDensities[] = {0.1, 0.5, 0.9};
+
+// Random rule with each of its 128 bits set with probability `density`
+Bitset128 RuleWithDensity(double density, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::bernoulli_distribution bit(density);
+    Bitset128 rule;
+    for (size_t i = 0; i < 128; ++i)
+        rule.set(i, bit(rng));
+    return rule;
+}
+
+BitPackedGrid3D RandomGrid(WorldStateContainer &states, size_t edge)
+{
+    return std::get<1>(*states.InitWorldStateRandom(edge, edge, edge, 1));
+}
+
+const char *ModeName(RuleMode mode)
+{
+    return mode == RULE_3D ? "3d" : "eca";
+}
+
+void BenchmarkStepping(BenchmarkRunner &runner, size_t max_edge)
+{
+    WorldStateContainer states;
+    for (size_t edge : kEdges)
+    {
+        if (edge > max_edge)
+            continue;
+        std::optional<BitPackedGrid3D> grid;
+        const double cells = static_cast<double>(edge * edge * edge);
+        for (RuleMode mode : {RULE_1D_ECA, RULE_3D})
+        {
+            for (double density : kRuleDensities)
+            {
+                const std::vector<BenchmarkParam> params = {{"edge", int64_t(edge)}, {"mode", ModeName(mode)}, {"rule_density", density}};
+                if (!runner.Selected("UpdateWorldState", params))
+                    continue;
+                if (!grid)
+                    grid = RandomGrid(states, edge);
+                const Bitset128 rule = RuleWithDensity(density, static_cast<uint32_t>(density * 1000));
+                runner.Run("UpdateWorldState", params, cells, cells / 8, [&]
+                           { DoNotOptimize(states.UpdateWorldState(*grid, rule, mode)); });
+            }
+        }
+
+        // One 3D step of the same noise stored row-major and in bricks
+        for (GridLayout layout : {GRID_LAYOUT_ROW_MAJOR, GRID_LAYOUT_BRICK})
+        {
+            const std::vector<BenchmarkParam> params = {{"edge", int64_t(edge)}, {"layout", layout == GRID_LAYOUT_BRICK ? "brick" : "row_major"}};
+            if (!runner.Selected("StepGrid", params))
+                continue;
+            if (!grid)
+                grid = RandomGrid(states, edge);
+            const BitPackedGrid3D current = grid->WithLayout(layout);
+            BitPackedGrid3D next(edge, edge, edge, layout);
+            const Bitset128 rule = RuleWithDensity(0.5, 500);
+            runner.Run("StepGrid", params, cells, cells / 8, [&]
+                       {
+                StepGrid(current, next, rule, RULE_3D);
+                DoNotOptimize(next); });
+        }
+
+        // Eight 3D steps one pass over memory each, and in passes of the planned number of steps
+        for (bool blocked : {false, true})
+        {
+            const uint64_t kSteps = 8;
+            const TemporalBlockingPlan plan = blocked ? PlanTemporalBlocking(BitPackedGrid3D(edge, edge, edge), kSteps) : TemporalBlockingPlan{};
+            const std::vector<BenchmarkParam> params = {{"edge", int64_t(edge)}, {"steps_per_pass", int64_t(plan.steps_per_pass)}};
+            if ((blocked && plan.steps_per_pass == 1) || !runner.Selected("StepGridBlocked", params))
+                continue;
+            if (!grid)
+                grid = RandomGrid(states, edge);
+            BitPackedGrid3D current = *grid;
+            BitPackedGrid3D scratch(edge, edge, edge);
+            const Bitset128 rule = RuleWithDensity(0.5, 500);
+            runner.Run("StepGridBlocked", params, cells * kSteps, cells * kSteps / 8, [&]
+                       {
+                StepGridBlocked(current, scratch, rule, RULE_3D, kSteps, plan);
+                DoNotOptimize(current); });
+        }
+
+        // In-place stepping of a stored state, from a single seed (mostly quiescent) and from noise
+        for (const char *start : {"seed", "random"})
+        {
+            const std::vector<BenchmarkParam> params = {{"edge", int64_t(edge)}, {"start", start}};
+            if (!runner.Selected("DoubleBufferedGrid.Step", params))
+                continue;
+            BitPackedGrid3D initial(edge, edge, edge);
+            if (std::string(start) == "seed")
+                initial.set(edge / 2, edge / 2, edge / 2, true);
+            else
+                initial = RandomGrid(states, edge);
+            DoubleBufferedGrid buffers(initial);
+            const Bitset128 rule = build_from_eca(90);
+            runner.Run("DoubleBufferedGrid.Step", params, cells, cells / 8, [&]
+                       {
+                buffers.Step(rule, RULE_3D);
+                // Restart before the seed's pattern fills the world
+                if (buffers.last_step_stats().blocks_skipped == 0 && std::string(start) == "seed")
+                    buffers.mutable_front() = initial; });
+        }
+    }
+}
+
+void BenchmarkSerialization(BenchmarkRunner &runner, size_t max_edge)
+{
+    WorldStateContainer states;
+    for (size_t edge : kEdges)
+    {
+        if (edge > std::min<size_t>(max_edge, 256)) // the nested encoding of 512^3 is 2 GiB of protobuf
+            continue;
+        const double cells = static_cast<double>(edge * edge * edge);
+        const std::vector<BenchmarkParam> params = {{"edge", int64_t(edge)}};
+        std::optional<BitPackedGrid3D> grid_storage;
+        auto grid_for = [&](const std::string &name, const std::vector<BenchmarkParam> &params) -> const BitPackedGrid3D *
+        {
+            if (!runner.Selected(name, params))
+                return nullptr;
+            if (!grid_storage)
+                grid_storage = RandomGrid(states, edge);
+            return &*grid_storage;
+        };
+
+        // Throughput in bytes of protobuf produced
+        if (const BitPackedGrid3D *grid = grid_for("ConvertGrid3DToProto", params))
+        {
+            sim_server::Vector3D nested;
+            ConvertGrid3DToProto(*grid, nested);
+            runner.Run("ConvertGrid3DToProto", params, cells, static_cast<double>(nested.ByteSizeLong()), [&]
+                       {
+                sim_server::Vector3D proto;
+                ConvertGrid3DToProto(*grid, proto);
+                DoNotOptimize(proto); });
+        }
+
+        if (const BitPackedGrid3D *grid = grid_for("ConvertGrid3DToPackedProto", params))
+        {
+            runner.Run("ConvertGrid3DToPackedProto", params, cells, cells / 8, [&]
+                       {
+                sim_server::PackedGrid proto;
+                ConvertGrid3DToPackedProto(*grid, proto);
+                DoNotOptimize(proto); });
+        }
+
+        // Views for display: one z-slice, and the whole grid as populations of 8^3 blocks
+        if (const BitPackedGrid3D *grid = grid_for("ExtractRegion.slice", params))
+        {
+            const GridBox slice{0, 0, edge / 2, edge, edge, 1};
+            runner.Run("ExtractRegion.slice", params, static_cast<double>(slice.cells()), static_cast<double>(slice.cells()) / 8, [&]
+                       { DoNotOptimize(ExtractRegion(*grid, slice)); });
+        }
+
+        if (const BitPackedGrid3D *grid = grid_for("CountBlockPopulations", params))
+        {
+            const GridBox whole{0, 0, 0, edge, edge, edge};
+            runner.Run("CountBlockPopulations", params, cells, cells / 8, [&]
+                       { DoNotOptimize(CountBlockPopulations(*grid, whole, 8)); });
+        }
+
+        // What a handler does for a response: encode the grid, then protobuf writes the wire bytes
+        for (sim_server::GridEncoding encoding : {sim_server::GRID_ENCODING_NESTED, sim_server::GRID_ENCODING_PACKED})
+        {
+            std::vector<BenchmarkParam> response_params = params;
+            response_params.emplace_back("encoding", encoding == sim_server::GRID_ENCODING_PACKED ? "packed" : "nested");
+            const BitPackedGrid3D *grid = grid_for("SerializeResponse", response_params);
+            if (grid == nullptr)
+                continue;
+            sim_server::WorldStateResponse sample;
+            SerializeGrid(*grid, encoding, sample);
+            runner.Run("SerializeResponse", response_params, cells, static_cast<double>(sample.ByteSizeLong()), [&]
+                       {
+                sim_server::WorldStateResponse response;
+                SerializeGrid(*grid, encoding, response);
+                std::string wire;
+                response.SerializeToString(&wire);
+                DoNotOptimize(wire); });
+        }
+    }
+}
+
+void BenchmarkEntropyAndInit(BenchmarkRunner &runner, size_t max_edge)
+{
+    WorldStateContainer states;
+    for (size_t edge : {size_t(64), size_t(256)})
+    {
+        if (edge > max_edge)
+            continue;
+        const double cells = static_cast<double>(edge * edge * edge);
+        const std::vector<BenchmarkParam> params = {{"edge", int64_t(edge)}};
+
+        if (runner.Selected("EntropyTracker.observe", params) || runner.Selected("BlockPatternEntropy", params))
+        {
+            const BitPackedGrid3D grid = RandomGrid(states, edge);
+            EntropyTracker tracker;
+            // Every observation hashes the whole grid; counting is O(1)
+            runner.Run("EntropyTracker.observe", params, 1, cells / 8, [&]
+                       { tracker.observe(grid); });
+            runner.Run("BlockPatternEntropy", params, cells, cells / 8, [&]
+                       { DoNotOptimize(BlockPatternEntropy(grid)); });
+        }
+
+        // 0.5 takes one random word per grid word, 0.3 (rounded to 16 bits) takes all sixteen
+        for (double density : {0.5, 0.3})
+        {
+            const std::vector<BenchmarkParam> density_params = {{"edge", int64_t(edge)}, {"density", density}};
+            runner.Run("InitWorldStateRandom", density_params, cells, cells / 8, [&]
+                       { DoNotOptimize(states.InitWorldStateRandom(edge, edge, edge, 1, density)); });
+        }
+    }
+}
+
+// StartSimulation through an in-process channel: request parsing, stepping and both grids' serialization
+void BenchmarkEndToEnd(BenchmarkRunner &runner)
+{
+    std::unique_ptr<ServerHandle> server;
+    std::unique_ptr<sim_server::StateService::Stub> stub;
+
+    for (size_t edge : {size_t(32), size_t(64)})
+    {
+        for (sim_server::GridEncoding encoding : {sim_server::GRID_ENCODING_NESTED, sim_server::GRID_ENCODING_PACKED})
+        {
+            const int64_t num_steps = 100;
+            const std::vector<BenchmarkParam> params = {
+                {"edge", int64_t(edge)}, {"steps", num_steps}, {"encoding", encoding == sim_server::GRID_ENCODING_PACKED ? "packed" : "nested"}};
+            if (!runner.Selected("StartSimulation", params))
+                continue;
+            if (!server)
+            {
+                ServerOptions options;
+                options.address = ""; // in-process only
+                auto started = StartServer(options);
+                if (!started)
+                {
+                    std::cerr << "Skipping end-to-end benchmarks: " << started.error() << std::endl;
+                    return;
+                }
+                server = std::move(*started);
+                stub = sim_server::StateService::NewStub(server->InProcessChannel());
+            }
+
+            sim_server::StartSimulationRequest request;
+            request.mutable_init_req()->mutable_dimensions()->set_x_max(edge);
+            request.mutable_init_req()->mutable_dimensions()->set_y_max(edge);
+            request.mutable_init_req()->mutable_dimensions()->set_z_max(edge);
+            const Bitset128 rule = RuleWithDensity(0.5, 1);
+            std::string rule_bytes(16, '\0');
+            for (size_t bit = 0; bit < 128; ++bit)
+                if (rule.test(bit))
+                    rule_bytes[bit / 8] = static_cast<char>(rule_bytes[bit / 8] | (1 << (bit % 8)));
+            request.mutable_step_req()->set_rule(rule_bytes);
+            request.mutable_step_req()->set_num_steps(num_steps);
+            request.set_encoding(encoding);
+
+            const double cell_steps = static_cast<double>(edge * edge * edge * num_steps);
+            runner.Run("StartSimulation", params, cell_steps, 0, [&]
+                       {
+                grpc::ClientContext context;
+                sim_server::SimulationResultResponse reply;
+                const grpc::Status status = stub->StartSimulation(&context, request, &reply);
+                if (!status.ok())
+                {
+                    std::cerr << "StartSimulation failed: " << status.error_message() << std::endl;
+                    std::exit(1);
+                } });
+        }
+    }
+}
+
+// Heavy StepWorldStateForward calls on large states alongside light FetchWorldState calls on a small one, from
+// concurrent clients, against the sync and the async server: the async server should keep the light calls
+// flowing while the heavy ones occupy its compute threads
+void BenchmarkMixedLoad(BenchmarkRunner &runner)
+{
+    const size_t kHeavyClients = 2;
+    const size_t kLightClients = 6;
+    const size_t kRequestsPerClient = 4;
+    const size_t kHeavyEdge = 64;
+    const int64_t kHeavySteps = 20;
+
+    for (ServerMode mode : {SERVER_MODE_SYNC, SERVER_MODE_ASYNC})
+    {
+        const std::vector<BenchmarkParam> params = {{"server", mode == SERVER_MODE_ASYNC ? "async" : "sync"},
+                                                    {"heavy_clients", int64_t(kHeavyClients)},
+                                                    {"light_clients", int64_t(kLightClients)}};
+        if (!runner.Selected("MixedLoad", params))
+            continue;
+
+        ServerOptions options;
+        options.address = ""; // in-process only
+        options.mode = mode;
+        auto started = StartServer(options);
+        if (!started)
+        {
+            std::cerr << "Skipping mixed-load benchmark: " << started.error() << std::endl;
+            continue;
+        }
+        std::unique_ptr<ServerHandle> server = std::move(*started);
+        std::unique_ptr<sim_server::StateService::Stub> stub = sim_server::StateService::NewStub(server->InProcessChannel());
+
+        auto init_state = [&](size_t edge) -> int64_t
+        {
+            sim_server::InitializeRequest request;
+            request.mutable_dimensions()->set_x_max(edge);
+            request.mutable_dimensions()->set_y_max(edge);
+            request.mutable_dimensions()->set_z_max(edge);
+            request.set_pattern(sim_server::INIT_PATTERN_RANDOM);
+            grpc::ClientContext context;
+            sim_server::WorldStateResponse reply;
+            const grpc::Status status = stub->InitWorldState(&context, request, &reply);
+            if (!status.ok())
+            {
+                std::cerr << "InitWorldState failed: " << status.error_message() << std::endl;
+                std::exit(1);
+            }
+            return reply.metadata().state_id();
+        };
+        // Heavy clients step a state each, so they contend for threads rather than for one state's lock
+        std::vector<int64_t> heavy_ids;
+        for (size_t i = 0; i < kHeavyClients; ++i)
+            heavy_ids.push_back(init_state(kHeavyEdge));
+        const int64_t light_id = init_state(32);
+
+        auto check = [](const grpc::Status &status, const char *rpc)
+        {
+            if (!status.ok())
+            {
+                std::cerr << rpc << " failed: " << status.error_message() << std::endl;
+                std::exit(1);
+            }
+        };
+        auto heavy_client = [&](int64_t id)
+        {
+            sim_server::StepRequest request;
+            request.set_world_state_id(id);
+            request.set_rule(SerializeBitSetRuleToString(RuleWithDensity(0.5, 1)));
+            request.set_num_steps(kHeavySteps);
+            request.set_encoding(sim_server::GRID_ENCODING_PACKED);
+            for (size_t i = 0; i < kRequestsPerClient; ++i)
+            {
+                grpc::ClientContext context;
+                sim_server::WorldStateResponse reply;
+                check(stub->StepWorldStateForward(&context, request, &reply), "StepWorldStateForward");
+            }
+        };
+        auto light_client = [&]
+        {
+            sim_server::FetchWorldStateRequest request;
+            request.set_world_state_id(light_id);
+            request.mutable_region()->set_size_x(8);
+            request.mutable_region()->set_size_y(8);
+            request.mutable_region()->set_size_z(8);
+            request.set_encoding(sim_server::GRID_ENCODING_PACKED);
+            for (size_t i = 0; i < kRequestsPerClient; ++i)
+            {
+                grpc::ClientContext context;
+                sim_server::FetchWorldStateResponse reply;
+                check(stub->FetchWorldState(&context, request, &reply), "FetchWorldState");
+            }
+        };
+
+        // Items are RPCs of either kind
+        const double requests = static_cast<double>((kHeavyClients + kLightClients) * kRequestsPerClient);
+        runner.Run("MixedLoad", params, requests, 0, [&]
+                   {
+            std::vector<std::thread> clients;
+            for (int64_t id : heavy_ids)
+                clients.emplace_back(heavy_client, id);
+            for (size_t i = 0; i < kLightClients; ++i)
+                clients.emplace_back(light_client);
+            for (std::thread &client : clients)
+                client.join(); });
+    }
+}
+
+bool ParseFlag(const std::string &arg, const std::string &name, std::string &value)
+{
+    const std::string prefix = "--" + name + "=";
+    if (arg.rfind(prefix, 0) != 0)
+        return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchmarkConfig config;
+    size_t max_edge = 512;
+    std::string out_path;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        std::string value;
+        if (ParseFlag(arg, "filter", value))
+            config.filter = value;
+        else if (ParseFlag(arg, "min-time", value))
+            config.min_time = std::stod(value);
+        else if (ParseFlag(arg, "repetitions", value))
+            config.repetitions = std::stoul(value);
+        else if (ParseFlag(arg, "max-size", value))
+            max_edge = std::stoul(value);
+        else if (ParseFlag(arg, "out", value))
+            out_path = value;
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    BenchmarkRunner runner(config);
+    BenchmarkStepping(runner, max_edge);
+    BenchmarkSerialization(runner, max_edge);
+    BenchmarkEntropyAndInit(runner, max_edge);
+    BenchmarkEndToEnd(runner);
+    BenchmarkMixedLoad(runner);
+
+    if (out_path.empty())
+    {
+        runner.WriteJson(std::cout);
+        return 0;
+    }
+    std::ofstream out(out_path);
+    runner.WriteJson(out);
+    return out ? 0 : 1;
+}
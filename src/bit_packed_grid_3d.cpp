@@ -1,10 +1,115 @@
 #include "bit_packed_grid_3d.hpp"
 
+#include <algorithm>
+#include <bitset>
+
+namespace
+{
+bool IsPowerOfTwo(size_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+size_t Log2(size_t power_of_two)
+{
+    size_t bits = 0;
+    while ((size_t(1) << bits) < power_of_two)
+        ++bits;
+    return bits;
+}
+
+// Bit of a brick's cell within its word
+size_t BrickBit(size_t x, size_t y, size_t z)
+{
+    return (x & 3) * 16 + (y & 3) * 4 + (z & 3);
+}
+
+// Bits [bit, bit + n) of src as the low n bits, 1 <= n <= 64. Reads no word past the last bit.
+uint64_t ReadBits(const uint64_t *src, size_t bit, size_t n)
+{
+    const size_t word = bit / 64;
+    const size_t shift = bit % 64;
+    uint64_t value = src[word] >> shift;
+    if (shift != 0 && shift + n > 64)
+        value |= src[word + 1] << (64 - shift);
+    return n == 64 ? value : value & ((uint64_t(1) << n) - 1);
+}
+} // namespace
+
+BrickOrder::BrickOrder(size_t bricks_x, size_t bricks_y, size_t bricks_z)
+    : bricks_x(bricks_x), bricks_y(bricks_y), bricks_z(bricks_z),
+      spread_x(bricks_x, 0), spread_y(bricks_y, 0), spread_z(bricks_z, 0)
+{
+    const size_t axis_bits[3] = {Log2(bricks_x), Log2(bricks_y), Log2(bricks_z)};
+    std::vector<size_t> *spreads[3] = {&spread_x, &spread_y, &spread_z};
+
+    // Word index bit -> (axis, coordinate bit), z first
+    std::vector<std::pair<size_t, size_t>> word_bits;
+    for (size_t level = 0; level < std::max({axis_bits[0], axis_bits[1], axis_bits[2]}); ++level)
+    {
+        for (size_t axis : {2, 1, 0})
+        {
+            if (level < axis_bits[axis])
+                word_bits.emplace_back(axis, level);
+        }
+    }
+
+    for (size_t bit = 0; bit < word_bits.size(); ++bit)
+    {
+        const auto [axis, level] = word_bits[bit];
+        std::vector<size_t> &spread = *spreads[axis];
+        for (size_t coordinate = 0; coordinate < spread.size(); ++coordinate)
+            spread[coordinate] |= ((coordinate >> level) & 1) << bit;
+    }
+
+    const size_t num_bytes = (word_bits.size() + 7) / 8;
+    byte_decode.assign(num_bytes * 256, {0, 0, 0});
+    for (size_t k = 0; k < num_bytes; ++k)
+    {
+        for (size_t byte = 0; byte < 256; ++byte)
+        {
+            std::array<uint32_t, 3> &coordinates = byte_decode[k * 256 + byte];
+            for (size_t b = 0; b < 8 && k * 8 + b < word_bits.size(); ++b)
+            {
+                const auto [axis, level] = word_bits[k * 8 + b];
+                coordinates[axis] |= static_cast<uint32_t>((byte >> b) & 1) << level;
+            }
+        }
+    }
+}
+
+void BrickOrder::Brick(size_t word, size_t &bx, size_t &by, size_t &bz) const
+{
+    uint32_t coordinates[3] = {0, 0, 0};
+    for (size_t k = 0; k * 256 < byte_decode.size(); ++k)
+    {
+        const std::array<uint32_t, 3> &part = byte_decode[k * 256 + ((word >> (k * 8)) & 0xFF)];
+        coordinates[0] |= part[0];
+        coordinates[1] |= part[1];
+        coordinates[2] |= part[2];
+    }
+    bx = coordinates[0];
+    by = coordinates[1];
+    bz = coordinates[2];
+}
+
 const std::vector<uint64_t> &BitPackedGrid3D::raw() const { return data; }
+std::vector<uint64_t> &BitPackedGrid3D::raw() { return data; }
 
-BitPackedGrid3D::BitPackedGrid3D(size_t x, size_t y, size_t z)
+BitPackedGrid3D::BitPackedGrid3D(size_t x, size_t y, size_t z, GridLayout layout)
     : x_max(x), y_max(y), z_max(z),
-      data(((x * y * z) + 63) / 64, 0) {}
+      data(((x * y * z) + 63) / 64, 0), grid_layout(layout)
+{
+    if (layout == GRID_LAYOUT_BRICK)
+        bricks = std::make_shared<const BrickOrder>(x / 4, y / 4, z / 4);
+}
+
+bool BitPackedGrid3D::SupportsLayout(GridLayout layout, size_t x, size_t y, size_t z)
+{
+    if (layout == GRID_LAYOUT_ROW_MAJOR)
+        return true;
+    return IsPowerOfTwo(x) && IsPowerOfTwo(y) && IsPowerOfTwo(z) && x >= 4 && y >= 4 && z >= 4;
+}
 
 void BitPackedGrid3D::set(size_t x, size_t y, size_t z, bool value)
 {
@@ -44,6 +149,8 @@ bool BitPackedGrid3D::get(size_t idx) const
 
 size_t BitPackedGrid3D::index(size_t x, size_t y, size_t z) const
 {
+    if (bricks)
+        return bricks->Word(x / 4, y / 4, z / 4) * 64 + BrickBit(x, y, z);
     return x * y_max * z_max + y * z_max + z;
 }
 
@@ -51,6 +158,13 @@ size_t BitPackedGrid3D::index(size_t x, size_t y, size_t z) const
 // auto [x, y, z] = unpack_bit_index(index, y_max, z_max);
 std::tuple<size_t, size_t, size_t> BitPackedGrid3D::unpack_bit_index(size_t index) const
 {
+    if (bricks)
+    {
+        size_t bx, by, bz;
+        bricks->Brick(index / 64, bx, by, bz);
+        const size_t bit = index % 64;
+        return {bx * 4 + bit / 16, by * 4 + (bit / 4) % 4, bz * 4 + bit % 4};
+    }
     size_t x = index / (y_max * z_max);
     size_t rem = index % (y_max * z_max);
     size_t y = rem / z_max;
@@ -63,6 +177,54 @@ size_t BitPackedGrid3D::size_in_bits() const
     return x_max * y_max * z_max;
 }
 
+size_t BitPackedGrid3D::population() const
+{
+    size_t count = 0;
+    for (uint64_t word : data)
+        count += std::bitset<64>(word).count(); // padding bits are 0
+    return count;
+}
+
+GridLayout BitPackedGrid3D::layout() const
+{
+    return grid_layout;
+}
+
+const BrickOrder *BitPackedGrid3D::brick_order() const
+{
+    return bricks.get();
+}
+
+BitPackedGrid3D BitPackedGrid3D::WithLayout(GridLayout layout) const
+{
+    if (layout == grid_layout)
+        return *this;
+
+    // Whole bricks at a time: a brick's z-rows are 4-bit runs in both layouts, since z_max is a multiple of 4
+    BitPackedGrid3D converted(x_max, y_max, z_max, layout);
+    const bool to_brick = layout == GRID_LAYOUT_BRICK;
+    const BrickOrder &order = to_brick ? *converted.bricks : *bricks;
+    const std::vector<uint64_t> &from = data;
+    std::vector<uint64_t> &to = converted.data;
+    for (size_t bx = 0; bx < order.bricks_x; ++bx)
+        for (size_t by = 0; by < order.bricks_y; ++by)
+            for (size_t bz = 0; bz < order.bricks_z; ++bz)
+            {
+                const size_t word = order.Word(bx, by, bz);
+                for (size_t x = 0; x < 4; ++x)
+                    for (size_t y = 0; y < 4; ++y)
+                    {
+                        const size_t row = (bx * 4 + x) * y_max * z_max + (by * 4 + y) * z_max + bz * 4;
+                        const size_t brick_bit = x * 16 + y * 4;
+                        if (to_brick)
+                            to[word] |= ((from[row / 64] >> (row % 64)) & 0xF) << brick_bit;
+                        else
+                            to[row / 64] |= ((from[word] >> brick_bit) & 0xF) << (row % 64);
+                    }
+            }
+    return converted;
+}
+
 std::vector<uint64_t>::iterator BitPackedGrid3D::begin()
 {
     return data.begin();
@@ -87,6 +249,24 @@ bool BitPackedGrid3D::operator==(const BitPackedGrid3D &other) const
 {
     if (x_max != other.x_max || y_max != other.y_max || z_max != other.z_max)
         return false;
+    if (grid_layout != other.grid_layout)
+        return *this == other.WithLayout(grid_layout);
 
     return std::equal(data.begin(), data.end(), other.data.begin());
-}
\ No newline at end of file
+}
+
+void CopyBits(const uint64_t *src, size_t src_bit, uint64_t *dst, size_t dst_bit, size_t count)
+{
+    // One destination word per iteration; only the first and last can be partial
+    while (count > 0)
+    {
+        const size_t word = dst_bit / 64;
+        const size_t shift = dst_bit % 64;
+        const size_t n = std::min(count, 64 - shift);
+        const uint64_t mask = (n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1) << shift;
+        dst[word] = (dst[word] & ~mask) | (ReadBits(src, src_bit, n) << shift);
+        src_bit += n;
+        dst_bit += n;
+        count -= n;
+    }
+}
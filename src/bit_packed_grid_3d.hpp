@@ -1,37 +1,92 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <tuple>
+
+enum GridLayout
+{
+    GRID_LAYOUT_ROW_MAJOR, // cell x * y_max * z_max + y * z_max + z, 64 consecutive cells per word
+    GRID_LAYOUT_BRICK      // one 4x4x4 brick per word, bricks in Morton order (see BrickOrder)
+};
+
+/**
+ * Order of the bricks of a brick layout grid. Brick (bx, by, bz) is stored in word
+ * spread_x[bx] | spread_y[by] | spread_z[bz]: the bits of the brick coordinates are
+ * interleaved z, y, x from the least significant end, and once an axis runs out of bits the
+ * others carry on. With power-of-two brick counts the words are dense, and every aligned run
+ * of 8^k words is a cube of bricks.
+ *
+ * Within a brick, cell (x, y, z) is bit (x % 4) * 16 + (y % 4) * 4 + z % 4, so each of its six
+ * neighbours is either in the same word or in the adjacent brick along that axis.
+ */
+struct BrickOrder
+{
+    BrickOrder(size_t bricks_x, size_t bricks_y, size_t bricks_z);
+
+    size_t Word(size_t bx, size_t by, size_t bz) const { return spread_x[bx] | spread_y[by] | spread_z[bz]; }
+    // Inverse of Word()
+    void Brick(size_t word, size_t &bx, size_t &by, size_t &bz) const;
+
+    size_t bricks_x, bricks_y, bricks_z;
+    std::vector<size_t> spread_x, spread_y, spread_z;
+
+private:
+    // Brick coordinates contributed by byte k of a word index, at [k * 256 + byte]
+    std::vector<std::array<uint32_t, 3>> byte_decode;
+};
 
 class BitPackedGrid3D
 {
 public:
-    BitPackedGrid3D(size_t x, size_t y, size_t z);
+    // Brick layouts require SupportsLayout(layout, x, y, z).
+    BitPackedGrid3D(size_t x, size_t y, size_t z, GridLayout layout = GRID_LAYOUT_ROW_MAJOR);
     BitPackedGrid3D(const BitPackedGrid3D &) = default;
     BitPackedGrid3D &operator=(const BitPackedGrid3D &) = default;
     BitPackedGrid3D(BitPackedGrid3D &&) = default;
     BitPackedGrid3D &operator=(BitPackedGrid3D &&) = default;
 
+    // Brick layouts need every dimension to be a power of two and at least 4.
+    static bool SupportsLayout(GridLayout layout, size_t x, size_t y, size_t z);
+
     void set(size_t x, size_t y, size_t z, bool value);
     bool get(size_t x, size_t y, size_t z) const;
     void set(size_t idx, bool value);
     bool get(size_t idx) const;
 
+    // Bit index of a cell in the grid's layout
     size_t index(size_t x, size_t y, size_t z) const;
     std::tuple<size_t, size_t, size_t> unpack_bit_index(size_t index) const;
     size_t size_in_bits() const;
+    // Number of live cells
+    size_t population() const;
+
+    GridLayout layout() const;
+    // Null unless the layout is GRID_LAYOUT_BRICK
+    const BrickOrder *brick_order() const;
+    // The same cells stored in another layout, e.g. row-major for the wire
+    BitPackedGrid3D WithLayout(GridLayout layout) const;
 
     std::vector<uint64_t>::iterator begin();
     std::vector<uint64_t>::iterator end();
     std::vector<uint64_t>::const_iterator begin() const;
     std::vector<uint64_t>::const_iterator end() const;
 
+    // Compares cells, whatever the two grids' layouts
     bool operator==(const BitPackedGrid3D &other) const;
 
     size_t x_max, y_max, z_max;
 
     const std::vector<uint64_t> &raw() const;
+    std::vector<uint64_t> &raw();
 
 private:
     std::vector<uint64_t> data;
-};
\ No newline at end of file
+    GridLayout grid_layout;
+    std::shared_ptr<const BrickOrder> bricks; // shared by copies, set for brick layouts
+};
+
+// Copies `count` bits starting at bit src_bit of src to bit dst_bit of dst, leaving dst's other bits as they are.
+void CopyBits(const uint64_t *src, size_t src_bit, uint64_t *dst, size_t dst_bit, size_t count);
@@ -0,0 +1,301 @@
+#include "cluster.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <grpcpp/grpcpp.h>
+#include "sim_server.grpc.pb.h"
+#include "frame_pacer.hpp"
+#include "grid_proto.hpp"
+#include "grid_region.hpp"
+#include "slab_decomposition.hpp"
+
+using grpc::Status;
+using sim_server::WorkerService;
+
+namespace
+{
+std::shared_ptr<grpc::Channel> CreateWorkerChannel(const std::string &address)
+{
+    // Slabs and planes are as large as the grid's y-z extent times the slabs sent, well past gRPC's 4 MiB default
+    grpc::ChannelArguments arguments;
+    arguments.SetMaxReceiveMessageSize(INT_MAX);
+    arguments.SetMaxSendMessageSize(INT_MAX);
+    return grpc::CreateCustomChannel(address, grpc::InsecureChannelCredentials(), arguments);
+}
+
+// How often a worker waiting for a plane checks whether the coordinator gave up on the job
+constexpr std::chrono::milliseconds kCancelPollInterval{100};
+
+// Planes travel as ExchangeHalo calls, one writer thread per side, so a step's two planes are sent
+// while the worker steps its interior; planes sent to the worker land in its mailbox
+class GrpcHaloTransport final : public HaloTransport
+{
+public:
+    GrpcHaloTransport(uint64_t job_id, std::shared_ptr<WorkerService::Stub> low, std::shared_ptr<WorkerService::Stub> high,
+                      HaloMailbox &mailbox, std::chrono::milliseconds timeout, grpc::ServerContext &context)
+        : job_id(job_id), mailbox(mailbox), timeout(timeout), context(context), low_sink(WriteTo(std::move(low), timeout)),
+          high_sink(WriteTo(std::move(high), timeout)) {}
+
+    bool Send(HaloSide to, uint64_t step, std::vector<uint64_t> plane) override
+    {
+        sim_server::HaloPlane message;
+        message.set_job_id(job_id);
+        message.set_step(step);
+        // The plane on our low side is the slab after the neighbour's range, and vice versa
+        message.set_side(to == HALO_SIDE_LOW ? sim_server::HaloPlane::SIDE_HIGH : sim_server::HaloPlane::SIDE_LOW);
+        PackWords(plane, *message.mutable_words());
+        return (to == HALO_SIDE_LOW ? low_sink : high_sink).Send(std::move(message));
+    }
+
+    // The coordinator cancels the job when another worker fails, so waiting stops before the timeout
+    tl::expected<std::vector<uint64_t>, std::string> Receive(HaloSide side, uint64_t step) override
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;)
+        {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            auto plane = mailbox.Take(side, step, std::max(std::chrono::milliseconds(0), std::min(left, kCancelPollInterval)));
+            if (plane || left <= kCancelPollInterval)
+                return plane;
+            if (context.IsCancelled())
+                return tl::unexpected(std::string("The coordinator cancelled the job"));
+        }
+    }
+
+    bool Flush() override
+    {
+        const bool low_ok = low_sink.Flush();
+        const bool high_ok = high_sink.Flush();
+        return low_ok && high_ok;
+    }
+
+private:
+    static ThreadedFrameSink<sim_server::HaloPlane>::WriteFn WriteTo(std::shared_ptr<WorkerService::Stub> stub,
+                                                                     std::chrono::milliseconds timeout)
+    {
+        return [stub = std::move(stub), timeout](const sim_server::HaloPlane &plane)
+        {
+            grpc::ClientContext context;
+            context.set_deadline(std::chrono::system_clock::now() + timeout);
+            sim_server::HaloPlaneResponse response;
+            return stub->ExchangeHalo(&context, plane, &response).ok();
+        };
+    }
+
+    const uint64_t job_id;
+    HaloMailbox &mailbox;
+    const std::chrono::milliseconds timeout;
+    grpc::ServerContext &context;
+    ThreadedFrameSink<sim_server::HaloPlane> low_sink;
+    ThreadedFrameSink<sim_server::HaloPlane> high_sink;
+};
+
+class WorkerServiceImpl final : public WorkerService::Service
+{
+public:
+    Status StepSlab(grpc::ServerContext *context, const sim_server::StepSlabRequest *request,
+                    sim_server::StepSlabResponse *reply) override
+    {
+        auto slab = ConvertPackedProtoToGrid3D(request->slab());
+        if (!slab)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, slab.error());
+        }
+        if (slab->size_in_bits() == 0)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "The slab is empty");
+        }
+        if (request->rule().size() != 16)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "Expected 16 bytes for the 128-bit rule");
+        }
+
+        const uint64_t job_id = request->job_id();
+        std::shared_ptr<HaloMailbox> mailbox = Mailbox(job_id);
+        if (!mailbox)
+        {
+            return Status(grpc::StatusCode::ALREADY_EXISTS, "Job " + std::to_string(job_id) + " already ran on this worker");
+        }
+        SlabStepper stepper(*slab);
+        tl::expected<void, std::string> stepped;
+        {
+            GrpcHaloTransport transport(job_id, Stub(request->low_neighbor()), Stub(request->high_neighbor()), *mailbox,
+                                        std::chrono::milliseconds(request->halo_timeout_ms()), *context);
+            stepped = stepper.Advance(ParseBitSetRuleFromString(request->rule()), request->rule_3d() ? RULE_3D : RULE_1D_ECA,
+                                      request->num_steps(), transport);
+        }
+        FinishJob(job_id);
+        if (!stepped)
+        {
+            return Status(grpc::StatusCode::ABORTED, stepped.error());
+        }
+        ConvertGrid3DToPackedProto(stepper.Owned(), *reply->mutable_slab());
+        return Status::OK;
+    }
+
+    Status ExchangeHalo(grpc::ServerContext *context, const sim_server::HaloPlane *request,
+                        sim_server::HaloPlaneResponse *reply) override
+    {
+        auto words = UnpackWords(request->words());
+        if (!words)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, words.error());
+        }
+        // Planes of finished jobs are dropped: the job failed and its neighbours are still catching up
+        if (std::shared_ptr<HaloMailbox> mailbox = Mailbox(request->job_id()))
+            mailbox->Deliver(request->side() == sim_server::HaloPlane::SIDE_LOW ? HALO_SIDE_LOW : HALO_SIDE_HIGH,
+                             request->step(), std::move(*words));
+        return Status::OK;
+    }
+
+private:
+    static constexpr size_t kFinishedJobsKept = 256;
+
+    // The mailbox of a job, created by its StepSlab call or by a neighbour's plane, whichever comes
+    // first. nullptr for recently finished jobs.
+    std::shared_ptr<HaloMailbox> Mailbox(uint64_t job_id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::find(finished_jobs.begin(), finished_jobs.end(), job_id) != finished_jobs.end())
+            return nullptr;
+        std::shared_ptr<HaloMailbox> &mailbox = mailboxes[job_id];
+        if (!mailbox)
+            mailbox = std::make_shared<HaloMailbox>();
+        return mailbox;
+    }
+
+    void FinishJob(uint64_t job_id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        mailboxes.erase(job_id);
+        finished_jobs.push_back(job_id);
+        if (finished_jobs.size() > kFinishedJobsKept)
+            finished_jobs.pop_front();
+    }
+
+    // Channels to the neighbours are opened once and shared by all jobs
+    std::shared_ptr<WorkerService::Stub> Stub(const std::string &address)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<WorkerService::Stub> &stub = stubs[address];
+        if (!stub)
+            stub = WorkerService::NewStub(CreateWorkerChannel(address));
+        return stub;
+    }
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<HaloMailbox>> mailboxes;
+    std::deque<uint64_t> finished_jobs;
+    std::unordered_map<std::string, std::shared_ptr<WorkerService::Stub>> stubs;
+};
+} // namespace
+
+std::unique_ptr<grpc::Service> MakeWorkerService()
+{
+    return std::make_unique<WorkerServiceImpl>();
+}
+
+struct ClusterCoordinator::Worker
+{
+    std::string address;
+    std::unique_ptr<WorkerService::Stub> stub;
+};
+
+ClusterCoordinator::ClusterCoordinator(std::vector<std::string> worker_addresses, std::chrono::milliseconds halo_timeout)
+    : halo_timeout(halo_timeout), next_job_id(std::random_device()() * (uint64_t(1) << 32))
+{
+    for (std::string &address : worker_addresses)
+    {
+        auto worker = std::make_unique<Worker>();
+        worker->stub = WorkerService::NewStub(CreateWorkerChannel(address));
+        worker->address = std::move(address);
+        workers.push_back(std::move(worker));
+    }
+}
+
+ClusterCoordinator::~ClusterCoordinator() = default;
+
+size_t ClusterCoordinator::num_workers() const
+{
+    return workers.size();
+}
+
+bool ClusterCoordinator::CanStep(const BitPackedGrid3D &grid) const
+{
+    return !workers.empty() && grid.x_max >= workers.size() && grid.size_in_bits() > 0;
+}
+
+tl::expected<void, std::string> ClusterCoordinator::Advance(BitPackedGrid3D &grid, const Bitset128 &rule, RuleMode rule_mode,
+                                                           uint64_t num_steps)
+{
+    if (!CanStep(grid))
+    {
+        return tl::unexpected("A grid of " + std::to_string(grid.x_max) + " x-slabs can't be split across " +
+                              std::to_string(workers.size()) + " workers");
+    }
+    const size_t n = workers.size();
+    const std::vector<SlabRange> ranges = PartitionSlabs(grid.x_max, n);
+    const uint64_t job_id = next_job_id++;
+    const std::string rule_bytes = SerializeBitSetRuleToString(rule);
+
+    // Every worker blocks in StepSlab until all of them are done, so the calls are made in parallel.
+    // Once one fails the others are cancelled, rather than waiting for its planes until they time out.
+    std::vector<sim_server::StepSlabResponse> responses(n);
+    std::vector<Status> statuses(n);
+    std::vector<grpc::ClientContext> contexts(n);
+    std::vector<std::thread> calls;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sim_server::StepSlabRequest request;
+        request.set_job_id(job_id);
+        ConvertGrid3DToPackedProto(ExtractRegion(grid, GridBox{ranges[i].x_begin, 0, 0, ranges[i].slabs(), grid.y_max, grid.z_max}),
+                                   *request.mutable_slab());
+        request.set_rule(rule_bytes);
+        request.set_rule_3d(rule_mode == RULE_3D);
+        request.set_num_steps(num_steps);
+        request.set_low_neighbor(workers[(i + n - 1) % n]->address);
+        request.set_high_neighbor(workers[(i + 1) % n]->address);
+        request.set_halo_timeout_ms(halo_timeout.count());
+        calls.emplace_back([this, i, request = std::move(request), &responses, &statuses, &contexts]
+                           {
+            statuses[i] = workers[i]->stub->StepSlab(&contexts[i], request, &responses[i]);
+            if (!statuses[i].ok())
+            {
+                for (grpc::ClientContext &context : contexts)
+                    context.TryCancel();
+            } });
+    }
+    for (std::thread &call : calls)
+        call.join();
+
+    // The first failure is the cause, the cancelled calls only follow from it
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!statuses[i].ok() && statuses[i].error_code() != grpc::StatusCode::CANCELLED)
+        {
+            return tl::unexpected("Worker " + workers[i]->address + ": " + statuses[i].error_message());
+        }
+    }
+    const size_t slab_bits = grid.y_max * grid.z_max;
+    BitPackedGrid3D stepped(grid.x_max, grid.y_max, grid.z_max);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!statuses[i].ok())
+        {
+            return tl::unexpected("Worker " + workers[i]->address + ": " + statuses[i].error_message());
+        }
+        auto slab = ConvertPackedProtoToGrid3D(responses[i].slab());
+        if (!slab || slab->x_max != ranges[i].slabs() || slab->y_max != grid.y_max || slab->z_max != grid.z_max)
+        {
+            return tl::unexpected("Worker " + workers[i]->address + " returned a slab of the wrong shape");
+        }
+        CopyBits(slab->raw().data(), 0, stepped.raw().data(), ranges[i].x_begin * slab_bits, ranges[i].slabs() * slab_bits);
+    }
+    grid = grid.layout() == GRID_LAYOUT_ROW_MAJOR ? std::move(stepped) : stepped.WithLayout(grid.layout());
+    return {};
+}
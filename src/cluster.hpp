@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <tl/expected.hpp>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+
+namespace grpc
+{
+class Service;
+}
+
+/**
+ * Coordinator/worker mode: the domain decomposition of slab_decomposition.hpp over gRPC.
+ *
+ * Workers are CellularAutomata3D processes started with --worker; they serve WorkerService next to
+ * the StateService. A coordinator (started with --workers=addr,addr,...) keeps serving the whole
+ * StateService itself, but hands each multi-step advance of a word-parallel state to its workers:
+ * every worker gets one range of x-slabs in a StepSlab call, the workers step their ranges together,
+ * sending their outer slabs to each other with ExchangeHalo before every step, and return the
+ * stepped ranges, which the coordinator puts back together. The result is bit-identical to
+ * stepping the grid in one process.
+ *
+ * Workers reach each other at the addresses the coordinator was given, so these must be valid on
+ * every worker (e.g. localhost ports or unix: sockets when all of them run on one machine).
+ */
+
+// WorkerService: steps the ranges coordinators send and accepts the planes of neighbouring workers
+std::unique_ptr<grpc::Service> MakeWorkerService();
+
+class ClusterCoordinator
+{
+public:
+    static constexpr std::chrono::milliseconds kDefaultHaloTimeout{30000};
+    // Steps StartSimulation hands to the workers at a time. Each advance sends the whole grid to the
+    // workers and back, so a pass should be long enough to amortize that.
+    static constexpr uint64_t kStepsPerPass = 64;
+
+    explicit ClusterCoordinator(std::vector<std::string> worker_addresses,
+                                std::chrono::milliseconds halo_timeout = kDefaultHaloTimeout);
+    ~ClusterCoordinator();
+
+    size_t num_workers() const;
+    // Whether Advance can split the grid: every worker needs at least one x-slab
+    bool CanStep(const BitPackedGrid3D &grid) const;
+
+    // Advances the grid num_steps steps on the workers. The grid keeps its layout. On failure it is
+    // left as it was.
+    tl::expected<void, std::string> Advance(BitPackedGrid3D &grid, const Bitset128 &rule, RuleMode rule_mode,
+                                            uint64_t num_steps);
+
+private:
+    struct Worker;
+
+    const std::chrono::milliseconds halo_timeout;
+    std::vector<std::unique_ptr<Worker>> workers;
+    // Job ids start at a random value, so coordinators sharing workers don't mix up their planes
+    std::atomic<uint64_t> next_job_id;
+};
@@ -0,0 +1,71 @@
+#include "cycle_detector.hpp"
+#include "double_buffered_grid.hpp"
+
+CycleDetector::CycleDetector(const BitPackedGrid3D &initial, const Fingerprint128 &fingerprint)
+    : saved(initial), saved_fingerprint(fingerprint) {}
+
+bool CycleDetector::Observe(const BitPackedGrid3D &state, const Fingerprint128 &fingerprint)
+{
+    if (found_period != 0)
+        return true;
+
+    ++distance;
+    if (fingerprint == saved_fingerprint && state == saved)
+    {
+        found_period = distance;
+        return true;
+    }
+    if (distance == power)
+    {
+        saved = state;
+        saved_fingerprint = fingerprint;
+        power *= 2;
+        distance = 0;
+    }
+    return false;
+}
+
+uint64_t CycleDetector::period() const
+{
+    return found_period;
+}
+
+std::optional<uint64_t> FindPeriod(const BitPackedGrid3D &state, const Bitset128 &rule, RuleMode rule_mode,
+                                   uint64_t multiple, const std::function<bool()> &keep_going)
+{
+    const Fingerprint128 fingerprint = FingerprintGrid(state);
+    DoubleBufferedGrid walker(state);
+    for (uint64_t period = 1; period <= multiple; ++period)
+    {
+        if (!keep_going())
+            return std::nullopt;
+        walker.Step(rule, rule_mode);
+        if (walker.fingerprint() == fingerprint && walker.front() == state)
+            return period;
+    }
+    return multiple;
+}
+
+std::optional<uint64_t> FindTransientLength(const BitPackedGrid3D &initial, const Bitset128 &rule, RuleMode rule_mode,
+                                            uint64_t period, const std::function<bool()> &keep_going)
+{
+    DoubleBufferedGrid tortoise(initial);
+    DoubleBufferedGrid hare(initial);
+    for (uint64_t i = 0; i < period; ++i)
+    {
+        if (!keep_going())
+            return std::nullopt;
+        hare.Step(rule, rule_mode);
+    }
+
+    uint64_t transient = 0;
+    while (tortoise.fingerprint() != hare.fingerprint() || !(tortoise.front() == hare.front()))
+    {
+        if (!keep_going())
+            return std::nullopt;
+        tortoise.Step(rule, rule_mode);
+        hare.Step(rule, rule_mode);
+        ++transient;
+    }
+    return transient;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include "bit_packed_grid_3d.hpp"
+#include "fingerprint.hpp"
+#include "random_bitset.hpp"
+
+/**
+ * Detects when a deterministic simulation revisits a state, using Brent's algorithm: one saved
+ * state, replaced at power-of-two distances, is compared against every new state. Fingerprints
+ * filter the candidates and a full compare confirms them, so a reported period is exact.
+ * Memory stays at one grid however long the run.
+ */
+class CycleDetector
+{
+public:
+    CycleDetector(const BitPackedGrid3D &initial, const Fingerprint128 &fingerprint);
+
+    // Feeds the state after the next step. Returns true once it equals a state seen `period()` steps earlier.
+    bool Observe(const BitPackedGrid3D &state, const Fingerprint128 &fingerprint);
+    // Smallest period of the cycle; valid after Observe() returned true. 1 means a fixed point.
+    uint64_t period() const;
+
+private:
+    BitPackedGrid3D saved;
+    Fingerprint128 saved_fingerprint;
+    uint64_t power = 1;
+    uint64_t distance = 0;
+    uint64_t found_period = 0;
+};
+
+// Smallest period of `state`, a state on a cycle whose period divides `multiple` (e.g. one found
+// by observing only every k-th step), found by stepping a copy until it returns. Returns nullopt
+// if keep_going() turns false first.
+std::optional<uint64_t> FindPeriod(const BitPackedGrid3D &state, const Bitset128 &rule, RuleMode rule_mode,
+                                   uint64_t multiple, const std::function<bool()> &keep_going);
+
+// Number of steps from `initial` to the first state of a cycle of the given period, found by
+// stepping two copies `period` steps apart until they meet. Any multiple of the period gives the same result. Returns nullopt if keep_going()
+// turns false first.
+std::optional<uint64_t> FindTransientLength(const BitPackedGrid3D &initial, const Bitset128 &rule, RuleMode rule_mode,
+                                            uint64_t period, const std::function<bool()> &keep_going);
@@ -0,0 +1,109 @@
+#include "double_buffered_grid.hpp"
+
+#include <algorithm>
+#include <utility>
+#include "thread_pool.hpp"
+
+DoubleBufferedGrid::DoubleBufferedGrid(BitPackedGrid3D initial)
+    : front_grid(std::move(initial)), back_grid(front_grid.x_max, front_grid.y_max, front_grid.z_max, front_grid.layout()) {}
+
+const BitPackedGrid3D &DoubleBufferedGrid::front() const
+{
+    return front_grid;
+}
+
+BitPackedGrid3D &DoubleBufferedGrid::mutable_front()
+{
+    // The back buffer no longer holds the state before the front one
+    changed_blocks.clear();
+    fingerprint_valid = false;
+    mostly_active = false;
+    return front_grid;
+}
+
+const BitPackedGrid3D &DoubleBufferedGrid::back() const
+{
+    return back_grid;
+}
+
+void DoubleBufferedGrid::Step(const Bitset128 &rule, RuleMode rule_mode)
+{
+    // An unchanged neighbourhood only maps to an unchanged cell under the same rule
+    if (changed_blocks.empty() || rule != last_rule || rule_mode != last_rule_mode)
+        changed_blocks.assign(NumActiveBlocks(front_grid), 1);
+    last_rule = rule;
+    last_rule_mode = rule_mode;
+
+    stats = StepGridActive(front_grid, back_grid, rule, rule_mode, changed_blocks);
+    mostly_active = 2 * static_cast<size_t>(std::count(changed_blocks.begin(), changed_blocks.end(), 1)) >= changed_blocks.size();
+    if (fingerprint_valid)
+    {
+        const size_t num_words = front_grid.raw().size();
+        for (size_t b = 0; b < changed_blocks.size(); ++b)
+        {
+            if (!changed_blocks[b])
+                continue;
+            const size_t begin = b * kActiveBlockWords;
+            const size_t end = std::min(num_words, begin + kActiveBlockWords);
+            front_fingerprint ^= FingerprintWords(front_grid.raw(), begin, end);
+            front_fingerprint ^= FingerprintWords(back_grid.raw(), begin, end);
+        }
+    }
+    // Swaps the vectors' storage, not their contents
+    std::swap(front_grid, back_grid);
+}
+
+TemporalBlockingPlan DoubleBufferedGrid::BlockingPlan(uint64_t num_steps) const
+{
+    // Only when threads share the memory bus: a single thread is bound by the kernel's arithmetic
+    if (ThreadPool::Shared().num_threads() == 1)
+        return TemporalBlockingPlan{};
+    return PlanTemporalBlocking(front_grid, num_steps);
+}
+
+ActiveStepStats DoubleBufferedGrid::Advance(const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps)
+{
+    ActiveStepStats total;
+    while (num_steps > 0)
+    {
+        // Blocking only once a step with this very rule has shown the activity to be widespread
+        const TemporalBlockingPlan plan = BlockingPlan(num_steps);
+        if (plan.steps_per_pass >= 2 && mostly_active && rule == last_rule && rule_mode == last_rule_mode)
+        {
+            StepGridBlocked(front_grid, back_grid, rule, rule_mode, num_steps, plan);
+            const size_t num_blocks = NumActiveBlocks(front_grid);
+            stats.blocks_computed = num_blocks;
+            stats.blocks_skipped = 0;
+            total.blocks_computed += num_blocks * num_steps;
+            // The back buffer holds an earlier state than the one right before the front one
+            changed_blocks.clear();
+            fingerprint_valid = false;
+            break;
+        }
+        Step(rule, rule_mode);
+        total.blocks_computed += stats.blocks_computed;
+        total.blocks_skipped += stats.blocks_skipped;
+        --num_steps;
+    }
+    return total;
+}
+
+const ActiveStepStats &DoubleBufferedGrid::last_step_stats() const
+{
+    return stats;
+}
+
+Fingerprint128 DoubleBufferedGrid::fingerprint() const
+{
+    if (!fingerprint_valid)
+    {
+        front_fingerprint = FingerprintGrid(front_grid);
+        fingerprint_valid = true;
+    }
+    return front_fingerprint;
+}
+
+size_t DoubleBufferedGrid::size_in_bytes() const
+{
+    return (front_grid.raw().size() + back_grid.raw().size()) * sizeof(uint64_t);
+}
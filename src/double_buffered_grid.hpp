@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_packed_grid_3d.hpp"
+#include "fingerprint.hpp"
+#include "random_bitset.hpp"
+#include "step_kernel.hpp"
+#include "temporal_blocking.hpp"
+
+/**
+ * A world state together with a second buffer of the same dimensions. A step writes the
+ * next state into the back buffer and swaps the two, so stepping allocates and copies nothing.
+ *
+ * Consecutive steps with the same rule only recompute the blocks whose neighbourhood changed in
+ * the previous step (see StepGridActive), so a seeded world costs time in proportion to its
+ * active volume. Modifying the state through mutable_front() resets this tracking.
+ *
+ * Once fingerprint() has been asked for, it is kept up to date from the changed blocks alone.
+ *
+ * Advance() takes several steps at once. While most of the grid keeps changing, skipping blocks
+ * saves little, so on a multi-threaded pool it switches to temporal blocking (see StepGridBlocked)
+ * and reads the grid once per pass of several steps instead of once per step.
+ */
+class DoubleBufferedGrid
+{
+public:
+    explicit DoubleBufferedGrid(BitPackedGrid3D initial);
+
+    // The current state
+    const BitPackedGrid3D &front() const;
+    BitPackedGrid3D &mutable_front();
+    // Buffer the next state is written to. Right after Step() it holds the previous state.
+    const BitPackedGrid3D &back() const;
+
+    // Computes the next state into the back buffer and swaps.
+    void Step(const Bitset128 &rule, RuleMode rule_mode);
+    // Advances num_steps steps and returns the blocks computed and skipped over all of them
+    ActiveStepStats Advance(const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps);
+    // How Advance(num_steps) blocks once the world is busy; steps_per_pass is 1 if it never does
+    TemporalBlockingPlan BlockingPlan(uint64_t num_steps) const;
+    // Blocks computed and skipped by the last Step()
+    const ActiveStepStats &last_step_stats() const;
+    // Fingerprint of the current state
+    Fingerprint128 fingerprint() const;
+
+    size_t size_in_bytes() const;
+
+private:
+    BitPackedGrid3D front_grid;
+    BitPackedGrid3D back_grid;
+
+    // Per block of the front grid: whether it differs from the back grid. Empty when unknown.
+    std::vector<uint8_t> changed_blocks;
+    Bitset128 last_rule;
+    RuleMode last_rule_mode = RULE_3D;
+    ActiveStepStats stats;
+    // Whether at least half of the blocks changed in the last step
+    bool mostly_active = false;
+    mutable Fingerprint128 front_fingerprint;
+    mutable bool fingerprint_valid = false;
+};
@@ -1,36 +1,104 @@
 #include "entropy_tracker.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+// Contribution -p log2 p of an outcome seen `count` times out of `total`
+double EntropyTerm(size_t count, size_t total)
+{
+    const double p = static_cast<double>(count) / total;
+    return -p * std::log2(p);
+}
+
+double CountLogCount(size_t count)
+{
+    return count * std::log2(static_cast<double>(count));
+}
+} // namespace
+
+EntropyTracker::EntropyTracker(size_t max_tracked_states) : max_tracked_states(max_tracked_states) {}
+
 void EntropyTracker::observe(const BitPackedGrid3D &grid)
 {
-    const auto &data = grid.raw(); // Returns const std::vector<uint64_t>&
-    ++frequency_map[data];
-    ++total_observations;
+    observe(FingerprintGrid(grid));
 }
 
-double EntropyTracker::entropy() const
+void EntropyTracker::observe(const Fingerprint128 &fingerprint)
 {
-    double H = 0.0;
-    for (const auto &kv : frequency_map)
+    ++observations;
+
+    auto found = counters.find(fingerprint);
+    if (found != counters.end())
     {
-        double p = static_cast<double>(kv.second) / total_observations;
-        H -= p * std::log2(p);
+        auto node = by_count.extract(found->second);
+        sum_count_log_count += CountLogCount(node.key() + 1) - CountLogCount(node.key());
+        ++node.key();
+        found->second = by_count.insert(std::move(node));
+        return;
     }
-    return H;
+
+    size_t count = 1;
+    if (max_tracked_states != 0 && counters.size() >= max_tracked_states)
+    {
+        // Space-Saving: the new state inherits the smallest counter, overestimating it by at most that count
+        auto smallest = by_count.begin();
+        count += smallest->first;
+        sum_count_log_count -= CountLogCount(smallest->first);
+        counters.erase(smallest->second);
+        by_count.erase(smallest);
+    }
+    sum_count_log_count += CountLogCount(count);
+    counters.emplace(fingerprint, by_count.emplace(count, fingerprint));
+}
+
+double EntropyTracker::entropy() const
+{
+    if (observations == 0)
+        return 0.0;
+    // H = -sum (c / N) log2(c / N) = log2 N - sum c log2 c / N
+    const double N = static_cast<double>(observations);
+    return std::max(0.0, std::log2(N) - sum_count_log_count / N);
 }
 
 void EntropyTracker::reset()
 {
-    frequency_map.clear();
-    total_observations = 0;
+    counters.clear();
+    by_count.clear();
+    observations = 0;
+    sum_count_log_count = 0.0;
 }
 
-size_t EntropyTracker::VectorHash::operator()(const std::vector<uint64_t> &vec) const
+double BlockPatternEntropy(const BitPackedGrid3D &grid)
 {
-    size_t hash = 0xcbf29ce484222325;
-    for (uint64_t v : vec)
+    // A byte of a brick word is a 2x4 patch of cells, not a run along z
+    if (grid.layout() != GRID_LAYOUT_ROW_MAJOR)
+        return BlockPatternEntropy(grid.WithLayout(GRID_LAYOUT_ROW_MAJOR));
+    const std::vector<uint64_t> &words = grid.raw();
+    const size_t num_bytes = grid.size_in_bits() / 8; // a partial last byte would count padding
+    if (num_bytes == 0)
+        return 0.0;
+
+    // Four histograms, so consecutive bytes of a word don't wait on each other's increments
+    std::array<std::array<size_t, 256>, 4> histograms{};
+    const size_t full_words = num_bytes / 8;
+    for (size_t i = 0; i < full_words; ++i)
     {
-        hash ^= v;
-        hash *= 0x100000001b3; // FNV-1a
+        const uint64_t word = words[i];
+        for (size_t b = 0; b < 8; ++b)
+            ++histograms[b & 3][(word >> (8 * b)) & 0xff];
     }
-    return hash;
-}
\ No newline at end of file
+    for (size_t byte = full_words * 8; byte < num_bytes; ++byte)
+        ++histograms[0][(words[byte / 8] >> (8 * (byte % 8))) & 0xff];
+
+    double H = 0.0;
+    for (size_t pattern = 0; pattern < 256; ++pattern)
+    {
+        const size_t count = histograms[0][pattern] + histograms[1][pattern] + histograms[2][pattern] + histograms[3][pattern];
+        if (count != 0)
+            H += EntropyTerm(count, num_bytes);
+    }
+    return H;
+}
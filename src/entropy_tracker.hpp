@@ -1,23 +1,50 @@
 #pragma once
-#include <vector>
-#include <unordered_map>
-#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
 #include "bit_packed_grid_3d.hpp"
+#include "fingerprint.hpp"
 
+/**
+ * Shannon entropy (in bits) of the distribution of states observed so far.
+ *
+ * States are identified by their 128-bit fingerprint, so an observation costs one counter no
+ * matter how large the grid is. With max_tracked_states > 0 counting is approximate: a
+ * Space-Saving sketch keeps at most that many counters and hands the least frequent one to a
+ * new state when full. The counts still sum to the number of observations, but rare states
+ * get merged, so the entropy is underestimated once more distinct states were seen than fit.
+ */
 class EntropyTracker
 {
 public:
+    // max_tracked_states == 0 counts every distinct state exactly
+    explicit EntropyTracker(size_t max_tracked_states = 0);
+
     void observe(const BitPackedGrid3D &grid);
+    // Same as observe(grid) for a state with this fingerprint, e.g. DoubleBufferedGrid::fingerprint()
+    void observe(const Fingerprint128 &fingerprint);
     double entropy() const;
     void reset();
 
+    size_t total_observations() const { return observations; }
+    // Number of counters in use, at most max_tracked_states when approximate
+    size_t tracked_states() const { return counters.size(); }
+    bool approximate() const { return max_tracked_states != 0; }
+
 private:
-    struct VectorHash
-    {
-        size_t operator()(const std::vector<uint64_t> &vec) const;
-    };
+    using CountIndex = std::multimap<size_t, Fingerprint128>;
+
+    const size_t max_tracked_states;
+    // Each tracked fingerprint's node in `by_count`, which holds its count ordered smallest first
+    std::unordered_map<Fingerprint128, CountIndex::iterator, Fingerprint128Hash> counters;
+    CountIndex by_count;
+    size_t observations = 0;
+    // Sum of count * log2(count) over the counters, so entropy() doesn't have to visit them
+    double sum_count_log_count = 0.0;
+};
 
-    std::unordered_map<std::vector<uint64_t>, size_t, VectorHash> frequency_map;
-    size_t total_observations = 0;
-};
\ No newline at end of file
+// Entropy (in bits, 0 to 8) of the 8-cell patterns within one grid: a histogram of every byte of
+// the row-major words, i.e. runs of 8 consecutive cells in row-major order, built in one pass.
+// Grids in another layout are converted to row-major first, so the result doesn't depend on it.
+double BlockPatternEntropy(const BitPackedGrid3D &grid);
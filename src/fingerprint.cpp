@@ -0,0 +1,37 @@
+#include "fingerprint.hpp"
+
+namespace
+{
+// splitmix64 finalizer
+uint64_t Mix(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+} // namespace
+
+Fingerprint128 FingerprintWords(const std::vector<uint64_t> &words, size_t begin, size_t end)
+{
+    return FingerprintWords(words.data(), begin, end);
+}
+
+Fingerprint128 FingerprintWords(const uint64_t *words, size_t begin, size_t end)
+{
+    Fingerprint128 fingerprint;
+    for (size_t i = begin; i < end; ++i)
+    {
+        // Two independently keyed hashes of (index, word)
+        fingerprint.lo ^= Mix(words[i] ^ Mix(i * 0x9e3779b97f4a7c15ULL + 1));
+        fingerprint.hi ^= Mix((words[i] + 0x632be59bd9b4e019ULL) * 0xd6e8feb86659fd93ULL ^ Mix(i + 0x8cb92ba72f3d8dd7ULL));
+    }
+    return fingerprint;
+}
+
+Fingerprint128 FingerprintGrid(const BitPackedGrid3D &grid)
+{
+    return FingerprintWords(grid.raw(), 0, grid.raw().size());
+}
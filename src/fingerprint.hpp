@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_packed_grid_3d.hpp"
+
+// 128-bit fingerprint of a grid's words. Equal grids have equal fingerprints; different ones
+// collide with probability ~2^-128, so a match still warrants a full compare where it matters.
+struct Fingerprint128
+{
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator==(const Fingerprint128 &other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(const Fingerprint128 &other) const { return !(*this == other); }
+    Fingerprint128 &operator^=(const Fingerprint128 &other)
+    {
+        lo ^= other.lo;
+        hi ^= other.hi;
+        return *this;
+    }
+};
+
+struct Fingerprint128Hash
+{
+    size_t operator()(const Fingerprint128 &fingerprint) const { return fingerprint.lo; }
+};
+
+// Fingerprint of words [begin, end), mixing in each word's index. The fingerprints of disjoint
+// ranges combine with XOR, so a grid's fingerprint can be updated for just the words that changed.
+Fingerprint128 FingerprintWords(const std::vector<uint64_t> &words, size_t begin, size_t end);
+// Same for words that aren't in a vector, e.g. a mapped file; words[i] has index i
+Fingerprint128 FingerprintWords(const uint64_t *words, size_t begin, size_t end);
+Fingerprint128 FingerprintGrid(const BitPackedGrid3D &grid);
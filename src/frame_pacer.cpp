@@ -0,0 +1,30 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+
+FramePacer::FramePacer(uint64_t frame_interval, bool latest_only)
+    : frame_interval(std::max<uint64_t>(frame_interval, 1)), latest_only(latest_only) {}
+
+bool FramePacer::ShouldSend(uint64_t step, bool last, bool client_ready)
+{
+    if (last)
+        return true;
+    if (step % frame_interval != 0)
+        return false;
+    if (latest_only && !client_ready)
+    {
+        ++dropped;
+        return false;
+    }
+    return true;
+}
+
+uint64_t FramePacer::StepsToNextDue(uint64_t step) const
+{
+    return frame_interval - step % frame_interval;
+}
+
+uint64_t FramePacer::frames_dropped() const
+{
+    return dropped;
+}
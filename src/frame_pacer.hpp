@@ -0,0 +1,132 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * Decides which steps of a streamed simulation become frames, so that a fast kernel doesn't
+ * have to run at the speed of the client.
+ *
+ * Every frame_interval-th step has a frame due (every step for 0 or 1), and so has the last one.
+ * By default a due frame is always sent: the stepping waits for the client if it has to. With
+ * latest_only a due frame is dropped while the client is still receiving the previous one, so
+ * the stepping never waits and the client gets the latest state whenever it's ready again. The
+ * last frame is never dropped.
+ */
+class FramePacer
+{
+public:
+    FramePacer(uint64_t frame_interval, bool latest_only);
+
+    // Whether the frame of `step` (counted from 1) is sent, given whether the client is ready for it
+    bool ShouldSend(uint64_t step, bool last, bool client_ready);
+    // Steps after `step` up to and including the next one with a frame due, which can be stepped in one go
+    uint64_t StepsToNextDue(uint64_t step) const;
+    // Due frames not sent because the client was busy
+    uint64_t frames_dropped() const;
+
+private:
+    const uint64_t frame_interval;
+    const bool latest_only;
+    uint64_t dropped = 0;
+};
+
+/**
+ * Where the frames of a stream go. Send() may return before the frame is on the wire, but first
+ * waits for the previous frame's write to complete, so a slow client holds back at most one frame
+ * and the server never buffers more. Ready() tells without blocking whether Send() would wait.
+ * Send() and Flush() return false once a write has failed, i.e. the client went away.
+ */
+template <typename Frame>
+class FrameSink
+{
+public:
+    virtual ~FrameSink() = default;
+    virtual bool Send(Frame frame) = 0;
+    virtual bool Ready() const = 0;
+    // Waits for the last frame's write to complete
+    virtual bool Flush() = 0;
+};
+
+// FrameSink over a blocking write function, e.g. grpc::ServerWriter::Write, which returns once
+// flow control has let the frame through. The writes run on a thread of the sink's own.
+template <typename Frame>
+class ThreadedFrameSink final : public FrameSink<Frame>
+{
+public:
+    using WriteFn = std::function<bool(const Frame &)>;
+
+    explicit ThreadedFrameSink(WriteFn write) : write(std::move(write)), writer([this]
+                                                                                  { WriterLoop(); }) {}
+    // Writes the pending frame, if any, then joins the thread.
+    ~ThreadedFrameSink() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        writer.join();
+    }
+    ThreadedFrameSink(const ThreadedFrameSink &) = delete;
+    ThreadedFrameSink &operator=(const ThreadedFrameSink &) = delete;
+
+    bool Send(Frame frame) override
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]
+                { return !pending; });
+        if (!write_ok)
+            return false;
+        slot = std::move(frame);
+        pending = true;
+        cv.notify_all();
+        return true;
+    }
+
+    bool Ready() const override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !pending;
+    }
+
+    bool Flush() override
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]
+                { return !pending; });
+        return write_ok;
+    }
+
+private:
+    void WriterLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            cv.wait(lock, [this]
+                    { return stopping || pending; });
+            if (!pending)
+                return; // stopping and drained
+            // Send() doesn't touch the slot while a write is pending
+            lock.unlock();
+            const bool ok = write(slot);
+            lock.lock();
+            write_ok = write_ok && ok;
+            pending = false;
+            cv.notify_all();
+        }
+    }
+
+    const WriteFn write;
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    Frame slot;
+    bool pending = false;
+    bool write_ok = true;
+    bool stopping = false;
+    std::thread writer; // last, so it starts after the members it uses
+};
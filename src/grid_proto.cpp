@@ -0,0 +1,142 @@
+#include "grid_proto.hpp"
+
+#include <cstring>
+
+void ConvertGrid3DToProto(const BitPackedGrid3D &grid, sim_server::Vector3D &vec3d_proto)
+{
+    const size_t x_max = grid.x_max;
+    const size_t y_max = grid.y_max;
+    const size_t z_max = grid.z_max;
+
+    for (size_t x = 0; x < x_max; ++x)
+    {
+        sim_server::Vector2D *vec2d_proto = vec3d_proto.add_vec2d();
+        for (size_t y = 0; y < y_max; ++y)
+        {
+            sim_server::Vector1D *vec1d_proto = vec2d_proto->add_vec1d();
+            for (size_t z = 0; z < z_max; ++z)
+            {
+                bool bit = grid.get(x, y, z);
+                vec1d_proto->add_bit(static_cast<uint32_t>(bit));
+            }
+        }
+    }
+}
+
+void PackWords(const std::vector<uint64_t> &words, std::string &bytes)
+{
+    bytes.resize(words.size() * sizeof(uint64_t));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(bytes.data(), words.data(), bytes.size());
+#else
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        for (size_t b = 0; b < sizeof(uint64_t); ++b)
+            bytes[i * sizeof(uint64_t) + b] = static_cast<char>(words[i] >> (8 * b));
+    }
+#endif
+}
+
+tl::expected<std::vector<uint64_t>, std::string> UnpackWords(const std::string &bytes)
+{
+    if (bytes.size() % sizeof(uint64_t) != 0)
+        return tl::unexpected("Packed words of " + std::to_string(bytes.size()) + " bytes aren't whole 64-bit words");
+    std::vector<uint64_t> words(bytes.size() / sizeof(uint64_t));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(words.data(), bytes.data(), bytes.size());
+#else
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        for (size_t b = 0; b < sizeof(uint64_t); ++b)
+            words[i] |= uint64_t(static_cast<uint8_t>(bytes[i * sizeof(uint64_t) + b])) << (8 * b);
+    }
+#endif
+    return words;
+}
+
+void ConvertGrid3DToPackedProto(const BitPackedGrid3D &grid, sim_server::PackedGrid &packed_proto)
+{
+    if (grid.layout() != GRID_LAYOUT_ROW_MAJOR)
+    {
+        ConvertGrid3DToPackedProto(grid.WithLayout(GRID_LAYOUT_ROW_MAJOR), packed_proto);
+        return;
+    }
+    packed_proto.mutable_dimensions()->set_x_max(grid.x_max);
+    packed_proto.mutable_dimensions()->set_y_max(grid.y_max);
+    packed_proto.mutable_dimensions()->set_z_max(grid.z_max);
+    packed_proto.set_bit_order(sim_server::PackedGrid::BIT_ORDER_LSB_FIRST);
+
+    PackWords(grid.raw(), *packed_proto.mutable_words());
+}
+
+tl::expected<BitPackedGrid3D, std::string> ConvertPackedProtoToGrid3D(const sim_server::PackedGrid &packed_proto)
+{
+    auto words = UnpackWords(packed_proto.words());
+    if (!words)
+        return tl::unexpected(words.error());
+    const sim_server::GridDimensions &dimensions = packed_proto.dimensions();
+    if (dimensions.x_max() < 0 || dimensions.y_max() < 0 || dimensions.z_max() < 0)
+        return tl::unexpected(std::string("Packed grid has negative dimensions"));
+    const uint64_t needed = (uint64_t(dimensions.x_max()) * uint64_t(dimensions.y_max()) * uint64_t(dimensions.z_max()) + 63) / 64;
+    if (words->size() != needed)
+        return tl::unexpected("Packed grid has " + std::to_string(words->size()) + " words, its dimensions need " +
+                              std::to_string(needed));
+    BitPackedGrid3D grid(dimensions.x_max(), dimensions.y_max(), dimensions.z_max());
+    grid.raw() = std::move(*words);
+    return grid;
+}
+
+void ConvertDeltaToProto(const BitPackedGrid3D &previous, const BitPackedGrid3D &next,
+                         sim_server::DeltaEncoding encoding, sim_server::GridDelta &delta_proto)
+{
+    if (previous.layout() != GRID_LAYOUT_ROW_MAJOR || next.layout() != GRID_LAYOUT_ROW_MAJOR)
+    {
+        ConvertDeltaToProto(previous.WithLayout(GRID_LAYOUT_ROW_MAJOR), next.WithLayout(GRID_LAYOUT_ROW_MAJOR),
+                            encoding, delta_proto);
+        return;
+    }
+    const std::vector<uint64_t> &before = previous.raw();
+    const std::vector<uint64_t> &after = next.raw();
+    const size_t num_words = before.size();
+
+    if (encoding == sim_server::DELTA_ENCODING_RLE)
+    {
+        size_t i = 0;
+        while (i < num_words)
+        {
+            const size_t unchanged_begin = i;
+            while (i < num_words && before[i] == after[i])
+                ++i;
+            if (i == num_words)
+                break;
+
+            const size_t changed_begin = i;
+            while (i < num_words && before[i] != after[i])
+            {
+                delta_proto.add_word_xor(before[i] ^ after[i]);
+                ++i;
+            }
+            delta_proto.add_runs(changed_begin - unchanged_begin);
+            delta_proto.add_runs(i - changed_begin);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < num_words; ++i)
+    {
+        const uint64_t changed = before[i] ^ after[i];
+        if (changed != 0)
+        {
+            delta_proto.add_word_index(i);
+            delta_proto.add_word_xor(changed);
+        }
+    }
+}
+
+void SerializeGrid(const BitPackedGrid3D &grid, sim_server::GridEncoding encoding, sim_server::WorldStateResponse &response)
+{
+    if (encoding == sim_server::GRID_ENCODING_PACKED)
+        ConvertGrid3DToPackedProto(grid, *response.mutable_packed_state());
+    else
+        ConvertGrid3DToProto(grid, *response.mutable_state());
+}
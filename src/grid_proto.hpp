@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <tl/expected.hpp>
+#include "sim_server.pb.h"
+#include "bit_packed_grid_3d.hpp"
+
+// Conversions between grids and their protobuf encodings (see proto/sim_server.proto).
+// The wire is always row-major: grids in another layout are converted first.
+
+// Serializes a BitPackedGrid3D into a nested Vector3D, one uint32 per cell.
+void ConvertGrid3DToProto(const BitPackedGrid3D &grid, sim_server::Vector3D &vec3d_proto);
+
+// Serializes a BitPackedGrid3D into a PackedGrid: the grid's words copied as little-endian bytes.
+void ConvertGrid3DToPackedProto(const BitPackedGrid3D &grid, sim_server::PackedGrid &packed_proto);
+
+// Inverse of ConvertGrid3DToPackedProto. Fails if the words don't match the dimensions.
+tl::expected<BitPackedGrid3D, std::string> ConvertPackedProtoToGrid3D(const sim_server::PackedGrid &packed_proto);
+
+// Words as little-endian bytes, the encoding of PackedGrid.words, and back
+void PackWords(const std::vector<uint64_t> &words, std::string &bytes);
+tl::expected<std::vector<uint64_t>, std::string> UnpackWords(const std::string &bytes);
+
+// Encodes the XOR of two consecutive states' words into a GridDelta, either as
+// (word index, xor) pairs or as alternating runs of unchanged and changed words.
+void ConvertDeltaToProto(const BitPackedGrid3D &previous, const BitPackedGrid3D &next,
+                         sim_server::DeltaEncoding encoding, sim_server::GridDelta &delta_proto);
+
+// Writes the grid into the response in the encoding the client asked for.
+void SerializeGrid(const BitPackedGrid3D &grid, sim_server::GridEncoding encoding, sim_server::WorldStateResponse &response);
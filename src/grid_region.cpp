@@ -0,0 +1,150 @@
+#include "grid_region.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include "thread_pool.hpp"
+
+namespace
+{
+// Live cells among bits [bit, bit + count) of words
+uint64_t CountBits(const uint64_t *words, size_t bit, size_t count)
+{
+    uint64_t total = 0;
+    while (count > 0)
+    {
+        const size_t shift = bit % 64;
+        const size_t n = std::min(count, 64 - shift);
+        const uint64_t mask = (n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1) << shift;
+        total += std::bitset<64>(words[bit / 64] & mask).count();
+        bit += n;
+        count -= n;
+    }
+    return total;
+}
+
+// Counts the cells of box with x in [x_begin, x_end) into the blocks of a row-major grid
+void CountRowMajor(const BitPackedGrid3D &grid, const GridBox &box, size_t block_size, size_t x_begin, size_t x_end,
+                   BlockPopulations &populations)
+{
+    const uint64_t *words = grid.raw().data();
+    for (size_t x = x_begin; x < x_end; ++x)
+    {
+        const size_t bx = (x - box.x) / block_size;
+        for (size_t y = box.y; y < box.y + box.size_y; ++y)
+        {
+            const size_t by = (y - box.y) / block_size;
+            uint64_t *row = &populations.counts[(bx * populations.blocks_y + by) * populations.blocks_z];
+            const size_t run = grid.index(x, y, box.z);
+            for (size_t bz = 0; bz < populations.blocks_z; ++bz)
+            {
+                const size_t bit = run + bz * block_size;
+                const size_t n = std::min(block_size, box.size_z - bz * block_size);
+                // Most blocks of a run lie within one word
+                if (bit % 64 + n <= 64)
+                    row[bz] += __builtin_popcountll((words[bit / 64] >> (bit % 64)) & (n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1));
+                else
+                    row[bz] += CountBits(words, bit, n);
+            }
+        }
+    }
+}
+
+// Same for a brick layout grid: whole bricks inside one block are counted with a single popcount,
+// the others cell by cell
+void CountBricks(const BitPackedGrid3D &grid, const GridBox &box, size_t block_size, size_t x_begin, size_t x_end,
+                 BlockPopulations &populations)
+{
+    const BrickOrder &order = *grid.brick_order();
+    auto block_of = [&](size_t cell, size_t first)
+    { return (cell - first) / block_size; };
+    auto add = [&](size_t x, size_t y, size_t z, uint64_t count)
+    {
+        const size_t bx = block_of(x, box.x), by = block_of(y, box.y), bz = block_of(z, box.z);
+        populations.counts[(bx * populations.blocks_y + by) * populations.blocks_z + bz] += count;
+    };
+    // Whether cells [first, first + 4) of the brick are all in the box and in the same block
+    auto whole = [&](size_t first, size_t box_first, size_t box_size)
+    {
+        return first >= box_first && first + 4 <= box_first + box_size &&
+               block_of(first, box_first) == block_of(first + 3, box_first);
+    };
+
+    const size_t y_end = box.y + box.size_y;
+    const size_t z_end = box.z + box.size_z;
+    for (size_t bx = x_begin / 4; bx * 4 < x_end; ++bx)
+    {
+        for (size_t by = box.y / 4; by * 4 < y_end; ++by)
+        {
+            for (size_t bz = box.z / 4; bz * 4 < z_end; ++bz)
+            {
+                const uint64_t word = grid.raw()[order.Word(bx, by, bz)];
+                if (word == 0)
+                    continue;
+                if (bx * 4 >= x_begin && bx * 4 + 4 <= x_end && whole(bx * 4, box.x, box.size_x) &&
+                    whole(by * 4, box.y, box.size_y) && whole(bz * 4, box.z, box.size_z))
+                {
+                    add(bx * 4, by * 4, bz * 4, std::bitset<64>(word).count());
+                    continue;
+                }
+                for (size_t x = std::max(bx * 4, x_begin); x < std::min(bx * 4 + 4, x_end); ++x)
+                    for (size_t y = std::max(by * 4, box.y); y < std::min(by * 4 + 4, y_end); ++y)
+                        for (size_t z = std::max(bz * 4, box.z); z < std::min(bz * 4 + 4, z_end); ++z)
+                            if (grid.get(x, y, z))
+                                add(x, y, z, 1);
+            }
+        }
+    }
+}
+} // namespace
+
+size_t GridBox::cells() const
+{
+    return size_x * size_y * size_z;
+}
+
+bool BoxWithinGrid(const BitPackedGrid3D &grid, const GridBox &box)
+{
+    return box.cells() != 0 && box.x < grid.x_max && box.size_x <= grid.x_max - box.x && box.y < grid.y_max &&
+           box.size_y <= grid.y_max - box.y && box.z < grid.z_max && box.size_z <= grid.z_max - box.z;
+}
+
+BitPackedGrid3D ExtractRegion(const BitPackedGrid3D &grid, const GridBox &box)
+{
+    BitPackedGrid3D region(box.size_x, box.size_y, box.size_z);
+    for (size_t x = 0; x < box.size_x; ++x)
+    {
+        for (size_t y = 0; y < box.size_y; ++y)
+        {
+            if (grid.layout() == GRID_LAYOUT_ROW_MAJOR)
+            {
+                // Each z-run of the box is a contiguous run of bits in both grids
+                CopyBits(grid.raw().data(), grid.index(box.x + x, box.y + y, box.z), region.raw().data(),
+                         region.index(x, y, 0), box.size_z);
+                continue;
+            }
+            for (size_t z = 0; z < box.size_z; ++z)
+                region.set(x, y, z, grid.get(box.x + x, box.y + y, box.z + z));
+        }
+    }
+    return region;
+}
+
+BlockPopulations CountBlockPopulations(const BitPackedGrid3D &grid, const GridBox &box, size_t block_size)
+{
+    BlockPopulations populations;
+    populations.blocks_x = (box.size_x + block_size - 1) / block_size;
+    populations.blocks_y = (box.size_y + block_size - 1) / block_size;
+    populations.blocks_z = (box.size_z + block_size - 1) / block_size;
+    populations.counts.assign(populations.blocks_x * populations.blocks_y * populations.blocks_z, 0);
+
+    // Every x-slab of blocks has counters of its own, so the slabs are counted independently
+    ThreadPool::Shared().ParallelFor(0, populations.blocks_x, 1, [&](size_t begin, size_t end)
+                                     {
+        const size_t x_begin = box.x + begin * block_size;
+        const size_t x_end = std::min(box.x + box.size_x, box.x + end * block_size);
+        if (grid.layout() == GRID_LAYOUT_ROW_MAJOR)
+            CountRowMajor(grid, box, block_size, x_begin, x_end, populations);
+        else
+            CountBricks(grid, box, block_size, x_begin, x_end, populations); });
+    return populations;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_packed_grid_3d.hpp"
+
+/**
+ * Views of part of a grid, for clients that display a slice, a sub-box or a zoomed-out picture
+ * of a world too large to send whole. The work done is proportional to the box, not the grid:
+ * row-major grids are read one z-run of words at a time, and populations are counted with
+ * popcount over the words of each run.
+ */
+
+// Axis-aligned box of cells [x, x + size_x) x [y, y + size_y) x [z, z + size_z)
+struct GridBox
+{
+    size_t x = 0, y = 0, z = 0;
+    size_t size_x = 0, size_y = 0, size_z = 0;
+
+    size_t cells() const;
+};
+
+// Whether the box is non-empty and lies within the grid (boxes don't wrap around)
+bool BoxWithinGrid(const BitPackedGrid3D &grid, const GridBox &box);
+
+// The cells of the box as a row-major grid of the box's size. The box must lie within the grid.
+BitPackedGrid3D ExtractRegion(const BitPackedGrid3D &grid, const GridBox &box);
+
+// Live cells per block of a box, blocks in row-major order: block (bx, by, bz) has index
+// (bx * blocks_y + by) * blocks_z + bz.
+struct BlockPopulations
+{
+    size_t blocks_x = 0, blocks_y = 0, blocks_z = 0;
+    std::vector<uint64_t> counts;
+};
+
+// Counts the live cells in each block of block_size^3 cells of the box, starting at the box's
+// first cell; blocks at the box's far edges may be partial. The box must lie within the grid and
+// block_size must be at least 1. Blocks of x-slabs are counted in parallel on the shared pool.
+BlockPopulations CountBlockPopulations(const BitPackedGrid3D &grid, const GridBox &box, size_t block_size);
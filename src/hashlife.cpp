@@ -0,0 +1,430 @@
+#include "hashlife.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+bool IsPowerOfTwo(size_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+uint32_t Log2(size_t value)
+{
+    uint32_t log = 0;
+    while ((size_t(1) << log) < value)
+        ++log;
+    return log;
+}
+
+size_t MixHash(size_t hash, size_t value)
+{
+    return (hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2)));
+}
+
+size_t Octant(size_t x_half, size_t y_half, size_t z_half)
+{
+    return (x_half << 2) | (y_half << 1) | z_half;
+}
+
+size_t LeafBit(size_t x, size_t y, size_t z)
+{
+    return x * 16 + y * 4 + z;
+}
+} // namespace
+
+tl::expected<std::unique_ptr<HashLifeEngine>, std::string> HashLifeEngine::Create(const BitPackedGrid3D &initial)
+{
+    if (!SupportsDimensions(initial.x_max, initial.y_max, initial.z_max))
+    {
+        return tl::unexpected("HashLife requires power-of-two dimensions, got x=" + std::to_string(initial.x_max) +
+                              ", y=" + std::to_string(initial.y_max) + ", z=" + std::to_string(initial.z_max));
+    }
+    std::unique_ptr<HashLifeEngine> engine(new HashLifeEngine(initial.x_max, initial.y_max, initial.z_max));
+    engine->Load(initial);
+    return engine;
+}
+
+bool HashLifeEngine::SupportsDimensions(size_t x_max, size_t y_max, size_t z_max)
+{
+    return IsPowerOfTwo(x_max) && IsPowerOfTwo(y_max) && IsPowerOfTwo(z_max);
+}
+
+HashLifeEngine::HashLifeEngine(size_t x_max, size_t y_max, size_t z_max)
+    : x_max(x_max), y_max(y_max), z_max(z_max),
+      // Smaller worlds are tiled up to 8x8x8, so the root always has children
+      root_level(std::max(kLeafLevel + 1, Log2(std::max({x_max, y_max, z_max})))) {}
+
+size_t HashLifeEngine::num_nodes() const
+{
+    return nodes.size();
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Intern(const Node &candidate)
+{
+    auto it = canonical.find(&candidate);
+    if (it != canonical.end())
+        return *it;
+    nodes.push_back(candidate);
+    const Node *node = &nodes.back();
+    canonical.insert(node);
+    return node;
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Leaf(uint64_t cells)
+{
+    Node candidate{};
+    candidate.leaf = cells;
+    candidate.level = kLeafLevel;
+    candidate.hash = MixHash(kLeafLevel, std::hash<uint64_t>()(cells));
+    return Intern(candidate);
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Inner(const std::array<const Node *, 8> &children)
+{
+    Node candidate{};
+    candidate.child = children;
+    candidate.level = children[0]->level + 1;
+    candidate.hash = candidate.level;
+    for (const Node *child : children)
+        candidate.hash = MixHash(candidate.hash, child->hash);
+    return Intern(candidate);
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Empty(uint32_t level)
+{
+    while (empty_nodes.size() <= level)
+    {
+        const size_t next = empty_nodes.size();
+        if (next < kLeafLevel)
+            empty_nodes.push_back(nullptr);
+        else if (next == kLeafLevel)
+            empty_nodes.push_back(Leaf(0));
+        else
+        {
+            std::array<const Node *, 8> children;
+            children.fill(empty_nodes.back());
+            empty_nodes.push_back(Inner(children));
+        }
+    }
+    return empty_nodes[level];
+}
+
+void HashLifeEngine::Load(const BitPackedGrid3D &grid)
+{
+    BuildCache built;
+    root = Build(grid, root_level, 0, 0, 0, built);
+    Empty(root_level); // lets Extract() skip empty subtrees
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Build(const BitPackedGrid3D &grid, uint32_t level, size_t x0, size_t y0, size_t z0,
+                                                  BuildCache &built)
+{
+    const BuildKey key{level, x0 % x_max, y0 % y_max, z0 % z_max};
+    auto it = built.find(key);
+    if (it != built.end())
+        return it->second;
+
+    const Node *node;
+    if (level == kLeafLevel)
+    {
+        uint64_t cells = 0;
+        const std::vector<uint64_t> &words = grid.raw();
+        for (size_t x = 0; x < 4; ++x)
+        {
+            for (size_t y = 0; y < 4; ++y)
+            {
+                const size_t gx = (key.x + x) % x_max;
+                const size_t gy = (key.y + y) % y_max;
+                uint64_t run;
+                if (z_max >= 4)
+                {
+                    // 4 consecutive z cells start at a multiple of 4, so they never straddle two words
+                    const size_t index = grid.index(gx, gy, key.z);
+                    run = (words[index / 64] >> (index % 64)) & 0xF;
+                }
+                else
+                {
+                    run = 0;
+                    for (size_t z = 0; z < 4; ++z)
+                        run |= static_cast<uint64_t>(grid.get(gx, gy, (key.z + z) % z_max)) << z;
+                }
+                cells |= run << LeafBit(x, y, 0);
+            }
+        }
+        node = Leaf(cells);
+    }
+    else
+    {
+        const size_t half = size_t(1) << (level - 1);
+        std::array<const Node *, 8> children;
+        for (size_t octant = 0; octant < 8; ++octant)
+        {
+            children[octant] = Build(grid, level - 1, key.x + ((octant >> 2) & 1) * half,
+                                     key.y + ((octant >> 1) & 1) * half, key.z + (octant & 1) * half, built);
+        }
+        node = Inner(children);
+    }
+    built.emplace(key, node);
+    return node;
+}
+
+void HashLifeEngine::SetRule(const Bitset128 &new_rule, RuleMode new_rule_mode)
+{
+    if (has_rule && new_rule == rule && new_rule_mode == rule_mode)
+        return;
+    rule = new_rule;
+    rule_mode = new_rule_mode;
+    has_rule = true;
+    results.clear();
+
+    const bool eca = rule_mode == RULE_1D_ECA;
+    for (size_t index = 0; index < rule_table.size(); ++index)
+    {
+        const uint8_t central = (index >> 6) & 1;
+        const uint8_t x_pair = (index >> 4) & 3;
+        const uint8_t y_pair = eca ? 0 : (index >> 2) & 3;
+        const uint8_t z_pair = eca ? 0 : index & 3;
+        rule_table[index] = does_cell_live(rule, central, x_pair, y_pair, z_pair);
+    }
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Grandchild(const Node *node, size_t gx, size_t gy, size_t gz)
+{
+    return node->child[Octant(gx >> 1, gy >> 1, gz >> 1)]->child[Octant(gx & 1, gy & 1, gz & 1)];
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Center(const Node *node)
+{
+    if (node->level > kLeafLevel + 1)
+    {
+        std::array<const Node *, 8> children;
+        for (size_t octant = 0; octant < 8; ++octant)
+            children[octant] = node->child[octant]->child[octant ^ 7];
+        return Inner(children);
+    }
+
+    // Level 3: the inner 2x2x2 corner of each leaf
+    uint64_t cells = 0;
+    for (size_t octant = 0; octant < 8; ++octant)
+    {
+        const size_t ox = (octant >> 2) & 1, oy = (octant >> 1) & 1, oz = octant & 1;
+        const uint64_t leaf = node->child[octant]->leaf;
+        for (size_t x = 0; x < 2; ++x)
+            for (size_t y = 0; y < 2; ++y)
+                for (size_t z = 0; z < 2; ++z)
+                {
+                    const uint64_t bit = (leaf >> LeafBit((1 - ox) * 2 + x, (1 - oy) * 2 + y, (1 - oz) * 2 + z)) & 1;
+                    cells |= bit << LeafBit(ox * 2 + x, oy * 2 + y, oz * 2 + z);
+                }
+    }
+    return Leaf(cells);
+}
+
+const HashLifeEngine::Node *HashLifeEngine::EvolveBase(const Node *node, uint32_t j)
+{
+    // 8x8x8 cells, one word per x plane with bit y * 8 + z
+    std::array<uint64_t, 8> cells{};
+    for (size_t octant = 0; octant < 8; ++octant)
+    {
+        const size_t ox = (octant >> 2) & 1, oy = (octant >> 1) & 1, oz = octant & 1;
+        const uint64_t leaf = node->child[octant]->leaf;
+        for (size_t x = 0; x < 4; ++x)
+            for (size_t y = 0; y < 4; ++y)
+            {
+                const uint64_t run = (leaf >> LeafBit(x, y, 0)) & 0xF;
+                cells[ox * 4 + x] |= run << ((oy * 4 + y) * 8 + oz * 4);
+            }
+    }
+
+    auto cell = [](const std::array<uint64_t, 8> &planes, size_t x, size_t y, size_t z)
+    { return static_cast<size_t>((planes[x] >> (y * 8 + z)) & 1); };
+
+    // Each step shrinks the valid region by one cell on every side: [1, 7) after one, [2, 6) after two.
+    const size_t num_steps = size_t(1) << j;
+    for (size_t step = 1; step <= num_steps; ++step)
+    {
+        std::array<uint64_t, 8> next{};
+        for (size_t x = step; x < 8 - step; ++x)
+            for (size_t y = step; y < 8 - step; ++y)
+                for (size_t z = step; z < 8 - step; ++z)
+                {
+                    const size_t index = (cell(cells, x, y, z) << 6) | (cell(cells, x - 1, y, z) << 5) |
+                                         (cell(cells, x + 1, y, z) << 4) | (cell(cells, x, y - 1, z) << 3) |
+                                         (cell(cells, x, y + 1, z) << 2) | (cell(cells, x, y, z - 1) << 1) |
+                                         cell(cells, x, y, z + 1);
+                    next[x] |= static_cast<uint64_t>(rule_table[index]) << (y * 8 + z);
+                }
+        cells = next;
+    }
+
+    uint64_t center = 0;
+    for (size_t x = 0; x < 4; ++x)
+        for (size_t y = 0; y < 4; ++y)
+            center |= ((cells[x + 2] >> ((y + 2) * 8 + 2)) & 0xF) << LeafBit(x, y, 0);
+    return Leaf(center);
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Evolve(const Node *node, uint32_t j)
+{
+    auto it = results.find({node, j});
+    if (it != results.end())
+        return it->second;
+
+    const Node *result;
+    if (node->level == kLeafLevel + 1)
+    {
+        result = EvolveBase(node, j);
+    }
+    else
+    {
+        // The 27 overlapping level n - 1 cubes at half-child offsets, reduced to their level n - 2
+        // centers: advanced by 2^(n-3) steps on the first pass of a full-speed jump, untouched otherwise.
+        const bool full_speed = j == node->level - 2;
+        std::array<const Node *, 27> reduced;
+        for (size_t a = 0; a < 3; ++a)
+            for (size_t b = 0; b < 3; ++b)
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    std::array<const Node *, 8> children;
+                    for (size_t octant = 0; octant < 8; ++octant)
+                        children[octant] = Grandchild(node, a + ((octant >> 2) & 1), b + ((octant >> 1) & 1), c + (octant & 1));
+                    const Node *sub = Inner(children);
+                    reduced[(a * 3 + b) * 3 + c] = full_speed ? Evolve(sub, node->level - 3) : Center(sub);
+                }
+
+        // Second pass: each octant of the result from the 2x2x2 reduced cubes around it
+        const uint32_t second_j = full_speed ? node->level - 3 : j;
+        std::array<const Node *, 8> octants;
+        for (size_t octant = 0; octant < 8; ++octant)
+        {
+            const size_t ox = (octant >> 2) & 1, oy = (octant >> 1) & 1, oz = octant & 1;
+            std::array<const Node *, 8> children;
+            for (size_t inner = 0; inner < 8; ++inner)
+                children[inner] = reduced[((ox + ((inner >> 2) & 1)) * 3 + oy + ((inner >> 1) & 1)) * 3 + oz + (inner & 1)];
+            octants[octant] = Evolve(Inner(children), second_j);
+        }
+        result = Inner(octants);
+    }
+    results.emplace(std::make_pair(node, j), result);
+    return result;
+}
+
+void HashLifeEngine::JumpPow2(uint32_t j)
+{
+    // Tile the world until the tiling is large enough to jump 2^j steps, at least one level above the world
+    const uint32_t tiling_level = std::max(root_level + 1, j + 2);
+    const Node *tiling = root;
+    for (uint32_t level = root_level; level < tiling_level; ++level)
+    {
+        std::array<const Node *, 8> children;
+        children.fill(tiling);
+        tiling = Inner(children);
+    }
+
+    const Node *evolved = Evolve(tiling, j);
+    if (evolved->level == root_level)
+    {
+        // The result is the world shifted by half its side in every direction: swap the halves back
+        std::array<const Node *, 8> children;
+        for (size_t octant = 0; octant < 8; ++octant)
+            children[octant] = evolved->child[octant ^ 7];
+        root = Inner(children);
+        return;
+    }
+    // Shifted by a multiple of the world's side: any aligned cube is the world
+    while (evolved->level > root_level)
+        evolved = evolved->child[0];
+    root = evolved;
+}
+
+void HashLifeEngine::Advance(uint64_t num_steps)
+{
+    for (uint32_t j = 0; num_steps != 0; ++j, num_steps >>= 1)
+    {
+        if (num_steps & 1)
+            JumpPow2(j);
+        if (nodes.size() > kMaxNodes)
+            Collect();
+    }
+}
+
+const HashLifeEngine::Node *HashLifeEngine::Reintern(const Node *node, std::unordered_map<const Node *, const Node *> &copied)
+{
+    auto it = copied.find(node);
+    if (it != copied.end())
+        return it->second;
+
+    const Node *copy;
+    if (node->level == kLeafLevel)
+    {
+        copy = Leaf(node->leaf);
+    }
+    else
+    {
+        std::array<const Node *, 8> children;
+        for (size_t octant = 0; octant < 8; ++octant)
+            children[octant] = Reintern(node->child[octant], copied);
+        copy = Inner(children);
+    }
+    copied.emplace(node, copy);
+    return copy;
+}
+
+void HashLifeEngine::Collect()
+{
+    // Keep the old nodes alive until the current state has been copied out of them
+    std::deque<Node> old_nodes;
+    old_nodes.swap(nodes);
+    canonical.clear();
+    empty_nodes.clear();
+    results.clear();
+
+    std::unordered_map<const Node *, const Node *> copied;
+    root = Reintern(root, copied);
+    Empty(root_level);
+}
+
+void HashLifeEngine::Extract(BitPackedGrid3D &grid) const
+{
+    std::fill(grid.raw().begin(), grid.raw().end(), 0);
+    ExtractNode(root, 0, 0, 0, grid);
+}
+
+void HashLifeEngine::ExtractNode(const Node *node, size_t x0, size_t y0, size_t z0, BitPackedGrid3D &grid) const
+{
+    // Only the cube's corner covered by the world is written, and empty nodes leave the cleared grid as it is
+    if (x0 >= x_max || y0 >= y_max || z0 >= z_max)
+        return;
+    if (node->level < empty_nodes.size() && node == empty_nodes[node->level])
+        return;
+
+    if (node->level == kLeafLevel)
+    {
+        std::vector<uint64_t> &words = grid.raw();
+        for (size_t x = 0; x < 4 && x0 + x < x_max; ++x)
+            for (size_t y = 0; y < 4 && y0 + y < y_max; ++y)
+            {
+                const uint64_t run = (node->leaf >> LeafBit(x, y, 0)) & 0xF;
+                if (z_max >= 4)
+                {
+                    const size_t index = grid.index(x0 + x, y0 + y, z0);
+                    words[index / 64] |= run << (index % 64);
+                }
+                else
+                {
+                    for (size_t z = 0; z < z_max; ++z)
+                        grid.set(x0 + x, y0 + y, z, (run >> z) & 1);
+                }
+            }
+        return;
+    }
+
+    const size_t half = size_t(1) << (node->level - 1);
+    for (size_t octant = 0; octant < 8; ++octant)
+    {
+        ExtractNode(node->child[octant], x0 + ((octant >> 2) & 1) * half, y0 + ((octant >> 1) & 1) * half,
+                    z0 + (octant & 1) * half, grid);
+    }
+}
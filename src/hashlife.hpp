@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <tl/expected.hpp>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+
+/**
+ * HashLife engine: the world is a hash-consed octree of canonical nodes, and the result of
+ * evolving a node is memoized, so repeated regions are only computed once.
+ * Each repeat counts, however far apart in space or time it occurs.
+ *
+ * A node of level n covers a cube of side 2^n. Level 2 nodes are leaves holding their 4x4x4
+ * cells in one word (bit x * 16 + y * 4 + z). Evolving a level n node by 2^j steps
+ * (j <= n - 2) yields its centered level n - 1 cube. The rule reads only the six face
+ * neighbours, so nothing outside the node can reach the center in that time.
+ *
+ * Toroidal worlds are supported when every dimension is a power of two. The torus is tiled
+ * into a cube whose side L is the largest dimension. A tiling of such cubes evolves
+ * exactly like the torus, so 2^j steps are computed on a level log2(L) + 1 tiling (j <= log2(L) - 1)
+ * or on a tiling of level j + 2 for larger jumps. Because the tiles are periodic, each level
+ * adds one node. Advance() decomposes any step count into such power-of-two jumps.
+ */
+class HashLifeEngine
+{
+public:
+    // Fails unless all dimensions are powers of two.
+    static tl::expected<std::unique_ptr<HashLifeEngine>, std::string> Create(const BitPackedGrid3D &initial);
+    static bool SupportsDimensions(size_t x_max, size_t y_max, size_t z_max);
+
+    // Replaces the current state. Canonical nodes and memoized results are kept.
+    void Load(const BitPackedGrid3D &grid);
+    // Changing the rule drops the memoized results.
+    void SetRule(const Bitset128 &rule, RuleMode rule_mode);
+    void Advance(uint64_t num_steps);
+    // Writes the current state into `grid`, which must have the world's dimensions.
+    void Extract(BitPackedGrid3D &grid) const;
+
+    size_t num_nodes() const;
+    // Node count above which Advance() rebuilds the tables from the current state, dropping everything else
+    static constexpr size_t kMaxNodes = size_t(1) << 21;
+
+private:
+    static constexpr uint32_t kLeafLevel = 2;
+
+    struct Node
+    {
+        std::array<const Node *, 8> child; // octant (x_half << 2) | (y_half << 1) | z_half; unused for leaves
+        uint64_t leaf;                      // cells of a level 2 node
+        uint32_t level;
+        size_t hash;
+    };
+    struct NodeHash
+    {
+        size_t operator()(const Node *node) const { return node->hash; }
+    };
+    struct NodeEqual
+    {
+        bool operator()(const Node *a, const Node *b) const
+        {
+            return a->level == b->level && a->leaf == b->leaf && a->child == b->child;
+        }
+    };
+    struct ResultKeyHash
+    {
+        size_t operator()(const std::pair<const Node *, uint32_t> &key) const
+        {
+            return std::hash<const void *>()(key.first) * 31 + key.second;
+        }
+    };
+
+    // A cube's contents only depend on its origin modulo the world's dimensions
+    struct BuildKey
+    {
+        uint32_t level;
+        size_t x, y, z;
+        bool operator==(const BuildKey &other) const
+        {
+            return level == other.level && x == other.x && y == other.y && z == other.z;
+        }
+    };
+    struct BuildKeyHash
+    {
+        size_t operator()(const BuildKey &key) const
+        {
+            return ((key.level * 1000003ULL + key.x) * 1000003ULL + key.y) * 1000003ULL + key.z;
+        }
+    };
+    using BuildCache = std::unordered_map<BuildKey, const Node *, BuildKeyHash>;
+
+    HashLifeEngine(size_t x_max, size_t y_max, size_t z_max);
+
+    const Node *Intern(const Node &candidate);
+    const Node *Leaf(uint64_t cells);
+    const Node *Inner(const std::array<const Node *, 8> &children);
+    const Node *Empty(uint32_t level);
+    const Node *Build(const BitPackedGrid3D &grid, uint32_t level, size_t x0, size_t y0, size_t z0, BuildCache &built);
+
+    // Grandchild (gx, gy, gz) in {0..3}^3 of a node of level >= 4
+    static const Node *Grandchild(const Node *node, size_t gx, size_t gy, size_t gz);
+    // Centered level n - 1 cube of a level n >= 3 node, without stepping
+    const Node *Center(const Node *node);
+    // Centered level n - 1 cube of a level n >= 3 node after 2^j steps, j <= n - 2
+    const Node *Evolve(const Node *node, uint32_t j);
+    // Level 3 node, 1 or 2 steps, computed cell by cell
+    const Node *EvolveBase(const Node *node, uint32_t j);
+    void JumpPow2(uint32_t j);
+    // Re-interns the current state into fresh tables
+    void Collect();
+    const Node *Reintern(const Node *node, std::unordered_map<const Node *, const Node *> &copied);
+
+    void ExtractNode(const Node *node, size_t x0, size_t y0, size_t z0, BitPackedGrid3D &grid) const;
+
+    const size_t x_max, y_max, z_max;
+    uint32_t root_level; // log2 of the tiled cube's side
+    const Node *root = nullptr;
+
+    std::deque<Node> nodes;
+    std::unordered_set<const Node *, NodeHash, NodeEqual> canonical;
+    std::vector<const Node *> empty_nodes; // by level
+    std::unordered_map<std::pair<const Node *, uint32_t>, const Node *, ResultKeyHash> results;
+
+    // next state by neighbourhood index c<<6 | xm<<5 | xp<<4 | ym<<3 | yp<<2 | zm<<1 | zp
+    std::array<uint8_t, 128> rule_table{};
+    Bitset128 rule;
+    RuleMode rule_mode = RULE_3D;
+    bool has_rule = false;
+};
@@ -1,6 +1,6 @@
 #include "server.hpp"  
 
 int main(int argc, char** argv) {
-    RunServer();  // Start the gRPC server
+    RunServer(ParseServerOptions(argc, argv));  // Start the gRPC server
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+size_t PageSize()
+{
+    static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+} // namespace
+
+tl::expected<MappedFile, std::string> MappedFile::OpenReadOnly(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return tl::unexpected("Can't open " + path + ": " + std::strerror(errno));
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return tl::unexpected("Can't map empty or unreadable file " + path);
+    }
+    void *address = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file referenced
+    if (address == MAP_FAILED)
+        return tl::unexpected("Can't map " + path + ": " + std::strerror(errno));
+    return MappedFile(address, info.st_size);
+}
+
+tl::expected<MappedFile, std::string> MappedFile::Create(const std::string &path, size_t size)
+{
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return tl::unexpected("Can't create " + path + ": " + std::strerror(errno));
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        const std::string error = std::strerror(errno);
+        ::close(fd);
+        return tl::unexpected("Can't resize " + path + ": " + error);
+    }
+    void *address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+        return tl::unexpected("Can't map " + path + ": " + std::strerror(errno));
+    return MappedFile(address, size);
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept : address(other.address), length(other.length)
+{
+    other.address = nullptr;
+    other.length = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        Unmap();
+        std::swap(address, other.address);
+        std::swap(length, other.length);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Unmap();
+}
+
+void MappedFile::Unmap()
+{
+    if (address != nullptr)
+        ::munmap(address, length);
+    address = nullptr;
+    length = 0;
+}
+
+void MappedFile::AdviseSequential()
+{
+    ::madvise(address, length, MADV_SEQUENTIAL);
+}
+
+void MappedFile::AdviseWillNeed(size_t offset, size_t bytes)
+{
+    // WILLNEED may round outwards: it only triggers readahead
+    const size_t begin = offset / PageSize() * PageSize();
+    const size_t end = std::min(length, offset + bytes);
+    if (begin < end)
+        ::madvise(static_cast<char *>(address) + begin, end - begin, MADV_WILLNEED);
+}
+
+void MappedFile::AdviseDontNeed(size_t offset, size_t bytes)
+{
+    // DONTNEED must round inwards, or it would drop pages still in use next to the range
+    const size_t begin = (offset + PageSize() - 1) / PageSize() * PageSize();
+    const size_t end = std::min(length, offset + bytes) / PageSize() * PageSize();
+    if (begin < end)
+        ::madvise(static_cast<char *>(address) + begin, end - begin, MADV_DONTNEED);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <tl/expected.hpp>
+
+// Whole-file memory mapping, unmapped on destruction
+class MappedFile
+{
+public:
+    // Maps an existing file read-only
+    static tl::expected<MappedFile, std::string> OpenReadOnly(const std::string &path);
+    // Creates (or truncates) a file of `size` zero bytes and maps it read-write; stores reach the file
+    static tl::expected<MappedFile, std::string> Create(const std::string &path, size_t size);
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const char *data() const { return static_cast<const char *>(address); }
+    char *mutable_data() { return static_cast<char *>(address); }
+    size_t size() const { return length; }
+
+    // Access hints for [offset, offset + bytes); rounded to whole pages inside the range
+    void AdviseSequential();
+    void AdviseWillNeed(size_t offset, size_t bytes);
+    void AdviseDontNeed(size_t offset, size_t bytes);
+
+private:
+    MappedFile(void *address, size_t length) : address(address), length(length) {}
+    void Unmap();
+
+    void *address = nullptr;
+    size_t length = 0;
+};
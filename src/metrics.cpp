@@ -0,0 +1,167 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+size_t MetricShardIndex()
+{
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return shard;
+}
+
+uint64_t ShardedCounter::Value() const
+{
+    uint64_t total = 0;
+    for (const Shard &shard : shards)
+        total += shard.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+size_t LatencyHistogram::BucketFor(uint64_t nanos)
+{
+    if (nanos < kSubBuckets)
+        return nanos;
+    nanos = std::min(nanos, (uint64_t(1) << (kMaxExponent + 1)) - 1);
+    const unsigned exponent = 63 - __builtin_clzll(nanos); // >= 3
+    const size_t sub_bucket = (nanos >> (exponent - 3)) & (kSubBuckets - 1);
+    return (exponent - 2) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::BucketLowerBound(size_t bucket)
+{
+    if (bucket < kSubBuckets)
+        return bucket;
+    const unsigned exponent = bucket / kSubBuckets + 2;
+    return (kSubBuckets + bucket % kSubBuckets) << (exponent - 3);
+}
+
+void LatencyHistogram::Record(uint64_t nanos)
+{
+    Shard &shard = shards[MetricShardIndex()];
+    shard.buckets[BucketFor(nanos)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (nanos > max && !shard.max.compare_exchange_weak(max, nanos, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencyHistogram::Summary LatencyHistogram::Summarize() const
+{
+    std::array<uint64_t, kNumBuckets> counts{};
+    Summary summary;
+    for (const Shard &shard : shards)
+    {
+        for (size_t b = 0; b < kNumBuckets; ++b)
+            counts[b] += shard.buckets[b].load(std::memory_order_relaxed);
+        summary.max_ns = std::max(summary.max_ns, shard.max.load(std::memory_order_relaxed));
+    }
+    for (uint64_t count : counts)
+        summary.count += count;
+    if (summary.count == 0)
+        return summary;
+
+    // Midpoint of the bucket holding the quantile's rank
+    auto quantile = [&](double q)
+    {
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * summary.count + 0.5));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kNumBuckets; ++b)
+        {
+            seen += counts[b];
+            if (seen >= rank)
+            {
+                const double upper = b + 1 < kNumBuckets ? BucketLowerBound(b + 1) : summary.max_ns + 1;
+                return std::min<double>((BucketLowerBound(b) + upper) / 2, summary.max_ns);
+            }
+        }
+        return static_cast<double>(summary.max_ns);
+    };
+    summary.p50_ns = quantile(0.5);
+    summary.p99_ns = quantile(0.99);
+    summary.p999_ns = quantile(0.999);
+    return summary;
+}
+
+void ScopedTimer::Stop()
+{
+    const uint64_t elapsed = ElapsedNanos();
+    if (histogram != nullptr)
+        histogram->Record(elapsed);
+    if (nanos != nullptr)
+        nanos->Add(elapsed);
+    histogram = nullptr;
+    nanos = nullptr;
+}
+
+uint64_t ScopedTimer::ElapsedNanos() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char *MetricRpcName(MetricRpc rpc)
+{
+    switch (rpc)
+    {
+    case METRIC_RPC_INIT_WORLD_STATE:
+        return "InitWorldState";
+    case METRIC_RPC_STEP_WORLD_STATE_FORWARD:
+        return "StepWorldStateForward";
+    case METRIC_RPC_UPDATE_RULE:
+        return "UpdateRule";
+    case METRIC_RPC_START_SIMULATION:
+        return "StartSimulation";
+    case METRIC_RPC_STREAM_SIMULATION:
+        return "StreamSimulation";
+    case METRIC_RPC_DELETE_WORLD_STATE:
+        return "DeleteWorldState";
+    case METRIC_RPC_SAVE_SNAPSHOT:
+        return "SaveSnapshot";
+    case METRIC_RPC_LOAD_SNAPSHOT:
+        return "LoadSnapshot";
+    case METRIC_RPC_SWEEP_RULES:
+        return "SweepRules";
+    case METRIC_RPC_FETCH_WORLD_STATE:
+        return "FetchWorldState";
+    default:
+        return "unknown";
+    }
+}
+
+std::string ServerMetrics::PrometheusText(size_t live_world_states, size_t world_state_bytes) const
+{
+    std::ostringstream out;
+    out << "# HELP ca_rpc_latency_seconds RPC latency quantiles.\n"
+        << "# TYPE ca_rpc_latency_seconds summary\n";
+    for (size_t rpc = 0; rpc < kNumMetricRpcs; ++rpc)
+    {
+        const LatencyHistogram::Summary summary = rpc_latency[rpc].Summarize();
+        const std::string label = std::string("rpc=\"") + MetricRpcName(static_cast<MetricRpc>(rpc)) + "\"";
+        out << "ca_rpc_latency_seconds{" << label << ",quantile=\"0.5\"} " << summary.p50_ns / 1e9 << "\n"
+            << "ca_rpc_latency_seconds{" << label << ",quantile=\"0.99\"} " << summary.p99_ns / 1e9 << "\n"
+            << "ca_rpc_latency_seconds{" << label << ",quantile=\"0.999\"} " << summary.p999_ns / 1e9 << "\n"
+            << "ca_rpc_latency_seconds_count{" << label << "} " << summary.count << "\n";
+    }
+
+    auto counter = [&](const char *name, const char *help, double value)
+    {
+        out << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " counter\n"
+            << name << " " << value << "\n";
+    };
+    counter("ca_steps_total", "World-state steps executed.", steps.Value());
+    counter("ca_cell_updates_total", "Cells updated, summed over steps.", cell_updates.Value());
+    counter("ca_compute_seconds_total", "Time spent stepping.", compute_ns.Value() / 1e9);
+    counter("ca_serialization_seconds_total", "Time spent encoding grids into responses.", serialization_ns.Value() / 1e9);
+    counter("ca_sent_bytes_total", "Encoded grid and frame bytes sent.", bytes_sent.Value());
+    counter("ca_simulation_timeouts_total", "Simulations cut short by their timeout.", timeouts.Value());
+    counter("ca_stream_frames_dropped_total", "Stream frames dropped because the client was busy.", frames_dropped.Value());
+
+    out << "# HELP ca_world_states Live world states held in memory.\n"
+        << "# TYPE ca_world_states gauge\n"
+        << "ca_world_states " << live_world_states << "\n"
+        << "# HELP ca_world_state_bytes Memory held by the stored world states.\n"
+        << "# TYPE ca_world_state_bytes gauge\n"
+        << "ca_world_state_bytes " << world_state_bytes << "\n";
+    return out.str();
+}
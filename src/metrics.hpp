@@ -0,0 +1,125 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Low-overhead server instrumentation.
+ *
+ * Counters and histograms are split into kMetricShards cache-line-aligned shards, and every
+ * thread records into its own shard with relaxed atomic adds: recording never takes a lock
+ * and threads don't contend on a cache line unless more than kMetricShards threads record at
+ * once. Readers sum the shards, so a snapshot taken while recording is in flight may be off by
+ * the in-flight updates, but never tears a value.
+ */
+constexpr size_t kMetricShards = 16;
+
+// Shard of the calling thread, assigned round-robin on first use
+size_t MetricShardIndex();
+
+class ShardedCounter
+{
+public:
+    void Add(uint64_t value)
+    {
+        shards[MetricShardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+    uint64_t Value() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, kMetricShards> shards;
+};
+
+/**
+ * Log-linear histogram of durations in nanoseconds: 8 buckets per power of two, so quantiles
+ * are accurate to within 12.5%. Durations above 2^41 ns (about 37 minutes) share the last bucket.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr size_t kSubBuckets = 8;
+    static constexpr unsigned kMaxExponent = 40;
+    static constexpr size_t kNumBuckets = (kMaxExponent - 1) * kSubBuckets;
+
+    struct Summary
+    {
+        uint64_t count = 0;
+        double p50_ns = 0, p99_ns = 0, p999_ns = 0;
+        uint64_t max_ns = 0;
+    };
+
+    void Record(uint64_t nanos);
+    Summary Summarize() const;
+
+    static size_t BucketFor(uint64_t nanos);
+    static uint64_t BucketLowerBound(size_t bucket);
+
+private:
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, kNumBuckets> buckets{};
+        std::atomic<uint64_t> max{0};
+    };
+    std::array<Shard, kMetricShards> shards;
+};
+
+// Adds the time between construction and destruction to a histogram or to a nanosecond counter
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(LatencyHistogram &histogram) : histogram(&histogram) {}
+    explicit ScopedTimer(ShardedCounter &nanos) : nanos(&nanos) {}
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+    ~ScopedTimer() { Stop(); }
+
+    // Records the time so far; later calls and the destructor do nothing
+    void Stop();
+    uint64_t ElapsedNanos() const;
+
+private:
+    LatencyHistogram *histogram = nullptr;
+    ShardedCounter *nanos = nullptr;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+enum MetricRpc
+{
+    METRIC_RPC_INIT_WORLD_STATE,
+    METRIC_RPC_STEP_WORLD_STATE_FORWARD,
+    METRIC_RPC_UPDATE_RULE,
+    METRIC_RPC_START_SIMULATION,
+    METRIC_RPC_STREAM_SIMULATION,
+    METRIC_RPC_DELETE_WORLD_STATE,
+    METRIC_RPC_SAVE_SNAPSHOT,
+    METRIC_RPC_LOAD_SNAPSHOT,
+    METRIC_RPC_SWEEP_RULES,
+    METRIC_RPC_FETCH_WORLD_STATE,
+    kNumMetricRpcs
+};
+
+const char *MetricRpcName(MetricRpc rpc);
+
+// Everything the server records. Gauges (live states, stored bytes) are read from the store when reporting.
+struct ServerMetrics
+{
+    std::array<LatencyHistogram, kNumMetricRpcs> rpc_latency;
+
+    ShardedCounter steps;            // world-state steps executed
+    ShardedCounter cell_updates;     // cells times steps
+    ShardedCounter compute_ns;       // time spent stepping
+    ShardedCounter serialization_ns; // time spent encoding grids into responses
+    ShardedCounter bytes_sent;       // encoded grid and frame bytes
+    ShardedCounter timeouts;         // simulations cut short by their timeout
+    ShardedCounter frames_dropped;   // stream frames dropped because the client was busy
+
+    // Prometheus text exposition format, including the given gauges
+    std::string PrometheusText(size_t live_world_states, size_t world_state_bytes) const;
+};
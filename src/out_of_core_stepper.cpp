@@ -0,0 +1,132 @@
+#include "out_of_core_stepper.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include "fingerprint.hpp"
+#include "mapped_file.hpp"
+#include "snapshot_store.hpp"
+#include "step_kernel.hpp"
+
+OutOfCoreStepper::OutOfCoreStepper(size_t max_window_bytes)
+    : max_window_bytes(max_window_bytes), window(0, 0, 0), stepped_window(0, 0, 0) {}
+
+void OutOfCoreStepper::PrepareWindows(size_t slabs, size_t y_max, size_t z_max)
+{
+    if (window.x_max == slabs + 2 && window.y_max == y_max && window.z_max == z_max)
+        return;
+    window = BitPackedGrid3D(slabs + 2, y_max, z_max);
+    stepped_window = BitPackedGrid3D(slabs + 2, y_max, z_max);
+}
+
+tl::expected<OutOfCoreStats, std::string> OutOfCoreStepper::Step(const std::string &input_path, const std::string &output_path,
+                                                                 const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps)
+{
+    const std::string temp_paths[2] = {output_path + ".tmp0", output_path + ".tmp1"};
+    std::string current = input_path;
+    OutOfCoreStats stats;
+    for (uint64_t i = 0; i < num_steps; ++i)
+    {
+        const std::string &next = temp_paths[i % 2];
+        auto stepped = StepOnce(current, next, rule, rule_mode);
+        if (!stepped)
+        {
+            std::filesystem::remove(temp_paths[0]);
+            std::filesystem::remove(temp_paths[1]);
+            return stepped;
+        }
+        stats = *stepped;
+        current = next;
+    }
+
+    std::error_code error;
+    if (num_steps == 0)
+        std::filesystem::copy_file(input_path, output_path, std::filesystem::copy_options::overwrite_existing, error);
+    else
+        std::filesystem::rename(current, output_path, error);
+    std::filesystem::remove(temp_paths[0]);
+    std::filesystem::remove(temp_paths[1]);
+    if (error)
+        return tl::unexpected("Can't write " + output_path + ": " + error.message());
+    return stats;
+}
+
+tl::expected<OutOfCoreStats, std::string> OutOfCoreStepper::StepOnce(const std::string &input_path, const std::string &output_path,
+                                                                     const Bitset128 &rule, RuleMode rule_mode)
+{
+    auto input = MappedFile::OpenReadOnly(input_path);
+    if (!input)
+        return tl::unexpected(input.error());
+    auto parsed = SnapshotHeader::Parse(input->data(), input->size(), input_path);
+    if (!parsed)
+        return tl::unexpected(parsed.error());
+    const SnapshotHeader &header = *parsed;
+    if (header.layout() != GRID_LAYOUT_ROW_MAJOR)
+        return tl::unexpected("Snapshot " + input_path + " isn't row-major: out-of-core stepping works on x-slabs");
+
+    auto output = MappedFile::Create(output_path, input->size());
+    if (!output)
+        return tl::unexpected(output.error());
+
+    const size_t x_max = header.x_max;
+    const size_t slab_bits = header.y_max * header.z_max;
+    const size_t num_words = header.num_words();
+    const uint64_t *in_words = reinterpret_cast<const uint64_t *>(input->data() + sizeof(SnapshotHeader));
+    uint64_t *out_words = reinterpret_cast<uint64_t *>(output->mutable_data() + sizeof(SnapshotHeader));
+    auto file_offset = [&](size_t slab)
+    { return sizeof(SnapshotHeader) + slab * slab_bits / 8; };
+
+    // Balanced chunks of at most max_slabs slabs, so every chunk fits one window
+    const size_t window_slabs = max_window_bytes * 8 / slab_bits;
+    const size_t max_slabs = std::min(x_max, window_slabs > 3 ? window_slabs - 2 : 1);
+    const size_t num_chunks = (x_max + max_slabs - 1) / max_slabs;
+    const size_t chunk_slabs = (x_max + num_chunks - 1) / num_chunks;
+    PrepareWindows(chunk_slabs, header.y_max, header.z_max);
+    input->AdviseSequential();
+
+    Fingerprint128 input_fingerprint;
+    Fingerprint128 output_fingerprint;
+    size_t fingerprinted_words = 0;
+    for (size_t x0 = 0; x0 < x_max; x0 += chunk_slabs)
+    {
+        const size_t slabs = std::min(chunk_slabs, x_max - x0);
+        // Slabs x0 - 1 .. x0 + slabs, wrapping around x. Window slabs past slabs + 1 keep stale data;
+        // only their own outputs, which are discarded, depend on it.
+        for (size_t i = 0; i < slabs + 2; ++i)
+        {
+            const size_t slab = (x0 + x_max - 1 + i) % x_max;
+            CopyBits(in_words, slab * slab_bits, window.raw().data(), i * slab_bits, slab_bits);
+        }
+        // The next chunk reuses our last two slabs and reads up to chunk_slabs new ones
+        const size_t ahead_begin = std::min(x_max, x0 + slabs + 1);
+        const size_t ahead_end = std::min(x_max, ahead_begin + chunk_slabs);
+        input->AdviseWillNeed(file_offset(ahead_begin), file_offset(ahead_end) - file_offset(ahead_begin));
+
+        StepGrid(window, stepped_window, rule, rule_mode);
+        CopyBits(stepped_window.raw().data(), slab_bits, out_words, x0 * slab_bits, slabs * slab_bits);
+
+        // Words before the next chunk's first bit are final in both files
+        const size_t final_words = x0 + slabs == x_max ? num_words : (x0 + slabs) * slab_bits / 64;
+        input_fingerprint ^= FingerprintWords(in_words, fingerprinted_words, final_words);
+        output_fingerprint ^= FingerprintWords(out_words, fingerprinted_words, final_words);
+        fingerprinted_words = final_words;
+        // Slab 0 is read again by the last chunk, which is cheaper than keeping it resident
+        const size_t drop_begin = x0 == 0 ? 0 : x0 - 1;
+        input->AdviseDontNeed(file_offset(drop_begin), file_offset(x0 + slabs - 1) - file_offset(drop_begin));
+    }
+
+    if (input_fingerprint.lo != header.fingerprint_lo || input_fingerprint.hi != header.fingerprint_hi)
+    {
+        std::filesystem::remove(output_path);
+        return tl::unexpected("Snapshot " + input_path + " fails its checksum");
+    }
+
+    const SnapshotHeader output_header = SnapshotHeader::Make(header.x_max, header.y_max, header.z_max, header.step + 1, rule_mode,
+                                                              (header.flags & SnapshotHeader::kFlagHashLife) != 0, output_fingerprint);
+    std::memcpy(output->mutable_data(), &output_header, sizeof(output_header));
+
+    OutOfCoreStats stats;
+    stats.chunks = num_chunks;
+    stats.chunk_slabs = chunk_slabs;
+    return stats;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tl/expected.hpp>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+
+struct OutOfCoreStats
+{
+    size_t chunks = 0;      // windows stepped per step
+    size_t chunk_slabs = 0; // output x-slabs per window
+};
+
+/**
+ * Steps grids stored in snapshot files (see SnapshotHeader) without holding them in memory.
+ *
+ * The input file is mapped and read in x order. For each chunk of k consecutive x-slabs the
+ * stepper copies slabs x0 - 1 .. x0 + k (modulo x_max) into a (k + 2, y_max, z_max) window,
+ * steps the window with the word-parallel kernel and writes its middle k slabs into the mapped
+ * output file. The halo slabs give the chunk's outer slabs their x neighbours, including the
+ * toroidal wrap at x = 0 and x = x_max - 1, and y/z wrap within a slab, so the result is
+ * bit-identical to stepping the whole grid. Chunks are sized evenly, so a smaller last chunk
+ * still fits the same window: only the two window grids are allocated, once;
+ * consumed input pages are dropped and the next chunk's are read ahead, so resident memory
+ * stays around max_window_bytes and the page cache streams the files.
+ *
+ * The input's fingerprint is verified on the fly; on a mismatch the output isn't written.
+ * Only row-major snapshots can be stepped: brick layout snapshots have no contiguous x-slabs.
+ */
+class OutOfCoreStepper
+{
+public:
+    static constexpr size_t kDefaultWindowBytes = size_t(256) << 20;
+
+    // max_window_bytes bounds one window grid; a window always holds at least three slabs
+    explicit OutOfCoreStepper(size_t max_window_bytes = kDefaultWindowBytes);
+
+    // Steps the grid in input_path num_steps times and writes the result, with its step count
+    // advanced, to output_path. States are written to temporary files next to output_path and the
+    // last one is renamed into place, so output_path may equal input_path.
+    tl::expected<OutOfCoreStats, std::string> Step(const std::string &input_path, const std::string &output_path,
+                                                   const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps = 1);
+
+private:
+    tl::expected<OutOfCoreStats, std::string> StepOnce(const std::string &input_path, const std::string &output_path,
+                                                       const Bitset128 &rule, RuleMode rule_mode);
+    // Allocates the windows for chunks of `slabs` slabs, keeping them if they already have that shape
+    void PrepareWindows(size_t slabs, size_t y_max, size_t z_max);
+
+    const size_t max_window_bytes;
+    BitPackedGrid3D window;
+    BitPackedGrid3D stepped_window;
+};
@@ -4,6 +4,7 @@
 #include <random>
 #include <ctime>
 #include <vector>
+#include <array>
 
 // Constants for the number of possible configurations for a 2-bit sequence
 constexpr size_t NUM_BIT_MAPS = 4;
@@ -111,6 +112,17 @@ Bitset128 ParseBitSetRuleFromString(const std::string &rule_str)
     return rule;
 }
 
+std::string SerializeBitSetRuleToString(const Bitset128 &rule)
+{
+    std::string bytes(16, '\0');
+    for (size_t bit = 0; bit < 128; ++bit)
+    {
+        if (rule.test(bit))
+            bytes[bit / 8] = static_cast<char>(bytes[bit / 8] | (1 << (bit % 8)));
+    }
+    return bytes;
+}
+
 // See Elementary Cellular Automata: https://content.wolfram.com/sites/13/2019/06/28-2-4.pdf
 Bitset128 build_from_eca(uint8_t eca_rule_number)
 {
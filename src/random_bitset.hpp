@@ -4,6 +4,7 @@
 #include <bitset>
 #include <unordered_map>
 #include <tuple>
+#include <string>
 #include <cstdint> // fixed-width integer types like uint8_t and uint64_t,
 
 using Bitset128 = std::bitset<128>;
@@ -36,6 +37,9 @@ Bitset128 ParseBitSetRuleFromInteger(uint64_t rule_number);
  */
 Bitset128 ParseBitSetRuleFromString(const std::string &rule_str);
 
+// Inverse of ParseBitSetRuleFromString: bit i of the rule is bit i % 8 of byte i / 8
+std::string SerializeBitSetRuleToString(const Bitset128 &rule);
+
 // See Elementary Cellular Automata: https://content.wolfram.com/sites/13/2019/06/28-2-4.pdf
 Bitset128 build_from_eca(uint8_t eca_rule_number);
 
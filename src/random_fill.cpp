@@ -0,0 +1,93 @@
+#include "random_fill.hpp"
+
+#include <cmath>
+#include "thread_pool.hpp"
+
+namespace
+{
+constexpr uint64_t kGamma = 0x9e3779b97f4a7c15;
+
+// SplitMix64's output function
+uint64_t Mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// The stream of a seed is keyed by its mix, so nearby seeds don't give shifted copies of each other
+uint64_t StreamKey(uint64_t seed)
+{
+    return Mix(seed);
+}
+
+uint64_t KeyedWord(uint64_t key, uint64_t counter)
+{
+    return Mix(key + (counter + 1) * kGamma);
+}
+
+uint64_t KeyedCellsWord(uint64_t key, uint64_t word_index, uint32_t numerator)
+{
+    constexpr uint32_t kOne = uint32_t(1) << kRandomFillDensityBits;
+    if (numerator == 0)
+        return 0;
+    if (numerator >= kOne)
+        return ~uint64_t(0);
+
+    // Bit b of the numerator has weight 2^(b - kRandomFillDensityBits); the lowest set bit seeds the
+    // word and each higher bit halves (AND) or halves and adds one half (OR) the live probability
+    const uint64_t first_counter = word_index * kRandomFillDensityBits;
+    unsigned bit = __builtin_ctz(numerator);
+    uint64_t word = KeyedWord(key, first_counter + bit);
+    for (++bit; bit < kRandomFillDensityBits; ++bit)
+    {
+        const uint64_t random = KeyedWord(key, first_counter + bit);
+        word = (numerator >> bit) & 1 ? word | random : word & random;
+    }
+    return word;
+}
+} // namespace
+
+uint64_t RandomWord(uint64_t seed, uint64_t counter)
+{
+    return KeyedWord(StreamKey(seed), counter);
+}
+
+uint64_t RandomCellsWord(uint64_t seed, uint64_t word_index, uint32_t numerator)
+{
+    return KeyedCellsWord(StreamKey(seed), word_index, numerator);
+}
+
+uint32_t DensityNumerator(double density)
+{
+    return static_cast<uint32_t>(std::lround(density * (uint32_t(1) << kRandomFillDensityBits)));
+}
+
+void FillRandom(BitPackedGrid3D &grid, uint64_t seed, double density)
+{
+    FillRandom(grid, seed, density, ThreadPool::Shared());
+}
+
+void FillRandom(BitPackedGrid3D &grid, uint64_t seed, double density, ThreadPool &pool)
+{
+    if (grid.layout() != GRID_LAYOUT_ROW_MAJOR)
+    {
+        BitPackedGrid3D row_major(grid.x_max, grid.y_max, grid.z_max);
+        FillRandom(row_major, seed, density, pool);
+        grid = row_major.WithLayout(grid.layout());
+        return;
+    }
+
+    const uint64_t key = StreamKey(seed);
+    const uint32_t numerator = DensityNumerator(density);
+    std::vector<uint64_t> &words = grid.raw();
+    pool.ParallelFor(0, words.size(), size_t(1) << 12, [&](size_t begin, size_t end)
+                     {
+        for (size_t i = begin; i < end; ++i)
+            words[i] = KeyedCellsWord(key, i, numerator); });
+
+    // Bits past the last cell stay clear, as the kernel and the encoders expect
+    const size_t tail = grid.size_in_bits() % 64;
+    if (tail != 0 && !words.empty())
+        words.back() &= (uint64_t(1) << tail) - 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "bit_packed_grid_3d.hpp"
+
+class ThreadPool;
+
+/**
+ * Reproducible random worlds.
+ *
+ * Cells are generated 64 at a time, one grid word per call, from a counter-based generator: the
+ * random words behind grid word i are a pure function of (seed, i), so any split of the words
+ * across threads produces the same grid, and a seed names a world the way a rule names a rule.
+ *
+ * A word with live-cell density p is built from the binary expansion 0.b1 b2 ... bn of p: starting
+ * from the lowest set bit, each step ORs (bit 1) or ANDs (bit 0) in a fresh uniform word, which
+ * maps a cell's probability q to (1 + q) / 2 or q / 2. That takes as many random words as p has
+ * significant bits, e.g. one for 0.5 and two for 0.25 or 0.75.
+ */
+
+// Densities are rounded to the nearest multiple of 2^-kRandomFillDensityBits
+constexpr unsigned kRandomFillDensityBits = 16;
+
+// Word `counter` of the random stream named by seed (SplitMix64 evaluated at position counter)
+uint64_t RandomWord(uint64_t seed, uint64_t counter);
+
+// 64 independent cells, each live with probability numerator / 2^kRandomFillDensityBits.
+// word_index selects the random words used, so equal arguments give equal words.
+uint64_t RandomCellsWord(uint64_t seed, uint64_t word_index, uint32_t numerator);
+
+// Density's numerator over 2^kRandomFillDensityBits; density must be in [0, 1]
+uint32_t DensityNumerator(double density);
+
+// Overwrites every cell of the grid with an independent cell that is live with probability density
+// (in [0, 1]). Cells are drawn in row-major order whatever the grid's layout, so a seed gives the
+// same world in every layout. Words are filled on the pool (ThreadPool::Shared() by default) with
+// results independent of its size.
+void FillRandom(BitPackedGrid3D &grid, uint64_t seed, double density);
+void FillRandom(BitPackedGrid3D &grid, uint64_t seed, double density, ThreadPool &pool);
@@ -0,0 +1,173 @@
+#include "rule_compiler.hpp"
+
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace
+{
+// Plans kept before the cache starts over; rule sweeps cover at most 256 ECA rules at a time
+constexpr size_t kMaxCachedPlans = size_t(1) << 12;
+
+// Rule index bits: c << 6 | xm << 5 | xp << 4 | ym << 3 | yp << 2 | zm << 1 | zp
+constexpr size_t kCenterBit = 6;
+
+struct PlanKey
+{
+    uint64_t lo, hi;
+    RuleMode rule_mode;
+    bool operator==(const PlanKey &other) const { return lo == other.lo && hi == other.hi && rule_mode == other.rule_mode; }
+};
+
+struct PlanKeyHash
+{
+    size_t operator()(const PlanKey &key) const
+    {
+        return static_cast<size_t>((key.lo * 0x9E3779B97F4A7C15ULL) ^ key.hi ^ (static_cast<uint64_t>(key.rule_mode) << 63));
+    }
+};
+
+struct PlanCache
+{
+    std::shared_mutex mutex;
+    std::unordered_map<PlanKey, std::shared_ptr<const RulePlan>, PlanKeyHash> plans;
+};
+
+PlanCache &Cache()
+{
+    static PlanCache cache;
+    return cache;
+}
+
+PlanKey MakeKey(const Bitset128 &rule, RuleMode rule_mode)
+{
+    PlanKey key{0, 0, rule_mode};
+    for (size_t i = 0; i < 64; ++i)
+    {
+        key.lo |= static_cast<uint64_t>(rule[i]) << i;
+        key.hi |= static_cast<uint64_t>(rule[i + 64]) << i;
+    }
+    return key;
+}
+
+// Output of the effective rule for every index; ECA reads the y and z pairs as 0
+std::array<bool, 128> EffectiveTable(const Bitset128 &rule, RuleMode rule_mode)
+{
+    std::array<bool, 128> table{};
+    for (size_t index = 0; index < 128; ++index)
+        table[index] = rule[rule_mode == RULE_1D_ECA ? index & 0x70 : index];
+    return table;
+}
+
+// Whether flipping any of the given index bits can change the output
+bool Reads(const std::array<bool, 128> &table, size_t bits)
+{
+    for (size_t index = 0; index < 128; ++index)
+    {
+        for (size_t bit = 0; bit < 7; ++bit)
+        {
+            if ((bits >> bit) & 1 && table[index] != table[index ^ (size_t(1) << bit)])
+                return true;
+        }
+    }
+    return false;
+}
+
+RulePlan Analyze(const Bitset128 &rule, RuleMode rule_mode)
+{
+    const std::array<bool, 128> table = EffectiveTable(rule, rule_mode);
+    RulePlan plan;
+    plan.reads_center = Reads(table, size_t(1) << kCenterBit);
+    plan.reads_x = Reads(table, 0x30);
+    plan.reads_y = Reads(table, 0x0C);
+    plan.reads_z = Reads(table, 0x03);
+
+    bool all_dead = true, all_live = true, identity = true;
+    plan.symmetric = true;
+    plan.totalistic = true;
+    // Output seen per (central cell, live neighbours), -1 while unseen
+    int by_count[2][7];
+    for (auto &row : by_count)
+        for (int &value : row)
+            value = -1;
+    for (size_t index = 0; index < 128; ++index)
+    {
+        const bool live = table[index];
+        all_dead = all_dead && !live;
+        all_live = all_live && live;
+        identity = identity && live == ((index >> kCenterBit) & 1);
+
+        for (size_t pair = 0; pair < 3; ++pair)
+        {
+            // Swap the minus and plus cells of the pair
+            const size_t m = (index >> (2 * pair + 1)) & 1;
+            const size_t p = (index >> (2 * pair)) & 1;
+            const size_t mirrored = (index & ~(size_t(3) << (2 * pair))) | (p << (2 * pair + 1)) | (m << (2 * pair));
+            plan.symmetric = plan.symmetric && table[mirrored] == live;
+        }
+
+        // ECA only has the x pair: other indices repeat the y = z = 0 outputs
+        if (rule_mode == RULE_1D_ECA && (index & 0x0F) != 0)
+            continue;
+        int &seen = by_count[(index >> kCenterBit) & 1][__builtin_popcount(static_cast<unsigned>(index & 0x3F))];
+        plan.totalistic = plan.totalistic && (seen == -1 || seen == static_cast<int>(live));
+        seen = live;
+    }
+    plan.kind = all_dead ? RULE_PLAN_ALL_DEAD : all_live ? RULE_PLAN_ALL_LIVE : identity ? RULE_PLAN_IDENTITY : RULE_PLAN_GENERAL;
+
+    const bool eca = rule_mode == RULE_1D_ECA;
+    for (size_t shape = 0; shape < 4; ++shape)
+    {
+        const bool uses_y = (shape & 2) != 0;
+        const bool uses_z = (shape & 1) != 0;
+        // Reduced index, least significant first: [z+, z-,] [y+, y-,] x+, x-, central bit
+        const size_t num_vars = 3 + (uses_y ? 2 : 0) + (uses_z ? 2 : 0);
+        for (size_t reduced = 0; reduced < (size_t(1) << num_vars); ++reduced)
+        {
+            size_t bit = 0;
+            auto next_var = [&]
+            { return static_cast<uint8_t>((reduced >> bit++) & 1); };
+            const uint8_t zp = uses_z ? next_var() : 0;
+            const uint8_t zm = uses_z ? next_var() : 0;
+            const uint8_t yp = uses_y ? next_var() : 0;
+            const uint8_t ym = uses_y ? next_var() : 0;
+            const uint8_t xp = next_var();
+            const uint8_t xm = next_var();
+            const uint8_t central = next_var();
+
+            const uint8_t self_pair = eca ? 0 : static_cast<uint8_t>((central << 1) | central);
+            const uint8_t y_pair = uses_y ? static_cast<uint8_t>((ym << 1) | yp) : self_pair;
+            const uint8_t z_pair = uses_z ? static_cast<uint8_t>((zm << 1) | zp) : self_pair;
+            const uint64_t value = -static_cast<uint64_t>(does_cell_live(rule, central, (xm << 1) | xp, y_pair, z_pair));
+            (reduced % 2 == 0 ? plan.leaf_clear : plan.leaf_set)[shape][reduced / 2] = value;
+        }
+    }
+    return plan;
+}
+} // namespace
+
+std::shared_ptr<const RulePlan> CompileRule(const Bitset128 &rule, RuleMode rule_mode)
+{
+    const PlanKey key = MakeKey(rule, rule_mode);
+    PlanCache &cache = Cache();
+    {
+        std::shared_lock<std::shared_mutex> lock(cache.mutex);
+        auto it = cache.plans.find(key);
+        if (it != cache.plans.end())
+            return it->second;
+    }
+
+    // Compiled outside the lock; a concurrent compile of the same rule yields the same plan
+    auto plan = std::make_shared<const RulePlan>(Analyze(rule, rule_mode));
+    std::unique_lock<std::shared_mutex> lock(cache.mutex);
+    if (cache.plans.size() >= kMaxCachedPlans)
+        cache.plans.clear();
+    return cache.plans.emplace(key, std::move(plan)).first->second;
+}
+
+size_t CompiledRuleCacheSize()
+{
+    PlanCache &cache = Cache();
+    std::shared_lock<std::shared_mutex> lock(cache.mutex);
+    return cache.plans.size();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "random_bitset.hpp"
+
+enum RulePlanKind
+{
+    RULE_PLAN_GENERAL,  // evaluated by the step kernel's multiplexer tree
+    RULE_PLAN_ALL_DEAD, // every cell dies
+    RULE_PLAN_ALL_LIVE, // every cell lives
+    RULE_PLAN_IDENTITY  // every cell keeps its state
+};
+
+/**
+ * What a rule actually computes, worked out once from its 128 bits.
+ *
+ * The analysis runs on the effective rule of the rule mode (ECA reads the y and z pairs as 0),
+ * so a pair the rule never distinguishes counts as unread even in RULE_3D: the step kernel
+ * then reads fewer neighbour words and evaluates a smaller multiplexer tree.
+ */
+struct RulePlan
+{
+    RulePlanKind kind = RULE_PLAN_GENERAL;
+    // Inputs the rule's output depends on
+    bool reads_center = false;
+    bool reads_x = false;
+    bool reads_y = false;
+    bool reads_z = false;
+    // Unchanged by mirroring any axis, i.e. by swapping the two cells of any neighbour pair
+    bool symmetric = false;
+    // Depends only on the central cell and the number of live neighbours
+    bool totalistic = false;
+
+    // Leaves of the step kernel's multiplexer tree (see step_kernel_impl.hpp) for a kernel reading
+    // the x pair, plus the y pair if bit 1 of the index is set and the z pair if bit 0 is. Pairs
+    // that aren't read are folded in as 0 under ECA and as the central cell otherwise, which is
+    // what an axis of length 1 holds; a pair the rule doesn't read may be folded either way.
+    std::array<std::array<uint64_t, 64>, 4> leaf_clear{};
+    std::array<std::array<uint64_t, 64>, 4> leaf_set{};
+
+    static size_t LeafIndex(bool uses_y, bool uses_z) { return (uses_y ? 2 : 0) | (uses_z ? 1 : 0); }
+};
+
+// Analyzes a rule. Plans are cached by rule bits and mode and shared by every caller, so
+// requests sending the same rule over and over only compile it once.
+std::shared_ptr<const RulePlan> CompileRule(const Bitset128 &rule, RuleMode rule_mode);
+
+// Number of plans currently cached
+size_t CompiledRuleCacheSize();
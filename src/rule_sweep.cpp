@@ -0,0 +1,61 @@
+#include "rule_sweep.hpp"
+
+#include <algorithm>
+#include "cycle_detector.hpp"
+#include "double_buffered_grid.hpp"
+#include "entropy_tracker.hpp"
+#include "thread_pool.hpp"
+
+RuleSummary SimulateRule(const BitPackedGrid3D &initial, const Bitset128 &rule, RuleMode rule_mode,
+                         const RuleSweepOptions &options, const std::function<bool()> &keep_going)
+{
+    RuleSummary summary;
+    DoubleBufferedGrid state(initial);
+    CycleDetector cycle_detector(initial, state.fingerprint());
+    EntropyTracker entropy_tracker(options.max_tracked_states);
+    if (options.track_states)
+        entropy_tracker.observe(state.fingerprint());
+
+    while (summary.steps < options.num_steps && keep_going())
+    {
+        state.Step(rule, rule_mode);
+        ++summary.steps;
+        if (options.track_states)
+            entropy_tracker.observe(state.fingerprint());
+        if (cycle_detector.Observe(state.front(), state.fingerprint()))
+            break;
+    }
+
+    if (cycle_detector.period() != 0)
+    {
+        summary.cycle_period = cycle_detector.period();
+        summary.cycle_detected_at_step = summary.steps;
+        const uint64_t remaining = (options.num_steps - summary.steps) % summary.cycle_period;
+        state.Advance(rule, rule_mode, remaining);
+        summary.steps = options.num_steps;
+
+        auto transient = FindTransientLength(initial, rule, rule_mode, summary.cycle_period, keep_going);
+        if (transient)
+            summary.transient_length = static_cast<int64_t>(*transient);
+    }
+
+    summary.final_population = state.front().population();
+    summary.state_changed = !(state.front() == initial);
+    if (options.track_states)
+        summary.state_entropy = entropy_tracker.entropy();
+    if (options.spatial)
+        summary.spatial_entropy = BlockPatternEntropy(state.front());
+    return summary;
+}
+
+std::vector<RuleSummary> SweepRules(const BitPackedGrid3D &initial, const std::vector<Bitset128> &rules, RuleMode rule_mode,
+                                    const RuleSweepOptions &options, const std::function<bool()> &keep_going, size_t num_threads)
+{
+    std::vector<RuleSummary> summaries(rules.size());
+    ThreadPool pool(std::min(std::max<size_t>(num_threads, 1), std::max<size_t>(rules.size(), 1)));
+    pool.ParallelFor(0, rules.size(), 1, [&](size_t begin, size_t end)
+                     {
+        for (size_t i = begin; i < end; ++i)
+            summaries[i] = SimulateRule(initial, rules[i], rule_mode, options, keep_going); });
+    return summaries;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+
+struct RuleSweepOptions
+{
+    uint64_t num_steps = 0;
+    bool track_states = false; // entropy of the visited-state distribution
+    size_t max_tracked_states = 0; // see EntropyTracker
+    bool spatial = false; // block pattern entropy of the final state
+};
+
+// Outcome of simulating one rule from the shared initial state
+struct RuleSummary
+{
+    uint64_t steps = 0; // steps reached, num_steps unless keep_going() stopped the run
+    size_t final_population = 0;
+    bool state_changed = false; // final state differs from the initial one
+    uint64_t cycle_period = 0; // 0 if no state repeated within the run
+    uint64_t cycle_detected_at_step = 0;
+    int64_t transient_length = -1; // -1 if no cycle was found or it couldn't be measured in time
+    double state_entropy = 0.0;
+    double spatial_entropy = 0.0;
+};
+
+/**
+ * Simulates one rule like StartSimulation does: steps until num_steps or a repeated state, and in
+ * the latter case steps only the remainder modulo the period to reach the final state.
+ */
+RuleSummary SimulateRule(const BitPackedGrid3D &initial, const Bitset128 &rule, RuleMode rule_mode,
+                         const RuleSweepOptions &options, const std::function<bool()> &keep_going);
+
+/**
+ * Simulates every rule from the same initial state, one rule per task on num_threads threads
+ * (a private pool, so a long sweep doesn't hold up the shared one). Each rule's steps run on its
+ * own thread. keep_going() is polled from all of them and must be thread-safe.
+ */
+std::vector<RuleSummary> SweepRules(const BitPackedGrid3D &initial, const std::vector<Bitset128> &rules, RuleMode rule_mode,
+                                    const RuleSweepOptions &options, const std::function<bool()> &keep_going, size_t num_threads);
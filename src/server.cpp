@@ -2,15 +2,41 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <charconv>
 #include <cstdint>
 #include <chrono>
 #include <stdexcept>
+#include <climits>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
 
 #include <tl/expected.hpp>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
 #include "sim_server.grpc.pb.h"
+#include "grid_proto.hpp"
+#include "grid_region.hpp"
 #include "world_state.hpp"
+#include "world_state_store.hpp"
+#include "cycle_detector.hpp"
+#include "cluster.hpp"
+#include "entropy_tracker.hpp"
+#include "frame_pacer.hpp"
+#include "metrics.hpp"
+#include "rule_sweep.hpp"
+#include "snapshot_store.hpp"
+#include "step_kernel.hpp"
+#include "task_executor.hpp"
+#include "thread_pool.hpp"
+#include "server.hpp"
 
 using grpc::Server;
 using grpc::ServerBuilder;
@@ -24,28 +50,43 @@ using sim_server::Vector1D;
 using sim_server::Vector2D;
 using sim_server::Vector3D;
 
-class StateServiceImpl final : public StateService::Service
+/**
+ * Implementation of the StateService RPCs, independent of the gRPC API flavour serving them.
+ * StateServiceImpl (sync API) and AsyncStateServiceImpl (callback API) forward to it.
+ */
+class StateServiceCore
 {
 public:
     static const uint64_t kDefaultSimulationTimeoutSeconds = 3;
 
-    Status InitWorldState(ServerContext *context, const sim_server::InitializeRequest *request,
-                          sim_server::WorldStateResponse *reply) override
+    // max_concurrent_simulations == 0 means unlimited, max_state_bytes == 0 means no memory budget.
+    // Without a snapshot store SaveSnapshot and LoadSnapshot fail. With a cluster, word-parallel
+    // states are stepped on its workers.
+    StateServiceCore(size_t max_concurrent_simulations, size_t max_state_bytes, std::unique_ptr<SnapshotStore> snapshots = nullptr,
+                     std::unique_ptr<ClusterCoordinator> cluster = nullptr)
+        : max_concurrent_simulations(max_concurrent_simulations), store(max_state_bytes), snapshots(std::move(snapshots)),
+          cluster(std::move(cluster))
     {
-        size_t x_max = request->dimensions().x_max();
-        size_t y_max = request->dimensions().y_max();
-        size_t z_max = request->dimensions().z_max();
+        // Snapshotted states keep their ids across restarts
+        if (this->snapshots && this->snapshots->max_id())
+            states.next_world_state_id = *this->snapshots->max_id() + 1;
+    }
 
-        auto result = InitWorldStateInternal(x_max, y_max, z_max);
+    Status InitWorldState(grpc::ServerContextBase *context, const sim_server::InitializeRequest *request,
+                          sim_server::WorldStateResponse *reply)
+    {
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_INIT_WORLD_STATE]);
+        auto result = InitWorldStateInternal(*request);
         if (!result)
         {
-            return Status(grpc::StatusCode::INVALID_ARGUMENT, result.error());
+            return result.error();
         }
 
-        const auto &[id, grid] = *result;
+        const auto &[id, entry] = *result;
+        std::shared_lock<std::shared_mutex> lock(entry->mutex);
 
         // Serialize the generated world state into the response
-        ConvertGrid3DToProto(grid, *reply->mutable_state());
+        SerializeGridMeasured(entry->state.front(), request->encoding(), *reply);
         reply->mutable_metadata()->set_state_id(id);
         reply->mutable_metadata()->set_step(0);
         reply->mutable_metadata()->set_status("World state initialized");
@@ -53,44 +94,40 @@ public:
         return Status::OK;
     }
 
-    Status StepWorldStateForward(ServerContext *context, const sim_server::StepRequest *request,
-                                 sim_server::WorldStateResponse *reply) override
+    Status StepWorldStateForward(grpc::ServerContextBase *context, const sim_server::StepRequest *request,
+                                 sim_server::WorldStateResponse *reply)
     {
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_STEP_WORLD_STATE_FORWARD]);
         Bitset128 rule = ParseBitSetRuleFromString(request->rule());
         const uint64_t world_state_id = request->world_state_id();
 
-        auto step_state_result = StepWorldStateForwardInternal(world_state_id, rule);
-        if (!step_state_result)
+        auto entry_result = FindEntry(world_state_id);
+        if (!entry_result)
         {
-            return Status(grpc::StatusCode::INTERNAL, step_state_result.error());
+            return entry_result.error();
         }
 
-        BitPackedGrid3D updated_world_state = *step_state_result;
+        const uint64_t num_steps = request->has_num_steps() ? std::max<int64_t>(request->num_steps(), 0) : 1;
 
-        // Save the updated state
-        set_world_state_by_id(world_state_id, updated_world_state);
+        WorldStateEntry &entry = **entry_result;
+        std::unique_lock<std::shared_mutex> lock(entry.mutex);
+        const ActiveStepStats stats = StepWorldStateForwardInternal(entry, rule, num_steps);
 
         // Serialize the updated world state into the response
-        ConvertGrid3DToProto(updated_world_state, *reply->mutable_state());
+        SerializeGridMeasured(entry.state.front(), request->encoding(), *reply);
         reply->mutable_metadata()->set_state_id(world_state_id);
-
-        auto get_step_result = get_step_by_world_state_id(world_state_id);
-        if (!get_step_result)
-        {
-            return Status(grpc::StatusCode::INTERNAL, get_step_result.error());
-        }
-
-        size_t new_step = *get_step_result;
-        reply->mutable_metadata()->set_step(new_step + 1);
+        reply->mutable_metadata()->set_step(entry.step);
         reply->mutable_metadata()->set_status("World state stepped forward");
+        SetStatsMetadata(stats, *reply->mutable_metadata());
 
         return Status::OK;
     }
 
     // Only parses rule. Rule is not persisted past lifetime of request
-    Status UpdateRule(ServerContext *context, const sim_server::UpdateRuleRequest *request,
-                      sim_server::UpdateRuleResponse *reply) override
+    Status UpdateRule(grpc::ServerContextBase *context, const sim_server::UpdateRuleRequest *request,
+                      sim_server::UpdateRuleResponse *reply)
     {
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_UPDATE_RULE]);
         reply->set_world_state_id(request->world_state_id());
         reply->set_rule_number(request->rule_number());
 
@@ -103,135 +140,729 @@ public:
         return Status::OK;
     }
 
-    Status StartSimulation(ServerContext *context, const sim_server::StartSimulationRequest *request,
-                           sim_server::SimulationResultResponse *reply) override
+    Status StartSimulation(grpc::ServerContextBase *context, const sim_server::StartSimulationRequest *request,
+                           sim_server::SimulationResultResponse *reply)
     {
-        const size_t x_max = request->init_req().dimensions().x_max();
-        const size_t y_max = request->init_req().dimensions().y_max();
-        const size_t z_max = request->init_req().dimensions().z_max();
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_START_SIMULATION]);
+        SimulationSlot slot(*this);
+        if (!slot)
+        {
+            return Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many concurrent simulations");
+        }
 
-        auto init_state_result = InitWorldStateInternal(x_max, y_max, z_max);
+        auto init_state_result = InitWorldStateInternal(request->init_req());
         if (!init_state_result)
         {
-            return Status(grpc::StatusCode::INVALID_ARGUMENT, init_state_result.error());
+            return init_state_result.error();
         }
 
-        const auto &[id, start_state] = *init_state_result;
+        const auto &[id, entry] = *init_state_result;
+        // The state is new, so holding its lock for the whole simulation only delays clients guessing its id
+        std::unique_lock<std::shared_mutex> lock(entry->mutex);
+        // The only copy of the simulation: the steps themselves run in the entry's two buffers
+        const BitPackedGrid3D start_state = entry->state.front();
 
-        ConvertGrid3DToProto(start_state, *reply->mutable_start_state()->mutable_state());
+        SerializeGridMeasured(start_state, request->encoding(), *reply->mutable_start_state());
 
         Bitset128 rule = ParseBitSetRuleFromString(request->step_req().rule());
         const uint64_t num_steps = request->step_req().num_steps();
         const uint64_t timeout = request->has_timeout() ? request->timeout() : kDefaultSimulationTimeoutSeconds;
 
-        BitPackedGrid3D end_state(x_max, y_max, z_max);
         auto start_time = std::chrono::steady_clock::now();
-
-        for (uint64_t i = 0; i < num_steps; ++i)
+        auto within_timeout = [&]
         {
             auto current_time = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count() >= timeout)
+            return std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count() < static_cast<int64_t>(timeout);
+        };
+
+        // Word-parallel runs stop early once they revisit a state. HashLife jumps through cycles anyway.
+        std::optional<CycleDetector> cycle_detector;
+        if (!entry->hashlife)
+            cycle_detector.emplace(start_state, entry->state.fingerprint());
+
+        // HashLife states advance in doubling jumps. Word-parallel states advance in passes of as many
+        // steps as temporal blocking (or a round trip to the workers) takes at once, unless entropy is
+        // sampled after every step; the cycle detector then only sees every pass-th state.
+        uint64_t steps_done = 0;
+        uint64_t jump = 1;
+        if (!entry->hashlife && !WantsEntropy(request->entropy()))
+            jump = SteppedByCluster(*entry) ? ClusterCoordinator::kStepsPerPass : entry->state.BlockingPlan(num_steps).steps_per_pass;
+        const uint64_t pass = jump;
+        ActiveStepStats stats;
+        EntropyTracker entropy_tracker(std::max<int64_t>(request->entropy().max_tracked_states(), 0));
+        RecordEntropy(request->entropy(), entropy_tracker, entry->state, entry->step, *reply);
+        while (steps_done < num_steps)
+        {
+            if (!within_timeout())
             {
                 std::cout << "Ending simulation due to timeout" << std::endl;
+                metrics.timeouts.Add(1);
                 break;
             }
-            // The temporary object returned by StepWorldStateForwardInternal is moved into end_state
-            auto step_state_result = StepWorldStateForwardInternal(id, rule);
-            if (!step_state_result)
+            if (context->IsCancelled())
+            {
+                return Status::CANCELLED;
+            }
+            const uint64_t steps = std::min(jump, num_steps - steps_done);
+            AddStats(stats, StepWorldStateForwardInternal(*entry, rule, steps));
+            steps_done += steps;
+            if (entry->hashlife && jump < (uint64_t(1) << 62))
+                jump *= 2;
+            RecordEntropy(request->entropy(), entropy_tracker, entry->state, entry->step, *reply);
+            if (cycle_detector && cycle_detector->Observe(entry->state.front(), entry->state.fingerprint()))
+                break;
+        }
+
+        if (cycle_detector && cycle_detector->period() != 0 && steps_done < num_steps)
+        {
+            // A cycle of observations every `pass` steps spans a multiple of the true period
+            uint64_t period = cycle_detector->period() * pass;
+            if (pass > 1)
             {
-                return Status(grpc::StatusCode::INTERNAL, step_state_result.error());
+                auto exact_period = FindPeriod(entry->state.front(), rule, entry->rule_mode, period, [&]
+                                               { return within_timeout() && !context->IsCancelled(); });
+                period = exact_period.value_or(period);
             }
-            end_state = *step_state_result; // Move assignment (automatic if move constructor exists)
+            sim_server::CycleInfo &cycle = *reply->mutable_cycle();
+            cycle.set_period(period);
+            cycle.set_detected_at_step(steps_done);
+
+            // Every later state repeats with this period (or its multiple), so only the remainder needs stepping
+            const uint64_t remaining = (num_steps - steps_done) % period;
+            AddStats(stats, StepWorldStateForwardInternal(*entry, rule, remaining));
+            entry->step += num_steps - steps_done - remaining;
+
+            auto transient = FindTransientLength(start_state, rule, entry->rule_mode, period, [&]
+                                                 { return within_timeout() && !context->IsCancelled(); });
+            cycle.set_transient_length(transient ? static_cast<int64_t>(*transient) : -1);
         }
 
         // Serialize the updated world state into the response
         sim_server::WorldStateResponse &end_state_proto = *reply->mutable_end_state();
-        ConvertGrid3DToProto(end_state, *end_state_proto.mutable_state());
+        SerializeGridMeasured(entry->state.front(), request->encoding(), end_state_proto);
 
-        auto step_result = get_step_by_world_state_id(id);
-        if (!step_result)
+        end_state_proto.mutable_metadata()->set_state_id(id);
+        end_state_proto.mutable_metadata()->set_status("World state stepped forward");
+        end_state_proto.mutable_metadata()->set_step(entry->step);
+        SetStatsMetadata(stats, *end_state_proto.mutable_metadata());
+        reply->set_state_changed_during_sim(!(start_state == entry->state.front()));
+        return Status::OK;
+    }
+
+    // Sends a keyframe of the current state, then one frame per step (or per frame_interval steps):
+    // a GridDelta with the XOR of the previous frame's state and the current one, or a full keyframe
+    // every keyframe_interval steps. See FramePacer for when frames are dropped instead.
+    Status StreamSimulation(grpc::ServerContextBase *context, const sim_server::StreamSimulationRequest *request,
+                            FrameSink<sim_server::SimulationFrame> &sink)
+    {
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_STREAM_SIMULATION]);
+        SimulationSlot slot(*this);
+        if (!slot)
         {
-            return Status(grpc::StatusCode::INTERNAL, step_result.error());
+            return Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many concurrent simulations");
         }
 
-        end_state_proto.mutable_metadata()->set_status("World state stepped forward");
-        end_state_proto.mutable_metadata()->set_step(*step_result + 1);
-        reply->set_state_changed_during_sim(!(start_state == end_state));
+        const uint64_t world_state_id = request->world_state_id();
+        auto entry_result = FindEntry(world_state_id);
+        if (!entry_result)
+        {
+            return entry_result.error();
+        }
+        WorldStateEntry &entry = **entry_result;
+
+        Bitset128 rule = ParseBitSetRuleFromString(request->rule());
+        const uint64_t num_steps = std::max<int64_t>(request->num_steps(), 0);
+        const int64_t keyframe_interval = request->keyframe_interval();
+        FramePacer pacer(std::max<int64_t>(request->frame_interval(), 0), request->latest_only());
+
+        // Steps a private copy, so a slow client doesn't block other readers of the state. The
+        // copy is row-major, so keyframes and deltas go out without converting every frame.
+        std::shared_lock<std::shared_mutex> read_lock(entry.mutex);
+        DoubleBufferedGrid stream_state(entry.state.front().WithLayout(GRID_LAYOUT_ROW_MAJOR));
+        const size_t base_step = entry.step;
+        size_t step = base_step;
+        read_lock.unlock();
+
+        // The state reached replaces the stored one, unless a step, snapshot load or other stream got
+        // there first: overwriting that would lose its result and move the step counter backwards
+        bool result_handled = false;
+        auto store_result = [&]
+        {
+            result_handled = true;
+            auto current = store.Find(world_state_id);
+            return current && current->get() == &entry &&
+                   StoreSteppedCopy(entry, base_step, stream_state.mutable_front(), step);
+        };
+
+        EntropyTracker entropy_tracker(std::max<int64_t>(request->entropy().max_tracked_states(), 0));
+
+        sim_server::SimulationFrame frame;
+        RecordEntropy(request->entropy(), entropy_tracker, stream_state, step, frame);
+        frame.mutable_metadata()->set_state_id(world_state_id);
+        frame.mutable_metadata()->set_step(step);
+        frame.mutable_metadata()->set_status("Keyframe");
+        {
+            ScopedTimer serialization(metrics.serialization_ns);
+            ConvertGrid3DToPackedProto(stream_state.front(), *frame.mutable_keyframe());
+        }
+        metrics.bytes_sent.Add(frame.ByteSizeLong());
+        bool client_connected = sink.Send(std::move(frame));
+
+        // Deltas are against the last state sent, which is the back buffer as long as every step is sent
+        const bool every_step = request->frame_interval() <= 1 && !request->latest_only();
+        BitPackedGrid3D last_sent = every_step ? BitPackedGrid3D(0, 0, 0) : stream_state.front();
+        bool keyframe_due = false;
+        ActiveStepStats stats;
+        for (uint64_t i = 1; i <= num_steps && client_connected && !context->IsCancelled();)
+        {
+            // Steps without a frame due run in one go, unless every state feeds the entropy
+            const uint64_t steps = request->entropy().track_states() ? 1 : std::min(pacer.StepsToNextDue(i - 1), num_steps - i + 1);
+            {
+                ScopedTimer compute(metrics.compute_ns);
+                const ActiveStepStats advanced = stream_state.Advance(rule, entry.rule_mode, steps);
+                stats.blocks_computed += advanced.blocks_computed;
+                stats.blocks_skipped += advanced.blocks_skipped;
+            }
+            metrics.steps.Add(steps);
+            metrics.cell_updates.Add(steps * stream_state.front().size_in_bits());
+            if (keyframe_interval > 0 && (i + steps - 1) / keyframe_interval != (i - 1) / keyframe_interval)
+                keyframe_due = true;
+            i += steps;
+            step += steps;
+
+            const uint64_t dropped_before = pacer.frames_dropped();
+            if (!pacer.ShouldSend(i - 1, i > num_steps, sink.Ready()))
+            {
+                metrics.frames_dropped.Add(pacer.frames_dropped() - dropped_before);
+                if (request->entropy().track_states())
+                    entropy_tracker.observe(stream_state.fingerprint());
+                continue;
+            }
 
-        // Save the updated world state for future steps
-        set_world_state_by_id(id, end_state);
+            frame.Clear();
+            RecordEntropy(request->entropy(), entropy_tracker, stream_state, step, frame);
+            frame.mutable_metadata()->set_state_id(world_state_id);
+            frame.mutable_metadata()->set_step(step);
+            frame.mutable_metadata()->set_frames_dropped(pacer.frames_dropped());
+            SetStatsMetadata(stats, *frame.mutable_metadata());
+            stats = ActiveStepStats();
+            ScopedTimer serialization(metrics.serialization_ns);
+            if (keyframe_due)
+            {
+                frame.mutable_metadata()->set_status("Keyframe");
+                ConvertGrid3DToPackedProto(stream_state.front(), *frame.mutable_keyframe());
+                keyframe_due = false;
+            }
+            else
+            {
+                frame.mutable_metadata()->set_status("Delta");
+                // After a single step the back buffer holds the previous state
+                const BitPackedGrid3D &previous = every_step ? stream_state.back() : last_sent;
+                ConvertDeltaToProto(previous, stream_state.front(), request->delta_encoding(), *frame.mutable_delta());
+            }
+            if (!every_step)
+                std::copy(stream_state.front().begin(), stream_state.front().end(), last_sent.begin());
+            serialization.Stop();
+            // The final frame tells the client whether its result was kept; storing gives up the stream's grid
+            if (i > num_steps && !store_result())
+                frame.mutable_metadata()->set_status(frame.metadata().status() +
+                                                     ", not stored: the world state changed during the stream");
+            metrics.bytes_sent.Add(frame.ByteSizeLong());
+            client_connected = sink.Send(std::move(frame));
+        }
+        sink.Flush();
+
+        // Keep the state reached so far, even if the client went away mid-stream
+        if (!result_handled)
+            store_result();
+        return context->IsCancelled() ? Status::CANCELLED : Status::OK;
+    }
+
+    Status DeleteWorldState(grpc::ServerContextBase *context, const sim_server::DeleteWorldStateRequest *request,
+                            sim_server::DeleteWorldStateResponse *reply)
+    {
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_DELETE_WORLD_STATE]);
+        const uint64_t world_state_id = request->world_state_id();
+        const bool erased = store.Erase(world_state_id);
+        const bool snapshot_erased = snapshots && snapshots->Erase(world_state_id);
+        if (!erased && !snapshot_erased)
+        {
+            return Status(grpc::StatusCode::NOT_FOUND, "No world state found for id: " + std::to_string(world_state_id));
+        }
+        reply->mutable_metadata()->set_state_id(world_state_id);
+        reply->mutable_metadata()->set_status("World state deleted");
         return Status::OK;
     }
 
-private:
-    WorldStateContainer states; // Automatically initialized via WorldStateContainer's default constructor
-    std::unordered_map<uint64_t, size_t> world_state_id_to_step;
+    // Persists a world state to the snapshot directory, replacing an older snapshot of it
+    Status SaveSnapshot(grpc::ServerContextBase *context, const sim_server::SnapshotRequest *request,
+                        sim_server::SaveSnapshotResponse *reply)
+    {
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_SAVE_SNAPSHOT]);
+        if (!snapshots)
+        {
+            return Status(grpc::StatusCode::FAILED_PRECONDITION, "Server runs without a snapshot directory");
+        }
+        const uint64_t world_state_id = request->world_state_id();
+        auto entry_result = FindEntry(world_state_id);
+        if (!entry_result)
+        {
+            return entry_result.error();
+        }
+
+        WorldStateEntry &entry = **entry_result;
+        std::shared_lock<std::shared_mutex> lock(entry.mutex);
+        auto saved = snapshots->Save(world_state_id, Snapshot{entry.state.front(), entry.step, entry.rule_mode, entry.hashlife != nullptr});
+        if (!saved)
+        {
+            return Status(grpc::StatusCode::INTERNAL, saved.error());
+        }
+
+        reply->set_bytes(*saved);
+        reply->mutable_metadata()->set_state_id(world_state_id);
+        reply->mutable_metadata()->set_step(entry.step);
+        reply->mutable_metadata()->set_status("Snapshot saved");
+        return Status::OK;
+    }
 
-    tl::expected<BitPackedGrid3D, std::string> get_world_state_by_id(uint64_t world_state_id) const
+    // Replaces the in-memory world state, if any, with its snapshot
+    Status LoadSnapshot(grpc::ServerContextBase *context, const sim_server::SnapshotRequest *request,
+                        sim_server::WorldStateResponse *reply)
     {
-        auto it = states.world_states.find(world_state_id);
-        if (it == states.world_states.end())
-            return tl::unexpected("No world state found for id: " + std::to_string(world_state_id));
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_LOAD_SNAPSHOT]);
+        if (!snapshots)
+        {
+            return Status(grpc::StatusCode::FAILED_PRECONDITION, "Server runs without a snapshot directory");
+        }
+        const uint64_t world_state_id = request->world_state_id();
+        std::lock_guard<std::mutex> restore_lock(restore_mutex);
+        auto entry_result = RestoreSnapshot(world_state_id);
+        if (!entry_result)
+        {
+            return entry_result.error();
+        }
 
-        return it->second;
+        WorldStateEntry &entry = **entry_result;
+        std::shared_lock<std::shared_mutex> lock(entry.mutex);
+        SerializeGridMeasured(entry.state.front(), request->encoding(), *reply);
+        reply->mutable_metadata()->set_state_id(world_state_id);
+        reply->mutable_metadata()->set_step(entry.step);
+        reply->mutable_metadata()->set_status("Snapshot loaded");
+        return Status::OK;
     }
 
-    // Save the current world state after a step.
-    void set_world_state_by_id(const uint64_t world_state_id, const BitPackedGrid3D &state)
+    Status SweepRules(grpc::ServerContextBase *context, const sim_server::SweepRulesRequest *request,
+                      sim_server::SweepRulesResponse *reply)
     {
-        states.world_states.insert_or_assign(world_state_id, std::move(state)); // C++17
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_SWEEP_RULES]);
+        SimulationSlot slot(*this);
+        if (!slot)
+        {
+            return Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many concurrent simulations");
+        }
+
+        std::vector<Bitset128> rules;
+        for (const std::string &rule : request->rules())
+        {
+            if (rule.size() != 16)
+            {
+                return Status(grpc::StatusCode::INVALID_ARGUMENT, "Expected 16 bytes per rule, got " + std::to_string(rule.size()));
+            }
+            rules.push_back(ParseBitSetRuleFromString(rule));
+        }
+        if (request->has_eca_rules())
+        {
+            const int64_t first = request->eca_rules().first();
+            const int64_t last = request->eca_rules().last();
+            if (first < 0 || last > 255 || first > last)
+            {
+                return Status(grpc::StatusCode::INVALID_ARGUMENT, "ECA rule range must satisfy 0 <= first <= last <= 255");
+            }
+            for (int64_t number = first; number <= last; ++number)
+                rules.push_back(build_from_eca(static_cast<uint8_t>(number)));
+        }
+        if (rules.empty())
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "No rules to sweep");
+        }
+
+        const size_t x_max = request->dimensions().x_max();
+        const size_t y_max = request->dimensions().y_max();
+        const size_t z_max = request->dimensions().z_max();
+        // Nothing of the sweep is stored, so the initial state gets no id
+        auto initial = MakeCenterCellGrid(x_max, y_max, z_max);
+        if (!initial)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, initial.error());
+        }
+        const BitPackedGrid3D &grid = *initial;
+
+        RuleSweepOptions options;
+        options.num_steps = std::max<int64_t>(request->num_steps(), 0);
+        options.track_states = request->entropy().track_states();
+        options.max_tracked_states = std::max<int64_t>(request->entropy().max_tracked_states(), 0);
+        options.spatial = request->entropy().spatial();
+
+        const uint64_t timeout = request->has_timeout() ? request->timeout() : kDefaultSimulationTimeoutSeconds;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+        auto keep_going = [&]
+        { return std::chrono::steady_clock::now() < deadline && !context->IsCancelled(); };
+
+        ScopedTimer compute(metrics.compute_ns);
+        const std::vector<RuleSummary> summaries = ::SweepRules(grid, rules, RULE_1D_ECA, options, keep_going,
+                                                                ThreadPool::Shared().num_threads());
+        compute.Stop();
+        if (context->IsCancelled())
+        {
+            return Status::CANCELLED;
+        }
+
+        uint64_t steps = 0;
+        uint64_t min_steps = options.num_steps;
+        for (const RuleSummary &summary : summaries)
+        {
+            steps += summary.steps;
+            min_steps = std::min<uint64_t>(min_steps, summary.steps);
+        }
+        metrics.steps.Add(steps);
+        metrics.cell_updates.Add(steps * grid.size_in_bits());
+        const bool timed_out = min_steps < options.num_steps;
+        if (timed_out)
+            metrics.timeouts.Add(1);
+
+        for (size_t i = 0; i < rules.size(); ++i)
+        {
+            const RuleSummary &summary = summaries[i];
+            sim_server::RuleSummary &summary_proto = *reply->add_summaries();
+            summary_proto.set_rule(SerializeBitSetRuleToString(rules[i]));
+            summary_proto.set_steps(summary.steps);
+            summary_proto.set_final_population(summary.final_population);
+            summary_proto.set_state_changed(summary.state_changed);
+            if (summary.cycle_period != 0)
+            {
+                summary_proto.mutable_cycle()->set_period(summary.cycle_period);
+                summary_proto.mutable_cycle()->set_detected_at_step(summary.cycle_detected_at_step);
+                summary_proto.mutable_cycle()->set_transient_length(summary.transient_length);
+            }
+            summary_proto.set_state_entropy(summary.state_entropy);
+            summary_proto.set_spatial_entropy(summary.spatial_entropy);
+        }
+        // Every rule got at least this far; the summaries have each rule's own step count
+        reply->mutable_metadata()->set_step(min_steps);
+        reply->mutable_metadata()->set_status(timed_out ? "Sweep timed out before every rule was stepped num_steps steps"
+                                                        : "Rules swept");
+        return Status::OK;
     }
 
-    // Keep track of the current step
-    tl::expected<size_t, std::string> get_step_by_world_state_id(uint64_t world_state_id) const
+    // Sends part of a world state. Only the selected box is read and serialized, so the cost follows
+    // what the client displays rather than the grid volume.
+    Status FetchWorldState(grpc::ServerContextBase *context, const sim_server::FetchWorldStateRequest *request,
+                           sim_server::FetchWorldStateResponse *reply)
     {
-        auto it = world_state_id_to_step.find(world_state_id);
-        if (it != world_state_id_to_step.end())
-            return it->second;
+        ScopedTimer latency(metrics.rpc_latency[METRIC_RPC_FETCH_WORLD_STATE]);
+        if (request->downsample() < 0)
+        {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, "downsample must not be negative");
+        }
+        const uint64_t world_state_id = request->world_state_id();
+        auto entry_result = FindEntry(world_state_id);
+        if (!entry_result)
+        {
+            return entry_result.error();
+        }
 
-        return tl::unexpected("Couldn't find mapping for world_state_id: " + std::to_string(world_state_id));
+        WorldStateEntry &entry = **entry_result;
+        std::shared_lock<std::shared_mutex> lock(entry.mutex);
+        auto box_result = ResolveSelection(*request, entry.state.front());
+        if (!box_result)
+        {
+            return box_result.error();
+        }
+        const GridBox &box = *box_result;
+        reply->mutable_metadata()->set_state_id(world_state_id);
+        reply->mutable_metadata()->set_step(entry.step);
+        sim_server::GridRegion &region = *reply->mutable_region();
+        region.set_x(box.x);
+        region.set_y(box.y);
+        region.set_z(box.z);
+        region.set_size_x(box.size_x);
+        region.set_size_y(box.size_y);
+        region.set_size_z(box.size_z);
+
+        if (request->downsample() > 1)
+        {
+            const size_t block_size = request->downsample();
+            const BlockPopulations populations = CountBlockPopulations(entry.state.front(), box, block_size);
+            lock.unlock();
+
+            ScopedTimer serialization(metrics.serialization_ns);
+            sim_server::PopulationGrid &proto = *reply->mutable_populations();
+            proto.mutable_dimensions()->set_x_max(populations.blocks_x);
+            proto.mutable_dimensions()->set_y_max(populations.blocks_y);
+            proto.mutable_dimensions()->set_z_max(populations.blocks_z);
+            proto.set_block_size(block_size);
+            proto.mutable_counts()->Add(populations.counts.begin(), populations.counts.end());
+            reply->mutable_metadata()->set_status("Block populations fetched");
+        }
+        else
+        {
+            const BitPackedGrid3D cells = ExtractRegion(entry.state.front(), box);
+            lock.unlock();
+
+            ScopedTimer serialization(metrics.serialization_ns);
+            if (request->encoding() == sim_server::GRID_ENCODING_PACKED)
+                ConvertGrid3DToPackedProto(cells, *reply->mutable_packed_state());
+            else
+                ConvertGrid3DToProto(cells, *reply->mutable_state());
+            reply->mutable_metadata()->set_status("Region fetched");
+        }
+        metrics.bytes_sent.Add(reply->ByteSizeLong());
+        return Status::OK;
     }
 
-    void set_step_by_world_state_id(const uint64_t world_state_id, size_t step)
+    Status GetMetrics(grpc::ServerContextBase *context, const sim_server::GetMetricsRequest *request,
+                      sim_server::GetMetricsResponse *reply)
     {
-        world_state_id_to_step[world_state_id] = step;
+        for (size_t rpc = 0; rpc < kNumMetricRpcs; ++rpc)
+        {
+            const LatencyHistogram::Summary summary = metrics.rpc_latency[rpc].Summarize();
+            sim_server::RpcLatency &latency = *reply->add_rpc_latency();
+            latency.set_rpc(MetricRpcName(static_cast<MetricRpc>(rpc)));
+            latency.set_count(summary.count);
+            latency.set_p50_seconds(summary.p50_ns / 1e9);
+            latency.set_p99_seconds(summary.p99_ns / 1e9);
+            latency.set_p999_seconds(summary.p999_ns / 1e9);
+            latency.set_max_seconds(summary.max_ns / 1e9);
+        }
+
+        const uint64_t cell_updates = metrics.cell_updates.Value();
+        const double compute_seconds = metrics.compute_ns.Value() / 1e9;
+        reply->set_steps(metrics.steps.Value());
+        reply->set_cell_updates(cell_updates);
+        reply->set_cells_per_second(compute_seconds > 0 ? cell_updates / compute_seconds : 0);
+        reply->set_compute_seconds(compute_seconds);
+        reply->set_serialization_seconds(metrics.serialization_ns.Value() / 1e9);
+        reply->set_bytes_sent(metrics.bytes_sent.Value());
+        reply->set_timeouts(metrics.timeouts.Value());
+        reply->set_frames_dropped(metrics.frames_dropped.Value());
+        reply->set_live_world_states(store.size());
+        reply->set_world_state_bytes(store.bytes());
+        reply->set_prometheus_text(metrics.PrometheusText(store.size(), store.bytes()));
+        return Status::OK;
     }
 
-    /**
-     * Serializes a BitPackedGrid3D into the provided Data protobuf message.
-     */
-    void ConvertGrid3DToProto(const BitPackedGrid3D &grid, sim_server::Vector3D &vec3d_proto)
+private:
+    // Admission control for the long-running RPCs: holds one of max_concurrent_simulations slots.
+    class SimulationSlot
+    {
+    public:
+        explicit SimulationSlot(StateServiceCore &core) : core(core)
+        {
+            const size_t running = core.running_simulations.fetch_add(1) + 1;
+            acquired = core.max_concurrent_simulations == 0 || running <= core.max_concurrent_simulations;
+        }
+        ~SimulationSlot() { core.running_simulations.fetch_sub(1); }
+        explicit operator bool() const { return acquired; }
+
+    private:
+        StateServiceCore &core;
+        bool acquired;
+    };
+
+    const size_t max_concurrent_simulations;
+    std::atomic<size_t> running_simulations{0};
+    WorldStateContainer states; // Allocates ids and builds initial grids
+    WorldStateStore store;
+    std::unique_ptr<SnapshotStore> snapshots; // null without a snapshot directory
+    std::mutex restore_mutex;                 // one snapshot restore at a time, so a state is never restored twice
+    std::unique_ptr<ClusterCoordinator> cluster; // null unless states are stepped on workers
+    ServerMetrics metrics;
+
+    // Writes the grid into the response, counting the time it takes and the bytes it adds
+    void SerializeGridMeasured(const BitPackedGrid3D &grid, sim_server::GridEncoding encoding, sim_server::WorldStateResponse &response)
     {
-        const size_t x_max = grid.x_max;
-        const size_t y_max = grid.y_max;
-        const size_t z_max = grid.z_max;
+        ScopedTimer serialization(metrics.serialization_ns);
+        SerializeGrid(grid, encoding, response);
+        metrics.bytes_sent.Add(response.ByteSizeLong());
+    }
 
-        for (size_t x = 0; x < x_max; ++x)
+    // The box a FetchWorldState request selects: a region with its zero sizes extended to the end of
+    // the grid, a one-cell-thick slice, or the whole grid
+    static tl::expected<GridBox, Status> ResolveSelection(const sim_server::FetchWorldStateRequest &request, const BitPackedGrid3D &grid)
+    {
+        GridBox box;
+        box.size_x = grid.x_max;
+        box.size_y = grid.y_max;
+        box.size_z = grid.z_max;
+        if (request.has_region())
         {
-            sim_server::Vector2D *vec2d_proto = vec3d_proto.add_vec2d();
-            for (size_t y = 0; y < y_max; ++y)
+            const sim_server::GridRegion &region = request.region();
+            if (region.x() < 0 || region.y() < 0 || region.z() < 0 || region.size_x() < 0 || region.size_y() < 0 || region.size_z() < 0)
+                return tl::unexpected(Status(grpc::StatusCode::INVALID_ARGUMENT, "Region coordinates must not be negative"));
+            auto resolve = [](int64_t first, int64_t size, size_t dimension, size_t &box_first, size_t &box_size)
             {
-                sim_server::Vector1D *vec1d_proto = vec2d_proto->add_vec1d();
-                for (size_t z = 0; z < z_max; ++z)
-                {
-                    bool bit = grid.get(x, y, z);
-                    vec1d_proto->add_bit(static_cast<uint32_t>(bit));
-                }
+                box_first = first;
+                box_size = size != 0 ? size : (box_first < dimension ? dimension - box_first : 0);
+            };
+            resolve(region.x(), region.size_x(), grid.x_max, box.x, box.size_x);
+            resolve(region.y(), region.size_y(), grid.y_max, box.y, box.size_y);
+            resolve(region.z(), region.size_z(), grid.z_max, box.z, box.size_z);
+        }
+        else if (request.has_slice())
+        {
+            const int64_t index = request.slice().index();
+            const sim_server::Axis axis = request.slice().axis();
+            size_t &first = axis == sim_server::AXIS_X ? box.x : (axis == sim_server::AXIS_Y ? box.y : box.z);
+            size_t &size = axis == sim_server::AXIS_X ? box.size_x : (axis == sim_server::AXIS_Y ? box.size_y : box.size_z);
+            if (index < 0 || static_cast<size_t>(index) >= size)
+                return tl::unexpected(Status(grpc::StatusCode::OUT_OF_RANGE, "Slice index is outside the grid"));
+            first = index;
+            size = 1;
+        }
+        if (!BoxWithinGrid(grid, box))
+            return tl::unexpected(Status(grpc::StatusCode::OUT_OF_RANGE, "Region is empty or extends past the grid"));
+        return box;
+    }
+
+    // Looks a state up in memory, restoring it from its snapshot if it isn't there (after a restart or eviction)
+    tl::expected<std::shared_ptr<WorldStateEntry>, Status> FindEntry(uint64_t world_state_id)
+    {
+        auto entry = store.Find(world_state_id);
+        if (entry)
+            return *entry;
+        if (!snapshots || !snapshots->Contains(world_state_id))
+        {
+            if (store.EvictedStep(world_state_id))
+                return tl::unexpected(Status(grpc::StatusCode::NOT_FOUND, "World state " + std::to_string(world_state_id) +
+                                                                              " was evicted to free memory"));
+            return tl::unexpected(Status(grpc::StatusCode::NOT_FOUND, entry.error()));
+        }
+
+        std::lock_guard<std::mutex> restore_lock(restore_mutex);
+        entry = store.Find(world_state_id); // restored by another handler meanwhile
+        if (entry)
+            return *entry;
+        // An evicted state is never saved: a snapshot older than it would silently take the client back
+        return RestoreSnapshot(world_state_id, store.EvictedStep(world_state_id).value_or(0));
+    }
+
+    // Loads a snapshot into the store, replacing the in-memory state. Fails if the snapshot is of a step before
+    // min_step. Requires restore_mutex.
+    tl::expected<std::shared_ptr<WorldStateEntry>, Status> RestoreSnapshot(uint64_t world_state_id, uint64_t min_step = 0)
+    {
+        auto snapshot = snapshots->Load(world_state_id);
+        if (!snapshot)
+        {
+            const bool missing = !snapshots->Contains(world_state_id);
+            return tl::unexpected(Status(missing ? grpc::StatusCode::NOT_FOUND : grpc::StatusCode::DATA_LOSS, snapshot.error()));
+        }
+        if (snapshot->step < min_step)
+        {
+            std::ostringstream oss;
+            oss << "World state " << world_state_id << " was evicted at step " << min_step << ", but its snapshot is of step "
+                << snapshot->step << ". LoadSnapshot resets it to the snapshot";
+            return tl::unexpected(Status(grpc::StatusCode::FAILED_PRECONDITION, oss.str()));
+        }
+
+        std::unique_ptr<HashLifeEngine> hashlife;
+        if (snapshot->hashlife)
+        {
+            auto hashlife_result = HashLifeEngine::Create(snapshot->grid);
+            if (!hashlife_result)
+            {
+                return tl::unexpected(Status(grpc::StatusCode::DATA_LOSS, hashlife_result.error()));
             }
+            hashlife = std::move(*hashlife_result);
+        }
+
+        auto entry = store.Insert(world_state_id, std::move(snapshot->grid), snapshot->rule_mode);
+        if (!entry)
+        {
+            return tl::unexpected(Status(grpc::StatusCode::RESOURCE_EXHAUSTED, entry.error()));
         }
+        std::unique_lock<std::shared_mutex> lock((*entry)->mutex);
+        (*entry)->step = snapshot->step;
+        (*entry)->hashlife = std::move(hashlife);
+        return *entry;
+    }
+
+    // Fills the entropy sample of the state at `step` that the options ask for, if any
+    static void FillEntropySample(const sim_server::EntropyOptions &options, EntropyTracker &tracker,
+                                  const DoubleBufferedGrid &state, uint64_t step, sim_server::EntropySample &sample)
+    {
+        sample.set_step(step);
+        if (options.track_states())
+        {
+            tracker.observe(state.fingerprint());
+            sample.set_state_entropy(tracker.entropy());
+        }
+        if (options.spatial())
+            sample.set_spatial_entropy(BlockPatternEntropy(state.front()));
+    }
+
+    static bool WantsEntropy(const sim_server::EntropyOptions &options)
+    {
+        return options.track_states() || options.spatial();
+    }
+
+    static void RecordEntropy(const sim_server::EntropyOptions &options, EntropyTracker &tracker,
+                              const DoubleBufferedGrid &state, uint64_t step, sim_server::SimulationResultResponse &reply)
+    {
+        if (WantsEntropy(options))
+            FillEntropySample(options, tracker, state, step, *reply.add_entropy());
     }
 
-    tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> InitWorldStateInternal(const size_t x_max, const size_t y_max, const size_t z_max)
+    static void RecordEntropy(const sim_server::EntropyOptions &options, EntropyTracker &tracker,
+                              const DoubleBufferedGrid &state, uint64_t step, sim_server::SimulationFrame &frame)
     {
-        tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> state = states.InitWorldState1D(x_max, y_max, z_max);
+        if (WantsEntropy(options))
+            FillEntropySample(options, tracker, state, step, *frame.mutable_entropy());
+    }
+
+    tl::expected<std::tuple<uint64_t, std::shared_ptr<WorldStateEntry>>, Status> InitWorldStateInternal(const sim_server::InitializeRequest &request)
+    {
+        const size_t x_max = request.dimensions().x_max();
+        const size_t y_max = request.dimensions().y_max();
+        const size_t z_max = request.dimensions().z_max();
+        const GridLayout layout = request.layout() == sim_server::MEMORY_LAYOUT_BRICK ? GRID_LAYOUT_BRICK : GRID_LAYOUT_ROW_MAJOR;
+        if (!BitPackedGrid3D::SupportsLayout(layout, x_max, y_max, z_max))
+        {
+            return tl::unexpected(Status(grpc::StatusCode::INVALID_ARGUMENT, "The brick layout needs power-of-two dimensions of at least 4"));
+        }
+        // Random worlds are generated row-major and converted like the others, so a seed gives the same world in either layout
+        auto state = request.pattern() == sim_server::INIT_PATTERN_RANDOM
+                         ? states.InitWorldStateRandom(x_max, y_max, z_max, request.seed(), request.has_density() ? request.density() : 0.5)
+                         : states.InitWorldState1D(x_max, y_max, z_max);
         if (!state)
         {
-            return tl::unexpected(state.error());
+            return tl::unexpected(Status(grpc::StatusCode::INVALID_ARGUMENT, state.error()));
+        }
+        auto &[id, grid] = *state;
+        if (layout != GRID_LAYOUT_ROW_MAJOR)
+            grid = grid.WithLayout(layout);
+
+        std::unique_ptr<HashLifeEngine> hashlife;
+        if (request.engine() == sim_server::STEP_ENGINE_HASHLIFE)
+        {
+            auto hashlife_result = HashLifeEngine::Create(grid);
+            if (!hashlife_result)
+            {
+                return tl::unexpected(Status(grpc::StatusCode::INVALID_ARGUMENT, hashlife_result.error()));
+            }
+            hashlife = std::move(*hashlife_result);
         }
-        const auto &[id, grid] = *state;
-        set_world_state_by_id(id, grid);
-        set_step_by_world_state_id(id, 0);
-        return state;
+
+        auto entry = store.Insert(id, std::move(grid), RULE_1D_ECA);
+        if (!entry)
+        {
+            return tl::unexpected(Status(grpc::StatusCode::RESOURCE_EXHAUSTED, entry.error()));
+        }
+        if (hashlife)
+        {
+            std::unique_lock<std::shared_mutex> lock((*entry)->mutex);
+            (*entry)->hashlife = std::move(hashlife);
+        }
+        return std::make_tuple(id, *entry);
     }
 
     uint32_t hash3DArray(const std::vector<std::vector<std::vector<uint8_t>>> &array)
@@ -251,37 +882,467 @@ private:
         return hash;
     }
 
-    tl::expected<BitPackedGrid3D, std::string> StepWorldStateForwardInternal(uint64_t world_state_id, Bitset128 rule)
+    // Advances the state in place. The caller holds entry.mutex exclusively.
+    // Returns the blocks computed and skipped by the word-parallel engine over all steps.
+    ActiveStepStats StepWorldStateForwardInternal(WorldStateEntry &entry, const Bitset128 &rule, uint64_t num_steps)
+    {
+        ScopedTimer compute(metrics.compute_ns);
+        metrics.steps.Add(num_steps);
+        metrics.cell_updates.Add(num_steps * entry.state.front().size_in_bits());
+        ActiveStepStats stats;
+        if (entry.hashlife)
+        {
+            entry.hashlife->SetRule(rule, entry.rule_mode);
+            entry.hashlife->Advance(num_steps);
+            entry.hashlife->Extract(entry.state.mutable_front());
+        }
+        else if (SteppedByCluster(entry) && num_steps > 0)
+        {
+            // The state stays where it was if the workers fail, and is then stepped here
+            auto stepped = cluster->Advance(entry.state.mutable_front(), rule, entry.rule_mode, num_steps);
+            if (!stepped)
+            {
+                std::cerr << "Stepping on the workers failed, stepping locally: " << stepped.error() << std::endl;
+                stats = entry.state.Advance(rule, entry.rule_mode, num_steps);
+            }
+        }
+        else
+        {
+            stats = entry.state.Advance(rule, entry.rule_mode, num_steps);
+        }
+        entry.step += num_steps;
+        return stats;
+    }
+
+    bool SteppedByCluster(const WorldStateEntry &entry) const
+    {
+        return cluster && !entry.hashlife && cluster->CanStep(entry.state.front());
+    }
+
+    static void AddStats(ActiveStepStats &total, const ActiveStepStats &step)
+    {
+        total.blocks_computed += step.blocks_computed;
+        total.blocks_skipped += step.blocks_skipped;
+    }
+
+    static void SetStatsMetadata(const ActiveStepStats &stats, sim_server::Metadata &metadata)
+    {
+        metadata.set_blocks_computed(stats.blocks_computed);
+        metadata.set_blocks_skipped(stats.blocks_skipped);
+    }
+};
+
+// Sync API: every RPC runs on a gRPC thread from start to finish.
+class StateServiceImpl final : public StateService::Service
+{
+public:
+    explicit StateServiceImpl(StateServiceCore &core) : core(core) {}
+
+    Status InitWorldState(ServerContext *context, const sim_server::InitializeRequest *request,
+                          sim_server::WorldStateResponse *reply) override
+    {
+        return core.InitWorldState(context, request, reply);
+    }
+
+    Status StepWorldStateForward(ServerContext *context, const sim_server::StepRequest *request,
+                                 sim_server::WorldStateResponse *reply) override
+    {
+        return core.StepWorldStateForward(context, request, reply);
+    }
+
+    Status UpdateRule(ServerContext *context, const sim_server::UpdateRuleRequest *request,
+                      sim_server::UpdateRuleResponse *reply) override
+    {
+        return core.UpdateRule(context, request, reply);
+    }
+
+    Status StartSimulation(ServerContext *context, const sim_server::StartSimulationRequest *request,
+                           sim_server::SimulationResultResponse *reply) override
+    {
+        return core.StartSimulation(context, request, reply);
+    }
+
+    Status StreamSimulation(ServerContext *context, const sim_server::StreamSimulationRequest *request,
+                            grpc::ServerWriter<sim_server::SimulationFrame> *writer) override
+    {
+        // ServerWriter::Write blocks until flow control lets the frame through, so it runs on the sink's thread
+        ThreadedFrameSink<sim_server::SimulationFrame> sink([writer](const sim_server::SimulationFrame &frame)
+                                                            { return writer->Write(frame); });
+        return core.StreamSimulation(context, request, sink);
+    }
+
+    Status DeleteWorldState(ServerContext *context, const sim_server::DeleteWorldStateRequest *request,
+                            sim_server::DeleteWorldStateResponse *reply) override
+    {
+        return core.DeleteWorldState(context, request, reply);
+    }
+
+    Status SaveSnapshot(ServerContext *context, const sim_server::SnapshotRequest *request,
+                        sim_server::SaveSnapshotResponse *reply) override
+    {
+        return core.SaveSnapshot(context, request, reply);
+    }
+
+    Status LoadSnapshot(ServerContext *context, const sim_server::SnapshotRequest *request,
+                        sim_server::WorldStateResponse *reply) override
     {
-        return get_world_state_by_id(world_state_id)
-            .transform([&](const BitPackedGrid3D &current)
-                       {
-            BitPackedGrid3D updated = states.UpdateWorldState(current, rule);
-            return updated; })
-            .and_then([&](BitPackedGrid3D updated) -> tl::expected<BitPackedGrid3D, std::string>
-                      { return get_step_by_world_state_id(world_state_id)
-                            .transform([&](size_t step)
-                                       {
-                                           set_step_by_world_state_id(world_state_id, step + 1);
-                                           return updated; // propagate updated world state
-                                       }); });
+        return core.LoadSnapshot(context, request, reply);
     }
+
+    Status SweepRules(ServerContext *context, const sim_server::SweepRulesRequest *request,
+                      sim_server::SweepRulesResponse *reply) override
+    {
+        return core.SweepRules(context, request, reply);
+    }
+
+    Status FetchWorldState(ServerContext *context, const sim_server::FetchWorldStateRequest *request,
+                           sim_server::FetchWorldStateResponse *reply) override
+    {
+        return core.FetchWorldState(context, request, reply);
+    }
+
+    Status GetMetrics(ServerContext *context, const sim_server::GetMetricsRequest *request,
+                      sim_server::GetMetricsResponse *reply) override
+    {
+        return core.GetMetrics(context, request, reply);
+    }
+
+private:
+    StateServiceCore &core;
 };
 
+/**
+ * Callback API: RPCs that step a world state are handed to a compute executor, so the gRPC
+ * I/O threads stay free for cheap calls like InitWorldState and UpdateRule while long
+ * simulations run.
+ */
+class AsyncStateServiceImpl final : public StateService::CallbackService
+{
+public:
+    AsyncStateServiceImpl(StateServiceCore &core, size_t compute_threads)
+        : core(core), compute(compute_threads) {}
+
+    grpc::ServerUnaryReactor *InitWorldState(grpc::CallbackServerContext *context, const sim_server::InitializeRequest *request,
+                                             sim_server::WorldStateResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        reactor->Finish(core.InitWorldState(context, request, reply));
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor *StepWorldStateForward(grpc::CallbackServerContext *context, const sim_server::StepRequest *request,
+                                                    sim_server::WorldStateResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        compute.Submit([this, context, request, reply, reactor]
+                       { reactor->Finish(core.StepWorldStateForward(context, request, reply)); });
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor *UpdateRule(grpc::CallbackServerContext *context, const sim_server::UpdateRuleRequest *request,
+                                         sim_server::UpdateRuleResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        reactor->Finish(core.UpdateRule(context, request, reply));
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor *StartSimulation(grpc::CallbackServerContext *context, const sim_server::StartSimulationRequest *request,
+                                              sim_server::SimulationResultResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        compute.Submit([this, context, request, reply, reactor]
+                       { reactor->Finish(core.StartSimulation(context, request, reply)); });
+        return reactor;
+    }
+
+    grpc::ServerWriteReactor<sim_server::SimulationFrame> *StreamSimulation(grpc::CallbackServerContext *context,
+                                                                           const sim_server::StreamSimulationRequest *request) override
+    {
+        auto *reactor = new ReactorFrameSink();
+        compute.Submit([this, context, request, reactor]
+                       { reactor->Finish(core.StreamSimulation(context, request, *reactor)); });
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor *DeleteWorldState(grpc::CallbackServerContext *context, const sim_server::DeleteWorldStateRequest *request,
+                                               sim_server::DeleteWorldStateResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        reactor->Finish(core.DeleteWorldState(context, request, reply));
+        return reactor;
+    }
+
+    // Snapshots read or write a whole grid, so they run on the compute executor like stepping
+    grpc::ServerUnaryReactor *SaveSnapshot(grpc::CallbackServerContext *context, const sim_server::SnapshotRequest *request,
+                                           sim_server::SaveSnapshotResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        compute.Submit([this, context, request, reply, reactor]
+                       { reactor->Finish(core.SaveSnapshot(context, request, reply)); });
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor *LoadSnapshot(grpc::CallbackServerContext *context, const sim_server::SnapshotRequest *request,
+                                           sim_server::WorldStateResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        compute.Submit([this, context, request, reply, reactor]
+                       { reactor->Finish(core.LoadSnapshot(context, request, reply)); });
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor *SweepRules(grpc::CallbackServerContext *context, const sim_server::SweepRulesRequest *request,
+                                         sim_server::SweepRulesResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        compute.Submit([this, context, request, reply, reactor]
+                       { reactor->Finish(core.SweepRules(context, request, reply)); });
+        return reactor;
+    }
+
+    // Reads and encodes up to the whole grid, so it runs on the compute executor
+    grpc::ServerUnaryReactor *FetchWorldState(grpc::CallbackServerContext *context, const sim_server::FetchWorldStateRequest *request,
+                                              sim_server::FetchWorldStateResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        compute.Submit([this, context, request, reply, reactor]
+                       { reactor->Finish(core.FetchWorldState(context, request, reply)); });
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor *GetMetrics(grpc::CallbackServerContext *context, const sim_server::GetMetricsRequest *request,
+                                         sim_server::GetMetricsResponse *reply) override
+    {
+        grpc::ServerUnaryReactor *reactor = context->DefaultReactor();
+        reactor->Finish(core.GetMetrics(context, request, reply));
+        return reactor;
+    }
+
+private:
+    // Lets the compute thread producing frames hand them to gRPC one at a time. A frame is kept
+    // until OnWriteDone, gRPC's write-completion signal, so the next one waits for the client.
+    class ReactorFrameSink final : public grpc::ServerWriteReactor<sim_server::SimulationFrame>,
+                                   public FrameSink<sim_server::SimulationFrame>
+    {
+    public:
+        bool Send(sim_server::SimulationFrame frame) override
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            write_done_cv.wait(lock, [this]
+                               { return !write_pending; });
+            if (!write_ok)
+                return false;
+            in_flight = std::move(frame);
+            write_pending = true;
+            lock.unlock();
+            StartWrite(&in_flight);
+            return true;
+        }
+
+        bool Ready() const override
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return !write_pending;
+        }
+
+        bool Flush() override
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            write_done_cv.wait(lock, [this]
+                               { return !write_pending; });
+            return write_ok;
+        }
+
+        void OnWriteDone(bool ok) override
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                write_pending = false;
+                write_ok = write_ok && ok;
+            }
+            write_done_cv.notify_one();
+        }
+
+        void OnDone() override { delete this; }
+
+    private:
+        mutable std::mutex mutex;
+        std::condition_variable write_done_cv;
+        sim_server::SimulationFrame in_flight;
+        bool write_pending = false;
+        bool write_ok = true;
+    };
+
+    StateServiceCore &core;
+    TaskExecutor compute;
+};
+
+namespace
+{
+// Returns whether arg is the flag; a value that isn't a number is ignored with a warning, keeping the default
+bool ParseSizeFlag(const std::string &arg, const std::string &name, size_t &value)
+{
+    const std::string prefix = "--" + name + "=";
+    if (arg.rfind(prefix, 0) != 0)
+        return false;
+    const char *first = arg.data() + prefix.size();
+    const char *last = arg.data() + arg.size();
+    size_t parsed = 0;
+    const auto [end, error] = std::from_chars(first, last, parsed);
+    if (error != std::errc() || end != last || first == last)
+        std::cerr << "Ignoring invalid value of --" << name << ": " << arg << std::endl;
+    else
+        value = parsed;
+    return true;
+}
+} // namespace
+
+ServerOptions ParseServerOptions(int argc, char **argv)
+{
+    ServerOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--async")
+            options.mode = SERVER_MODE_ASYNC;
+        else if (arg == "--sync")
+            options.mode = SERVER_MODE_SYNC;
+        else if (arg.rfind("--address=", 0) == 0)
+            options.address = arg.substr(std::string("--address=").size());
+        else if (arg.rfind("--snapshot-dir=", 0) == 0)
+            options.snapshot_dir = arg.substr(std::string("--snapshot-dir=").size());
+        else if (arg == "--worker")
+            options.worker = true;
+        else if (arg.rfind("--workers=", 0) == 0)
+        {
+            std::istringstream addresses(arg.substr(std::string("--workers=").size()));
+            for (std::string address; std::getline(addresses, address, ',');)
+            {
+                if (!address.empty())
+                    options.workers.push_back(address);
+            }
+        }
+        else if (!ParseSizeFlag(arg, "io-threads", options.io_threads) &&
+                 !ParseSizeFlag(arg, "compute-threads", options.compute_threads) &&
+                 !ParseSizeFlag(arg, "max-concurrent-simulations", options.max_concurrent_simulations) &&
+                 !ParseSizeFlag(arg, "max-state-bytes", options.max_state_bytes) &&
+                 !ParseSizeFlag(arg, "halo-timeout-ms", options.halo_timeout_ms))
+            std::cerr << "Ignoring unknown argument: " << arg << std::endl;
+    }
+    return options;
+}
+
 void RunServer()
 {
-    std::string server_address("0.0.0.0:50051");
-    StateServiceImpl service;
+    RunServer(ServerOptions());
+}
+
+struct ServerHandle::State
+{
+    std::unique_ptr<StateServiceCore> core;
+    std::unique_ptr<grpc::Service> service;
+    std::unique_ptr<grpc::Service> worker_service; // null unless started with --worker
+    std::unique_ptr<Server> server;
+};
+
+ServerHandle::ServerHandle(std::unique_ptr<State> state) : state(std::move(state)) {}
+
+ServerHandle::~ServerHandle()
+{
+    state->server->Shutdown();
+}
+
+std::shared_ptr<grpc::Channel> ServerHandle::InProcessChannel()
+{
+    return state->server->InProcessChannel(grpc::ChannelArguments());
+}
+
+void ServerHandle::Wait()
+{
+    state->server->Wait();
+}
+
+tl::expected<std::unique_ptr<ServerHandle>, std::string> StartServer(const ServerOptions &options)
+{
+    std::unique_ptr<SnapshotStore> snapshots;
+    if (!options.snapshot_dir.empty())
+    {
+        auto opened = SnapshotStore::Open(options.snapshot_dir);
+        if (!opened)
+        {
+            return tl::unexpected(opened.error());
+        }
+        snapshots = std::move(*opened);
+        std::cout << "Found " << snapshots->size() << " snapshots in " << options.snapshot_dir << std::endl;
+    }
+
+    std::unique_ptr<ClusterCoordinator> cluster;
+    if (!options.workers.empty())
+    {
+        cluster = std::make_unique<ClusterCoordinator>(options.workers, std::chrono::milliseconds(options.halo_timeout_ms));
+    }
+
+    auto state = std::make_unique<ServerHandle::State>();
+    state->core = std::make_unique<StateServiceCore>(options.max_concurrent_simulations, options.max_state_bytes, std::move(snapshots),
+                                                     std::move(cluster));
+    if (options.mode == SERVER_MODE_ASYNC)
+    {
+        const size_t compute_threads = options.compute_threads > 0 ? options.compute_threads
+                                                                   : std::max(1u, std::thread::hardware_concurrency());
+        state->service = std::make_unique<AsyncStateServiceImpl>(*state->core, compute_threads);
+    }
+    else
+    {
+        state->service = std::make_unique<StateServiceImpl>(*state->core);
+    }
 
     ServerBuilder builder;
-    builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-    builder.RegisterService(&service);
+    if (!options.address.empty())
+    {
+        builder.AddListeningPort(options.address, grpc::InsecureServerCredentials());
+    }
+    builder.RegisterService(state->service.get());
+    if (options.worker)
+    {
+        // Slabs arrive whole, far past gRPC's 4 MiB default
+        state->worker_service = MakeWorkerService();
+        builder.RegisterService(state->worker_service.get());
+        builder.SetMaxReceiveMessageSize(INT_MAX);
+        builder.SetMaxSendMessageSize(INT_MAX);
+    }
+    if (options.io_threads > 0)
+    {
+        // Caps the threads gRPC uses to serve RPCs (sync handlers) or run callbacks (async mode)
+        grpc::ResourceQuota quota("state_service");
+        quota.SetMaxThreads(static_cast<int>(options.io_threads));
+        builder.SetResourceQuota(quota);
+    }
 
     // Enable reflection
     grpc::reflection::InitProtoReflectionServerBuilderPlugin();
 
-    std::unique_ptr<Server> server(builder.BuildAndStart());
-    std::cout << "Server listening on " << server_address << std::endl;
+    state->server = builder.BuildAndStart();
+    if (!state->server)
+    {
+        return tl::unexpected("Failed to start server on " + options.address);
+    }
+    return std::unique_ptr<ServerHandle>(new ServerHandle(std::move(state)));
+}
+
+void RunServer(const ServerOptions &options)
+{
+    auto server = StartServer(options);
+    if (!server)
+    {
+        std::cerr << server.error() << std::endl;
+        return;
+    }
+    std::cout << "Server listening on " << options.address
+              << (options.mode == SERVER_MODE_ASYNC ? " (async)" : " (sync)") << (options.worker ? " as a worker" : "");
+    if (!options.workers.empty())
+        std::cout << ", stepping states on " << options.workers.size() << " workers";
+    std::cout << std::endl;
 
-    server->Wait();
+    (*server)->Wait();
 };
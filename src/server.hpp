@@ -1,6 +1,61 @@
 #ifndef SERVER_HPP
 #define SERVER_HPP
 
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <tl/expected.hpp>
+
+namespace grpc
+{
+class Channel;
+}
+
+enum ServerMode
+{
+    SERVER_MODE_SYNC,  // gRPC sync API, every RPC runs on a gRPC thread
+    SERVER_MODE_ASYNC  // gRPC callback API, stepping runs on a separate compute executor
+};
+
+struct ServerOptions
+{
+    std::string address = "0.0.0.0:50051"; // empty = no listening port, in-process channels only
+    ServerMode mode = SERVER_MODE_SYNC;
+    size_t io_threads = 0;                 // max gRPC threads, 0 = gRPC default
+    size_t compute_threads = 0;            // async mode only, 0 = number of hardware threads
+    size_t max_concurrent_simulations = 0; // StartSimulation/StreamSimulation calls running at once, 0 = unlimited
+    size_t max_state_bytes = 0;            // memory budget of the stored world states, 0 = unlimited
+    std::string snapshot_dir;              // where SaveSnapshot persists states, empty = snapshots disabled
+    bool worker = false;                   // also serve WorkerService, for a coordinator's slabs (see cluster.hpp)
+    std::vector<std::string> workers;      // coordinator mode: addresses of the workers that step states, empty = step locally
+    size_t halo_timeout_ms = 30000;        // coordinator mode: how long workers wait for a neighbour's plane
+};
+
+// Parses --sync, --async, --address=, --io-threads=, --compute-threads=, --max-concurrent-simulations=
+// --max-state-bytes=, --snapshot-dir=, --worker, --workers=addr,addr,... and --halo-timeout-ms=
+ServerOptions ParseServerOptions(int argc, char **argv);
+
+// A started server, stopped on destruction. Lets benchmarks and tests call it in-process.
+class ServerHandle
+{
+public:
+    struct State;
+    explicit ServerHandle(std::unique_ptr<State> state);
+    ~ServerHandle();
+
+    // Channel that skips the network stack
+    std::shared_ptr<grpc::Channel> InProcessChannel();
+    // Blocks until the server shuts down
+    void Wait();
+
+private:
+    std::unique_ptr<State> state;
+};
+
+tl::expected<std::unique_ptr<ServerHandle>, std::string> StartServer(const ServerOptions &options);
+
 void RunServer();
+void RunServer(const ServerOptions &options);
 
-#endif // SERVER_HPP
\ No newline at end of file
+#endif // SERVER_HPP
@@ -0,0 +1,148 @@
+#include "slab_decomposition.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include "step_kernel.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+// Words per task when a range of words is stepped on the pool
+constexpr size_t kSlabChunkWords = 1 << 10;
+
+const char *SideName(HaloSide side)
+{
+    return side == HALO_SIDE_LOW ? "low" : "high";
+}
+} // namespace
+
+size_t SlabRange::slabs() const
+{
+    return x_end - x_begin;
+}
+
+std::vector<SlabRange> PartitionSlabs(size_t x_max, size_t num_workers)
+{
+    std::vector<SlabRange> ranges(num_workers);
+    for (size_t i = 0; i < num_workers; ++i)
+    {
+        ranges[i].x_begin = x_max * i / num_workers;
+        ranges[i].x_end = x_max * (i + 1) / num_workers;
+    }
+    return ranges;
+}
+
+HaloSide OppositeSide(HaloSide side)
+{
+    return side == HALO_SIDE_LOW ? HALO_SIDE_HIGH : HALO_SIDE_LOW;
+}
+
+void HaloMailbox::Deliver(HaloSide side, uint64_t step, std::vector<uint64_t> plane)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        planes[{side, step}] = std::move(plane);
+    }
+    delivered.notify_all();
+}
+
+tl::expected<std::vector<uint64_t>, std::string> HaloMailbox::Take(HaloSide side, uint64_t step, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!delivered.wait_for(lock, timeout, [&]
+                            { return planes.count({side, step}) != 0; }))
+    {
+        std::ostringstream oss;
+        oss << "Timed out waiting for the " << SideName(side) << " halo of step " << step;
+        return tl::unexpected(oss.str());
+    }
+    auto it = planes.find({side, step});
+    std::vector<uint64_t> plane = std::move(it->second);
+    planes.erase(it);
+    return plane;
+}
+
+SlabStepper::SlabStepper(const BitPackedGrid3D &owned)
+    : slabs(owned.x_max), slab_bits(owned.y_max * owned.z_max),
+      current(owned.x_max + 2, owned.y_max, owned.z_max), next(owned.x_max + 2, owned.y_max, owned.z_max)
+{
+    CopyBits(owned.raw().data(), 0, current.raw().data(), slab_bits, slabs * slab_bits);
+}
+
+tl::expected<void, std::string> SlabStepper::Advance(const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps,
+                                                     HaloTransport &transport)
+{
+    return Advance(rule, rule_mode, num_steps, transport, ThreadPool::Shared());
+}
+
+tl::expected<void, std::string> SlabStepper::Advance(const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps,
+                                                     HaloTransport &transport, ThreadPool &pool)
+{
+    // Words [interior_begin, interior_end) only hold local slabs 2 .. slabs - 1, whose neighbours are all
+    // owned; the words around them touch a halo slab or an outer slab and wait for the planes
+    const size_t words = current.raw().size();
+    const size_t interior_begin = std::min(words, (2 * slab_bits + 63) / 64);
+    const size_t interior_end = std::max(interior_begin, slabs * slab_bits / 64);
+    auto step_words = [&](size_t word_begin, size_t word_end)
+    {
+        pool.ParallelFor(word_begin, word_end, kSlabChunkWords, [&](size_t begin, size_t end)
+                         { StepWords(current, next, rule, rule_mode, begin, end); });
+    };
+
+    for (uint64_t i = 0; i < num_steps; ++i)
+    {
+        if (!transport.Send(HALO_SIDE_LOW, steps_taken, Plane(1)) || !transport.Send(HALO_SIDE_HIGH, steps_taken, Plane(slabs)))
+            return tl::unexpected(std::string("Failed to send a halo plane to a neighbour"));
+
+        step_words(interior_begin, interior_end);
+
+        for (HaloSide side : {HALO_SIDE_LOW, HALO_SIDE_HIGH})
+        {
+            auto plane = transport.Receive(side, steps_taken);
+            if (!plane)
+                return tl::unexpected(plane.error());
+            if (plane->size() != plane_words())
+            {
+                std::ostringstream oss;
+                oss << "The " << SideName(side) << " halo of step " << steps_taken << " has " << plane->size()
+                    << " words, expected " << plane_words();
+                return tl::unexpected(oss.str());
+            }
+            const size_t halo_slab = side == HALO_SIDE_LOW ? 0 : slabs + 1;
+            CopyBits(plane->data(), 0, current.raw().data(), halo_slab * slab_bits, slab_bits);
+        }
+
+        step_words(0, interior_begin);
+        step_words(interior_end, words);
+        std::swap(current, next);
+        ++steps_taken;
+    }
+    if (!transport.Flush())
+        return tl::unexpected(std::string("Failed to send a halo plane to a neighbour"));
+    return {};
+}
+
+BitPackedGrid3D SlabStepper::Owned() const
+{
+    BitPackedGrid3D owned(slabs, current.y_max, current.z_max);
+    CopyBits(current.raw().data(), slab_bits, owned.raw().data(), 0, slabs * slab_bits);
+    return owned;
+}
+
+uint64_t SlabStepper::step() const
+{
+    return steps_taken;
+}
+
+size_t SlabStepper::plane_words() const
+{
+    return (slab_bits + 63) / 64;
+}
+
+std::vector<uint64_t> SlabStepper::Plane(size_t local_slab) const
+{
+    std::vector<uint64_t> plane(plane_words(), 0);
+    CopyBits(current.raw().data(), local_slab * slab_bits, plane.data(), 0, slab_bits);
+    return plane;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <tl/expected.hpp>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+
+class ThreadPool;
+
+/**
+ * Domain decomposition of a toroidal grid into slabs of whole x-slabs, stepped by separate
+ * workers (processes, or threads in tests) that only share their outer slabs.
+ *
+ * A worker owning slabs [x_begin, x_end) keeps them in a local grid with one halo slab on either
+ * side, like a window of OutOfCoreStepper: local slab 0 is x_begin - 1 and local slab n + 1 is
+ * x_end (both modulo x_max). Before every step it sends its first and last slab to the neighbouring
+ * workers, steps the slabs that need no halo while the planes are in flight, and steps its two
+ * outer slabs once the neighbours' planes have arrived. y and z wrap within every slab and x wraps
+ * through the neighbours, so the slabs put back together are bit-identical to the whole grid
+ * stepped by StepGrid, for any number of workers.
+ *
+ * How planes travel is up to a HaloTransport: gRPC between processes (see cluster.hpp) or direct
+ * calls between threads.
+ */
+
+// Slabs [x_begin, x_end) of a grid
+struct SlabRange
+{
+    size_t x_begin = 0;
+    size_t x_end = 0;
+
+    size_t slabs() const;
+};
+
+// Splits x_max slabs into num_workers ranges of sizes differing by at most one, in x order.
+// Needs 1 <= num_workers <= x_max.
+std::vector<SlabRange> PartitionSlabs(size_t x_max, size_t num_workers);
+
+// Side of a worker's slabs: LOW is towards x_begin - 1, HIGH towards x_end
+enum HaloSide
+{
+    HALO_SIDE_LOW,
+    HALO_SIDE_HIGH
+};
+
+HaloSide OppositeSide(HaloSide side);
+
+/**
+ * Halo planes received by a worker, keyed by side and step. A neighbour may run a step ahead, so
+ * planes for later steps wait until they are taken. Deliver and Take may be called from any thread.
+ */
+class HaloMailbox
+{
+public:
+    void Deliver(HaloSide side, uint64_t step, std::vector<uint64_t> plane);
+    // Waits up to timeout for the plane of side at step and removes it
+    tl::expected<std::vector<uint64_t>, std::string> Take(HaloSide side, uint64_t step, std::chrono::milliseconds timeout);
+
+private:
+    std::mutex mutex;
+    std::condition_variable delivered;
+    std::map<std::tuple<HaloSide, uint64_t>, std::vector<uint64_t>> planes;
+};
+
+class HaloTransport
+{
+public:
+    virtual ~HaloTransport() = default;
+    // Starts sending `plane`, this worker's outer slab on side `to` at `step`, to the neighbour on that
+    // side, where it fills the opposite halo. May return before it's delivered. False if an earlier
+    // send failed.
+    virtual bool Send(HaloSide to, uint64_t step, std::vector<uint64_t> plane) = 0;
+    // Blocks until the neighbour on `side` sent its plane for `step`
+    virtual tl::expected<std::vector<uint64_t>, std::string> Receive(HaloSide side, uint64_t step) = 0;
+    // Waits until every plane sent was delivered; false if one wasn't
+    virtual bool Flush() = 0;
+};
+
+// One worker's slabs, stepped in lockstep with its neighbours
+class SlabStepper
+{
+public:
+    // `owned` holds the worker's slabs (x extent = number of slabs); it must be row-major
+    explicit SlabStepper(const BitPackedGrid3D &owned);
+
+    // Advances the slabs num_steps steps, exchanging planes through the transport before every
+    // step. Interior words are stepped on the pool (ThreadPool::Shared() by default). Fails if a
+    // neighbour's plane doesn't arrive or has the wrong size; the slabs are then left mid-way.
+    tl::expected<void, std::string> Advance(const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps,
+                                            HaloTransport &transport);
+    tl::expected<void, std::string> Advance(const Bitset128 &rule, RuleMode rule_mode, uint64_t num_steps,
+                                            HaloTransport &transport, ThreadPool &pool);
+
+    // The owned slabs at the current step
+    BitPackedGrid3D Owned() const;
+    // Steps taken so far, the step number of the planes exchanged next
+    uint64_t step() const;
+    // Words of a halo plane (y_max * z_max cells)
+    size_t plane_words() const;
+
+private:
+    std::vector<uint64_t> Plane(size_t local_slab) const;
+
+    const size_t slabs;
+    const size_t slab_bits;
+    BitPackedGrid3D current;
+    BitPackedGrid3D next;
+    uint64_t steps_taken = 0;
+};
@@ -0,0 +1,167 @@
+#include "snapshot_store.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "mapped_file.hpp"
+
+namespace
+{
+constexpr char kMagic[8] = {'C', 'A', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t kVersion = 1;
+constexpr const char *kSuffix = ".snap";
+} // namespace
+
+SnapshotHeader SnapshotHeader::Make(size_t x_max, size_t y_max, size_t z_max, uint64_t step, RuleMode rule_mode, bool hashlife,
+                                    const Fingerprint128 &fingerprint, GridLayout layout)
+{
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.flags = (rule_mode == RULE_3D ? kFlagRule3D : 0) | (hashlife ? kFlagHashLife : 0) |
+                   (layout == GRID_LAYOUT_BRICK ? kFlagBrickLayout : 0);
+    header.x_max = x_max;
+    header.y_max = y_max;
+    header.z_max = z_max;
+    header.step = step;
+    header.fingerprint_lo = fingerprint.lo;
+    header.fingerprint_hi = fingerprint.hi;
+    return header;
+}
+
+tl::expected<SnapshotHeader, std::string> SnapshotHeader::Parse(const char *bytes, size_t file_bytes, const std::string &path)
+{
+    SnapshotHeader header;
+    if (file_bytes < sizeof(header))
+        return tl::unexpected("Snapshot " + path + " is truncated");
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion)
+        return tl::unexpected("Snapshot " + path + " has an unknown format");
+    if (header.x_max == 0 || header.y_max == 0 || header.z_max == 0 ||
+        file_bytes != sizeof(header) + header.num_words() * sizeof(uint64_t) ||
+        !BitPackedGrid3D::SupportsLayout(header.layout(), header.x_max, header.y_max, header.z_max))
+        return tl::unexpected("Snapshot " + path + " doesn't match its dimensions");
+    return header;
+}
+
+SnapshotStore::SnapshotStore(std::string directory) : directory(std::move(directory)) {}
+
+tl::expected<std::unique_ptr<SnapshotStore>, std::string> SnapshotStore::Open(const std::string &directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+        return tl::unexpected("Can't create snapshot directory " + directory + ": " + error.message());
+
+    std::unique_ptr<SnapshotStore> store(new SnapshotStore(directory));
+    for (const auto &file : std::filesystem::directory_iterator(directory, error))
+    {
+        const std::string name = file.path().filename().string();
+        if (name.size() <= std::strlen(kSuffix) || name.compare(name.size() - std::strlen(kSuffix), std::string::npos, kSuffix) != 0)
+            continue;
+        const std::string stem = name.substr(0, name.size() - std::strlen(kSuffix));
+        if (stem.find_first_not_of("0123456789") != std::string::npos)
+            continue;
+        store->ids.insert(std::stoull(stem));
+    }
+    if (error)
+        return tl::unexpected("Can't list snapshot directory " + directory + ": " + error.message());
+    return store;
+}
+
+std::string SnapshotStore::PathFor(uint64_t id) const
+{
+    return (std::filesystem::path(directory) / (std::to_string(id) + kSuffix)).string();
+}
+
+tl::expected<size_t, std::string> SnapshotStore::Save(uint64_t id, const Snapshot &snapshot)
+{
+    const BitPackedGrid3D &grid = snapshot.grid;
+    const Fingerprint128 fingerprint = FingerprintGrid(grid);
+
+    const SnapshotHeader header = SnapshotHeader::Make(grid.x_max, grid.y_max, grid.z_max, snapshot.step, snapshot.rule_mode,
+                                                       snapshot.hashlife, fingerprint, grid.layout());
+
+    const std::string path = PathFor(id);
+    const std::string temp_path = path + ".tmp" + std::to_string(next_temp_suffix.fetch_add(1));
+    const size_t words_bytes = grid.raw().size() * sizeof(uint64_t);
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(grid.raw().data()), words_bytes);
+        out.flush();
+        if (!out)
+        {
+            std::filesystem::remove(temp_path);
+            return tl::unexpected("Can't write snapshot " + temp_path);
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temp_path);
+        return tl::unexpected("Can't replace snapshot " + path + ": " + error.message());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ids.insert(id);
+    return sizeof(header) + words_bytes;
+}
+
+tl::expected<Snapshot, std::string> SnapshotStore::Load(uint64_t id) const
+{
+    if (!Contains(id))
+        return tl::unexpected("No snapshot found for id: " + std::to_string(id));
+
+    const std::string path = PathFor(id);
+    auto mapped = MappedFile::OpenReadOnly(path);
+    if (!mapped)
+        return tl::unexpected(mapped.error());
+
+    auto parsed = SnapshotHeader::Parse(mapped->data(), mapped->size(), path);
+    if (!parsed)
+        return tl::unexpected(parsed.error());
+    const SnapshotHeader &header = *parsed;
+
+    Snapshot snapshot{BitPackedGrid3D(header.x_max, header.y_max, header.z_max, header.layout()), header.step, header.rule_mode(),
+                      (header.flags & SnapshotHeader::kFlagHashLife) != 0};
+    std::vector<uint64_t> &words = snapshot.grid.raw();
+    std::memcpy(words.data(), mapped->data() + sizeof(header), words.size() * sizeof(uint64_t));
+
+    const Fingerprint128 fingerprint = FingerprintGrid(snapshot.grid);
+    if (fingerprint.lo != header.fingerprint_lo || fingerprint.hi != header.fingerprint_hi)
+        return tl::unexpected("Snapshot " + path + " fails its checksum");
+    return snapshot;
+}
+
+bool SnapshotStore::Erase(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ids.erase(id) == 0)
+        return false;
+    std::error_code error;
+    std::filesystem::remove(PathFor(id), error);
+    return true;
+}
+
+bool SnapshotStore::Contains(uint64_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ids.count(id) != 0;
+}
+
+size_t SnapshotStore::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ids.size();
+}
+
+std::optional<uint64_t> SnapshotStore::max_id() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ids.empty())
+        return std::nullopt;
+    return *ids.rbegin();
+}
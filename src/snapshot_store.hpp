@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <tl/expected.hpp>
+#include "bit_packed_grid_3d.hpp"
+#include "fingerprint.hpp"
+#include "random_bitset.hpp"
+
+// Start of every snapshot file, followed by the grid's words in host byte order
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags; // kFlagRule3D | kFlagHashLife | kFlagBrickLayout
+    uint64_t x_max, y_max, z_max;
+    uint64_t step;
+    uint64_t fingerprint_lo, fingerprint_hi; // FingerprintGrid of the words
+
+    static constexpr uint32_t kFlagRule3D = 1;
+    static constexpr uint32_t kFlagHashLife = 2;
+    static constexpr uint32_t kFlagBrickLayout = 4; // words are in GRID_LAYOUT_BRICK
+
+    static SnapshotHeader Make(size_t x_max, size_t y_max, size_t z_max, uint64_t step, RuleMode rule_mode, bool hashlife,
+                               const Fingerprint128 &fingerprint, GridLayout layout = GRID_LAYOUT_ROW_MAJOR);
+    // Validates a header read from a file of `file_bytes` bytes; `path` is only used in error messages
+    static tl::expected<SnapshotHeader, std::string> Parse(const char *bytes, size_t file_bytes, const std::string &path);
+
+    size_t num_words() const { return (x_max * y_max * z_max + 63) / 64; }
+    RuleMode rule_mode() const { return (flags & kFlagRule3D) ? RULE_3D : RULE_1D_ECA; }
+    GridLayout layout() const { return (flags & kFlagBrickLayout) ? GRID_LAYOUT_BRICK : GRID_LAYOUT_ROW_MAJOR; }
+};
+static_assert(sizeof(SnapshotHeader) == 64, "words must start at a 64-byte offset");
+
+// A world state as persisted by SnapshotStore
+struct Snapshot
+{
+    BitPackedGrid3D grid;
+    uint64_t step = 0;
+    RuleMode rule_mode = RULE_1D_ECA;
+    bool hashlife = false; // stepped by HashLifeEngine
+};
+
+/**
+ * One file per world state in a directory: "<id>.snap" holds a SnapshotHeader (dimensions,
+ * step, rule mode, fingerprint of the words) followed by the grid's raw words, so the words
+ * can be mapped straight from the file.
+ *
+ * Opening a store only lists the directory. A snapshot is mapped, checked and copied into a
+ * grid when it is loaded, so restart time doesn't depend on how much is stored and states
+ * nobody touches never become resident. Saves write a temporary file and rename it over the
+ * old snapshot, so a crash mid-save leaves the previous snapshot intact.
+ */
+class SnapshotStore
+{
+public:
+    // Creates the directory if needed
+    static tl::expected<std::unique_ptr<SnapshotStore>, std::string> Open(const std::string &directory);
+
+    // Returns the number of bytes written
+    tl::expected<size_t, std::string> Save(uint64_t id, const Snapshot &snapshot);
+    // Fails if there's no snapshot for id or it is truncated or corrupt
+    tl::expected<Snapshot, std::string> Load(uint64_t id) const;
+
+    // Returns false if there was no snapshot for id
+    bool Erase(uint64_t id);
+
+    bool Contains(uint64_t id) const;
+    size_t size() const;
+    // Highest id with a snapshot, so new ids can be allocated past it
+    std::optional<uint64_t> max_id() const;
+
+private:
+    explicit SnapshotStore(std::string directory);
+    std::string PathFor(uint64_t id) const;
+
+    const std::string directory;
+    mutable std::mutex mutex;
+    std::set<uint64_t> ids; // guarded by mutex
+    std::atomic<uint64_t> next_temp_suffix{0};
+};
@@ -0,0 +1,488 @@
+#include "step_kernel.hpp"
+#include "step_kernel_impl.hpp"
+#include "rule_compiler.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace step_kernel_detail
+{
+StepWordsFn ScalarStepWords()
+{
+    return &StepWordsGeneric<ScalarVec>;
+}
+} // namespace step_kernel_detail
+
+namespace
+{
+StepWordsFn BackendStepWords(StepBackend backend)
+{
+    switch (backend)
+    {
+    case STEP_BACKEND_SCALAR:
+        return ScalarStepWords();
+    case STEP_BACKEND_AVX2:
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        return __builtin_cpu_supports("avx2") ? Avx2StepWords() : nullptr;
+#else
+        return nullptr;
+#endif
+    case STEP_BACKEND_AVX512:
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        return __builtin_cpu_supports("avx512f") ? Avx512StepWords() : nullptr;
+#else
+        return nullptr;
+#endif
+    case STEP_BACKEND_NEON:
+        // NEON is part of the baseline instruction set wherever the backend is compiled in
+        return NeonStepWords();
+    }
+    return nullptr;
+}
+
+// Picks the widest available backend, unless CA_STEP_BACKEND names one explicitly.
+StepBackend SelectStepBackend()
+{
+    StepBackend best = STEP_BACKEND_SCALAR;
+    for (StepBackend backend : AvailableStepBackends())
+        best = backend;
+
+    const char *forced = std::getenv("CA_STEP_BACKEND");
+    if (forced == nullptr || std::strcmp(forced, "auto") == 0)
+        return best;
+
+    for (StepBackend backend : AvailableStepBackends())
+    {
+        if (std::strcmp(forced, StepBackendName(backend)) == 0)
+            return backend;
+    }
+    std::cerr << "CA_STEP_BACKEND=" << forced << " is not available on this machine, using "
+              << StepBackendName(best) << std::endl;
+    return best;
+}
+
+std::atomic<StepBackend> &ActiveBackend()
+{
+    static std::atomic<StepBackend> active{SelectStepBackend()};
+    return active;
+}
+
+// Builds a periodic mask, with a phase table when the period fits in a word.
+PeriodicMaskTable MakePeriodicMask(size_t period, size_t lo, size_t hi, std::vector<uint64_t> &storage)
+{
+    PeriodicMaskTable mask{period, lo, hi, kWordBits % period, nullptr};
+    if (period <= kWordBits)
+    {
+        storage.resize(period);
+        for (size_t phase = 0; phase < period; ++phase)
+            storage[phase] = ComputePeriodicMask(period, lo, hi, phase);
+        mask.table = storage.data();
+    }
+    return mask;
+}
+} // namespace
+
+const char *StepBackendName(StepBackend backend)
+{
+    switch (backend)
+    {
+    case STEP_BACKEND_SCALAR:
+        return "scalar";
+    case STEP_BACKEND_AVX2:
+        return "avx2";
+    case STEP_BACKEND_AVX512:
+        return "avx512";
+    case STEP_BACKEND_NEON:
+        return "neon";
+    }
+    return "unknown";
+}
+
+std::vector<StepBackend> AvailableStepBackends()
+{
+    std::vector<StepBackend> backends;
+    for (StepBackend backend : {STEP_BACKEND_SCALAR, STEP_BACKEND_NEON, STEP_BACKEND_AVX2, STEP_BACKEND_AVX512})
+    {
+        if (BackendStepWords(backend) != nullptr)
+            backends.push_back(backend);
+    }
+    return backends;
+}
+
+StepBackend ActiveStepBackend()
+{
+    return ActiveBackend().load(std::memory_order_relaxed);
+}
+
+bool SetStepBackend(StepBackend backend)
+{
+    if (BackendStepWords(backend) == nullptr)
+        return false;
+    ActiveBackend().store(backend, std::memory_order_relaxed);
+    return true;
+}
+
+RuleTable MakeRuleTable(const Bitset128 &rule)
+{
+    RuleTable table{0, 0};
+    for (size_t i = 0; i < 64; ++i)
+    {
+        table.lo |= static_cast<uint64_t>(rule[i]) << i;
+        table.hi |= static_cast<uint64_t>(rule[i + 64]) << i;
+    }
+    return table;
+}
+
+namespace
+{
+// Smallest grid (in words) that is split across the thread pool; below that the hand-off costs more than it saves.
+constexpr size_t kParallelMinWords = 1 << 12;
+// Words per work item, a multiple of every backend's vector width.
+constexpr size_t kChunkWords = 1 << 10;
+
+// A StepContext together with the storage its mask tables point into, the compiled rule and the grids' brick order.
+struct PreparedStep
+{
+    StepContext ctx;
+    std::vector<uint64_t> mask_storage[4];
+    std::shared_ptr<const RulePlan> plan;
+    const BrickOrder *bricks = nullptr;
+};
+
+void PrepareStep(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule,
+                 RuleMode rule_mode, PreparedStep &prepared)
+{
+    const size_t num_cells = current.size_in_bits();
+    const size_t z_max = current.z_max;
+    const size_t yz = current.y_max * z_max;
+
+    StepContext &ctx = prepared.ctx;
+    ctx.in = current.raw().data();
+    ctx.out = next.raw().data();
+    ctx.num_cells = num_cells;
+    ctx.num_words = current.raw().size();
+    prepared.bricks = current.brick_order();
+    prepared.plan = CompileRule(rule, rule_mode);
+    // Pairs the rule never reads aren't loaded at all
+    const RulePlan &plan = *prepared.plan;
+    const bool uses_y = plan.reads_y && current.y_max > 1;
+    const bool uses_z = plan.reads_z && z_max > 1;
+    ctx.shape = uses_y ? (uses_z ? KERNEL_XYZ : KERNEL_XY) : (uses_z ? KERNEL_XZ : KERNEL_X);
+
+    auto offset = [num_cells](size_t forward, size_t backward)
+    { return (num_cells + forward % num_cells - backward % num_cells) % num_cells; };
+    ctx.offsets[WINDOW_XM] = offset(0, yz);
+    ctx.offsets[WINDOW_XP] = offset(yz, 0);
+    ctx.offsets[WINDOW_YM] = offset(0, z_max);
+    ctx.offsets[WINDOW_YM_WRAP] = offset(yz, z_max);
+    ctx.offsets[WINDOW_YP] = offset(z_max, 0);
+    ctx.offsets[WINDOW_YP_WRAP] = offset(z_max, yz);
+    ctx.offsets[WINDOW_ZM] = offset(0, 1);
+    ctx.offsets[WINDOW_ZM_WRAP] = offset(z_max, 1);
+    ctx.offsets[WINDOW_ZP] = offset(1, 0);
+    ctx.offsets[WINDOW_ZP_WRAP] = offset(1, z_max);
+
+    ctx.y_first = MakePeriodicMask(yz, 0, z_max, prepared.mask_storage[0]);
+    ctx.y_last = MakePeriodicMask(yz, yz - z_max, yz, prepared.mask_storage[1]);
+    ctx.z_first = MakePeriodicMask(z_max, 0, 1, prepared.mask_storage[2]);
+    ctx.z_last = MakePeriodicMask(z_max, z_max - 1, z_max, prepared.mask_storage[3]);
+
+    // The plan folds the pairs the kernel doesn't read into the rule
+    const size_t leaves = RulePlan::LeafIndex(uses_y, uses_z);
+    std::copy(plan.leaf_clear[leaves].begin(), plan.leaf_clear[leaves].end(), ctx.leaf_clear);
+    std::copy(plan.leaf_set[leaves].begin(), plan.leaf_set[leaves].end(), ctx.leaf_set);
+}
+
+
+// Cells of a brick on its first/last z and first/last y (see BrickOrder)
+constexpr uint64_t kBrickZFirst = 0x1111111111111111ULL;
+constexpr uint64_t kBrickZLast = 0x8888888888888888ULL;
+constexpr uint64_t kBrickYFirst = 0x000F000F000F000FULL;
+constexpr uint64_t kBrickYLast = 0xF000F000F000F000ULL;
+
+size_t WrapDown(size_t value, size_t count)
+{
+    return value == 0 ? count - 1 : value - 1;
+}
+
+size_t WrapUp(size_t value, size_t count)
+{
+    return value + 1 == count ? 0 : value + 1;
+}
+
+/**
+ * Brick layout kernel. A neighbour pair of a brick's cells is the brick shifted by one cell
+ * along the axis, with the face that moves out refilled from the adjacent brick's opposite
+ * face: seven words in, one word out, no masks that depend on the position in the grid.
+ */
+template <KernelShape kShape>
+void StepBricksShaped(const StepContext &ctx, const BrickOrder &order, size_t word_begin, size_t word_end)
+{
+    using Traits = ShapeTraits<kShape>;
+    for (size_t w = word_begin; w < word_end; ++w)
+    {
+        size_t bx, by, bz;
+        order.Brick(w, bx, by, bz);
+        const size_t sx = order.spread_x[bx];
+        const size_t sy = order.spread_y[by];
+        const size_t sz = order.spread_z[bz];
+        const uint64_t center = ctx.in[w];
+
+        ScalarVec inputs[Traits::kVars];
+        size_t next = 0;
+        if constexpr (Traits::kUsesZ)
+        {
+            const uint64_t zm = ctx.in[sx | sy | order.spread_z[WrapDown(bz, order.bricks_z)]];
+            const uint64_t zp = ctx.in[sx | sy | order.spread_z[WrapUp(bz, order.bricks_z)]];
+            inputs[next++] = {((center >> 1) & ~kBrickZLast) | ((zp << 3) & kBrickZLast)};
+            inputs[next++] = {((center << 1) & ~kBrickZFirst) | ((zm >> 3) & kBrickZFirst)};
+        }
+        if constexpr (Traits::kUsesY)
+        {
+            const uint64_t ym = ctx.in[sx | order.spread_y[WrapDown(by, order.bricks_y)] | sz];
+            const uint64_t yp = ctx.in[sx | order.spread_y[WrapUp(by, order.bricks_y)] | sz];
+            inputs[next++] = {((center >> 4) & ~kBrickYLast) | ((yp << 12) & kBrickYLast)};
+            inputs[next++] = {((center << 4) & ~kBrickYFirst) | ((ym >> 12) & kBrickYFirst)};
+        }
+        const uint64_t xm = ctx.in[order.spread_x[WrapDown(bx, order.bricks_x)] | sy | sz];
+        const uint64_t xp = ctx.in[order.spread_x[WrapUp(bx, order.bricks_x)] | sy | sz];
+        inputs[next++] = {(center >> 16) | (xp << 48)};
+        inputs[next++] = {(center << 16) | (xm >> 48)};
+        inputs[next] = {center};
+        ctx.out[w] = EvaluateRule<ScalarVec, Traits::kVars>(ctx, inputs).v;
+    }
+}
+
+// Computes output words [word_begin, word_end) of a prepared step in the grids' layout. Rules
+// that ignore the neighbourhood fill or copy words instead of evaluating anything.
+void StepPreparedWords(const PreparedStep &prepared, StepWordsFn step_words, size_t word_begin, size_t word_end)
+{
+    const StepContext &ctx = prepared.ctx;
+    switch (prepared.plan->kind)
+    {
+    case RULE_PLAN_ALL_DEAD:
+    case RULE_PLAN_ALL_LIVE:
+        std::fill(ctx.out + word_begin, ctx.out + word_end, prepared.plan->kind == RULE_PLAN_ALL_LIVE ? ~0ULL : 0);
+        if (word_end == ctx.num_words && ctx.num_cells % kWordBits != 0)
+            ctx.out[word_end - 1] &= (1ULL << (ctx.num_cells % kWordBits)) - 1; // padding bits stay zero
+        return;
+    case RULE_PLAN_IDENTITY:
+        std::copy(ctx.in + word_begin, ctx.in + word_end, ctx.out + word_begin);
+        return;
+    case RULE_PLAN_GENERAL:
+        break;
+    }
+
+    if (prepared.bricks == nullptr)
+    {
+        step_words(ctx, word_begin, word_end);
+        return;
+    }
+    switch (ctx.shape)
+    {
+    case KERNEL_X:
+        StepBricksShaped<KERNEL_X>(ctx, *prepared.bricks, word_begin, word_end);
+        break;
+    case KERNEL_XY:
+        StepBricksShaped<KERNEL_XY>(ctx, *prepared.bricks, word_begin, word_end);
+        break;
+    case KERNEL_XZ:
+        StepBricksShaped<KERNEL_XZ>(ctx, *prepared.bricks, word_begin, word_end);
+        break;
+    case KERNEL_XYZ:
+        StepBricksShaped<KERNEL_XYZ>(ctx, *prepared.bricks, word_begin, word_end);
+        break;
+    }
+}
+} // namespace
+
+void StepWords(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule,
+               RuleMode rule_mode, size_t word_begin, size_t word_end)
+{
+    word_end = std::min(word_end, current.raw().size());
+    if (word_begin >= word_end)
+        return;
+
+    if (current.size_in_bits() < kWordBits)
+    {
+        StepGridReference(current, next, rule, rule_mode);
+        return;
+    }
+
+    PreparedStep prepared;
+    PrepareStep(current, next, rule, rule_mode, prepared);
+    StepPreparedWords(prepared, BackendStepWords(ActiveStepBackend()), word_begin, word_end);
+}
+
+void StepGrid(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule, RuleMode rule_mode)
+{
+    StepGrid(current, next, rule, rule_mode, ThreadPool::Shared());
+}
+
+void StepGrid(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule, RuleMode rule_mode,
+              ThreadPool &pool)
+{
+    const size_t num_words = current.raw().size();
+    if (num_words < kParallelMinWords || pool.num_threads() == 1)
+    {
+        StepWords(current, next, rule, rule_mode, 0, num_words);
+        return;
+    }
+
+    PreparedStep prepared;
+    PrepareStep(current, next, rule, rule_mode, prepared);
+    const StepWordsFn step_words = BackendStepWords(ActiveStepBackend());
+    // Chunks are whole output words, so the threads never write to the same word. In the brick
+    // layout a chunk is a compact block of bricks.
+    pool.ParallelFor(0, num_words, kChunkWords, [&](size_t begin, size_t end)
+                     { StepPreparedWords(prepared, step_words, begin, end); });
+}
+
+size_t NumActiveBlocks(const BitPackedGrid3D &grid)
+{
+    return (grid.raw().size() + kActiveBlockWords - 1) / kActiveBlockWords;
+}
+
+ActiveStepStats StepGridActive(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule,
+                               RuleMode rule_mode, std::vector<uint8_t> &changed)
+{
+    const size_t num_words = current.raw().size();
+    const size_t num_blocks = NumActiveBlocks(current);
+    ActiveStepStats stats;
+    if (current.size_in_bits() < kWordBits || changed.size() != num_blocks)
+    {
+        StepGrid(current, next, rule, rule_mode);
+        changed.assign(num_blocks, 1);
+        stats.blocks_computed = num_blocks;
+        return stats;
+    }
+
+    PreparedStep prepared;
+    PrepareStep(current, next, rule, rule_mode, prepared);
+    const StepContext &ctx = prepared.ctx;
+
+    // Output cell c reads input cell c + offset (mod num_cells) for every window offset, so a changed
+    // input block dirties the output blocks its cells land in when shifted back by each offset.
+    const size_t block_cells = kActiveBlockWords * kWordBits;
+    const bool uses_y = ctx.shape == KERNEL_XY || ctx.shape == KERNEL_XYZ;
+    const bool uses_z = ctx.shape == KERNEL_XZ || ctx.shape == KERNEL_XYZ;
+    std::vector<uint8_t> dirty(num_blocks, 0);
+    const BrickOrder *bricks = current.brick_order();
+    for (size_t u = 0; u < num_blocks && bricks != nullptr; ++u)
+    {
+        if (!changed[u])
+            continue;
+        // A brick's cells only read the adjacent bricks
+        for (size_t w = u * kActiveBlockWords; w < std::min(num_words, (u + 1) * kActiveBlockWords); ++w)
+        {
+            size_t bx, by, bz;
+            bricks->Brick(w, bx, by, bz);
+            dirty[w / kActiveBlockWords] = 1;
+            dirty[bricks->Word(WrapDown(bx, bricks->bricks_x), by, bz) / kActiveBlockWords] = 1;
+            dirty[bricks->Word(WrapUp(bx, bricks->bricks_x), by, bz) / kActiveBlockWords] = 1;
+            if (uses_y)
+            {
+                dirty[bricks->Word(bx, WrapDown(by, bricks->bricks_y), bz) / kActiveBlockWords] = 1;
+                dirty[bricks->Word(bx, WrapUp(by, bricks->bricks_y), bz) / kActiveBlockWords] = 1;
+            }
+            if (uses_z)
+            {
+                dirty[bricks->Word(bx, by, WrapDown(bz, bricks->bricks_z)) / kActiveBlockWords] = 1;
+                dirty[bricks->Word(bx, by, WrapUp(bz, bricks->bricks_z)) / kActiveBlockWords] = 1;
+            }
+        }
+    }
+    for (size_t u = 0; u < num_blocks && bricks == nullptr; ++u)
+    {
+        if (!changed[u])
+            continue;
+        dirty[u] = 1;
+        const size_t first_input = u * block_cells;
+        const size_t last_input = std::min(first_input + block_cells, ctx.num_cells) - 1;
+        for (size_t i = 0; i < NUM_WINDOWS; ++i)
+        {
+            if ((!uses_y && i >= WINDOW_YM && i <= WINDOW_YP_WRAP) || (!uses_z && i >= WINDOW_ZM))
+                continue;
+            const size_t shift = ctx.num_cells - ctx.offsets[i];
+            const size_t first = (first_input + shift) % ctx.num_cells / block_cells;
+            const size_t last = (last_input + shift) % ctx.num_cells / block_cells;
+            for (size_t b = first;; b = (b + 1) % num_blocks)
+            {
+                dirty[b] = 1;
+                if (b == last)
+                    break;
+            }
+        }
+    }
+    std::vector<size_t> to_compute;
+    for (size_t b = 0; b < num_blocks; ++b)
+    {
+        if (dirty[b])
+            to_compute.push_back(b);
+    }
+
+    const StepWordsFn step_words = BackendStepWords(ActiveStepBackend());
+    std::vector<uint8_t> next_changed(num_blocks, 0);
+    const std::vector<uint64_t> &before = current.raw();
+    const std::vector<uint64_t> &after = next.raw();
+    // Blocks are whole output words, so the threads never write to the same word
+    const size_t grain = std::max<size_t>(1, kChunkWords / kActiveBlockWords);
+    auto compute = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const size_t b = to_compute[i];
+            const size_t word_begin = b * kActiveBlockWords;
+            const size_t word_end = std::min(num_words, word_begin + kActiveBlockWords);
+            StepPreparedWords(prepared, step_words, word_begin, word_end);
+            next_changed[b] = !std::equal(before.begin() + word_begin, before.begin() + word_end, after.begin() + word_begin);
+        }
+    };
+    if (to_compute.size() * kActiveBlockWords < kParallelMinWords)
+        compute(0, to_compute.size());
+    else
+        ThreadPool::Shared().ParallelFor(0, to_compute.size(), grain, compute);
+
+    changed.swap(next_changed);
+    stats.blocks_computed = to_compute.size();
+    stats.blocks_skipped = num_blocks - to_compute.size();
+    return stats;
+}
+
+// The grid is toroidal (wraps around in all directions)
+void StepGridReference(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule,
+                       RuleMode rule_mode)
+{
+    const size_t x_max = current.x_max;
+    const size_t y_max = current.y_max;
+    const size_t z_max = current.z_max;
+
+    for (size_t i = 0; i < x_max * y_max * z_max; ++i)
+    {
+        auto [x, y, z] = current.unpack_bit_index(i);
+        uint8_t central_bit = current.get(i);
+        // Get the neighbors, handling boundary conditions with modulo
+        // (x + x_max - 1) % x_max safely wraps around to x_max - 1 when x == 0
+        // Below, two binary neighbor values are packed into a 2-bit value, like this:
+        // uint8_t pair = (left << 1) | right;
+        uint8_t x_neighbors = (current.get((x + x_max - 1) % x_max, y, z) << 1) |
+                              current.get((x + 1) % x_max, y, z);
+        uint8_t y_neighbors = (current.get(x, (y + y_max - 1) % y_max, z) << 1) |
+                              current.get(x, (y + 1) % y_max, z);
+        uint8_t z_neighbors = (current.get(x, y, (z + z_max - 1) % z_max) << 1) |
+                              current.get(x, y, (z + 1) % z_max);
+
+        if (rule_mode == RULE_1D_ECA)
+        {
+            y_neighbors = 0;
+            z_neighbors = 0;
+        }
+
+        next.set(i, does_cell_live(rule, central_bit, x_neighbors, y_neighbors, z_neighbors));
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+
+class ThreadPool;
+
+/**
+ * Word-parallel stepping engine.
+ *
+ * BitPackedGrid3D stores cells row-major, 64 per uint64_t. Instead of visiting
+ * cells one at a time, the engine builds the seven neighbourhood words of an
+ * output word (central, x-/x+, y-/y+, z-/z+) by reading the input at shifted
+ * bit offsets, patches the toroidal wrap at row/plane boundaries with masks and
+ * evaluates the 128-bit rule as boolean logic on whole words.
+ *
+ * The words are processed by one of several backends: a portable scalar one and SIMD ones
+ * handling 4 (AVX2), 8 (AVX-512) or 2 (NEON) words per instruction. The widest backend the CPU
+ * supports is picked at startup; CA_STEP_BACKEND=scalar|avx2|avx512|neon overrides the choice.
+ *
+ * Rules are compiled once (see CompileRule): neighbour pairs a rule ignores are never read,
+ * and rules that ignore the whole neighbourhood just fill or copy the words.
+ *
+ * Grids in the brick layout (GRID_LAYOUT_BRICK) are stepped one brick word at a time from the
+ * word itself and its six adjacent bricks, on the scalar path whatever the backend.
+ */
+
+enum StepBackend
+{
+    STEP_BACKEND_SCALAR,
+    STEP_BACKEND_AVX2,
+    STEP_BACKEND_AVX512,
+    STEP_BACKEND_NEON
+};
+
+const char *StepBackendName(StepBackend backend);
+// Backends compiled in and supported by this CPU, narrowest first. Always contains STEP_BACKEND_SCALAR.
+std::vector<StepBackend> AvailableStepBackends();
+StepBackend ActiveStepBackend();
+// Switches the backend used by all subsequent steps, e.g. to diff results across backends.
+// Returns false (and keeps the current backend) if it isn't available.
+bool SetStepBackend(StepBackend backend);
+
+// The 128-bit rule split into two machine words: bit i of the rule is bit (i % 64) of lo/hi.
+struct RuleTable
+{
+    uint64_t lo;
+    uint64_t hi;
+};
+
+RuleTable MakeRuleTable(const Bitset128 &rule);
+
+// Computes output words [word_begin, word_end) of `next` from `current`.
+// Both grids must have the same dimensions and layout. Only the given output words are written,
+// so disjoint word ranges may be computed independently.
+void StepWords(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule,
+               RuleMode rule_mode, size_t word_begin, size_t word_end);
+
+// Computes the whole next state of `current` into `next`. Large grids are split into word-aligned
+// chunks stepped on the pool (ThreadPool::Shared() by default); small ones run on the calling thread.
+void StepGrid(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule, RuleMode rule_mode);
+void StepGrid(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule, RuleMode rule_mode,
+              ThreadPool &pool);
+
+// Words per block of StepGridActive's change tracking, a multiple of every backend's vector width.
+constexpr size_t kActiveBlockWords = 16;
+
+struct ActiveStepStats
+{
+    size_t blocks_computed = 0;
+    size_t blocks_skipped = 0;
+};
+
+size_t NumActiveBlocks(const BitPackedGrid3D &grid);
+
+// Like StepGrid, but only recomputes the blocks of kActiveBlockWords words whose inputs changed in
+// the previous step. On entry `next` must hold the state before `current`, stepped with the same rule,
+// and changed[b] must tell whether block b differs between the two (all 1 when unknown). A block
+// none of whose input blocks changed would come out as it is in `current`, which is what `next`
+// already holds, so it is skipped. On return changed[b] tells whether block b of `next` differs from `current`.
+ActiveStepStats StepGridActive(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule,
+                               RuleMode rule_mode, std::vector<uint8_t> &changed);
+
+// Cell-by-cell reference implementation of the update rule. Used for grids smaller than
+// one word and to cross-check the word-parallel kernel.
+void StepGridReference(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule,
+                       RuleMode rule_mode);
@@ -0,0 +1,35 @@
+#include "step_kernel_impl.hpp"
+
+// Compiled with -mavx2 on x86 (see CMakeLists.txt). Without it the backend is left out.
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2Vec
+{
+    static constexpr size_t kLanes = 4;
+    __m256i v;
+
+    static Avx2Vec Load(const uint64_t *p) { return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))}; }
+    static void Store(uint64_t *p, Avx2Vec a) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a.v); }
+    static Avx2Vec Broadcast(uint64_t x) { return {_mm256_set1_epi64x(static_cast<long long>(x))}; }
+    static Avx2Vec And(Avx2Vec a, Avx2Vec b) { return {_mm256_and_si256(a.v, b.v)}; }
+    static Avx2Vec AndNot(Avx2Vec a, Avx2Vec b) { return {_mm256_andnot_si256(a.v, b.v)}; }
+    static Avx2Vec Or(Avx2Vec a, Avx2Vec b) { return {_mm256_or_si256(a.v, b.v)}; }
+    static Avx2Vec Xor(Avx2Vec a, Avx2Vec b) { return {_mm256_xor_si256(a.v, b.v)}; }
+    static Avx2Vec ShiftRight(Avx2Vec a, size_t n) { return {_mm256_srl_epi64(a.v, _mm_cvtsi64_si128(static_cast<long long>(n)))}; }
+    static Avx2Vec ShiftLeft(Avx2Vec a, size_t n) { return {_mm256_sll_epi64(a.v, _mm_cvtsi64_si128(static_cast<long long>(n)))}; }
+};
+} // namespace
+
+step_kernel_detail::StepWordsFn step_kernel_detail::Avx2StepWords()
+{
+    return &StepWordsGeneric<Avx2Vec>;
+}
+#else
+step_kernel_detail::StepWordsFn step_kernel_detail::Avx2StepWords()
+{
+    return nullptr;
+}
+#endif
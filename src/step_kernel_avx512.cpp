@@ -0,0 +1,35 @@
+#include "step_kernel_impl.hpp"
+
+// Compiled with -mavx512f on x86 (see CMakeLists.txt). Without it the backend is left out.
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace
+{
+struct Avx512Vec
+{
+    static constexpr size_t kLanes = 8;
+    __m512i v;
+
+    static Avx512Vec Load(const uint64_t *p) { return {_mm512_loadu_si512(p)}; }
+    static void Store(uint64_t *p, Avx512Vec a) { _mm512_storeu_si512(p, a.v); }
+    static Avx512Vec Broadcast(uint64_t x) { return {_mm512_set1_epi64(static_cast<long long>(x))}; }
+    static Avx512Vec And(Avx512Vec a, Avx512Vec b) { return {_mm512_and_si512(a.v, b.v)}; }
+    static Avx512Vec AndNot(Avx512Vec a, Avx512Vec b) { return {_mm512_andnot_si512(a.v, b.v)}; }
+    static Avx512Vec Or(Avx512Vec a, Avx512Vec b) { return {_mm512_or_si512(a.v, b.v)}; }
+    static Avx512Vec Xor(Avx512Vec a, Avx512Vec b) { return {_mm512_xor_si512(a.v, b.v)}; }
+    static Avx512Vec ShiftRight(Avx512Vec a, size_t n) { return {_mm512_srl_epi64(a.v, _mm_cvtsi64_si128(static_cast<long long>(n)))}; }
+    static Avx512Vec ShiftLeft(Avx512Vec a, size_t n) { return {_mm512_sll_epi64(a.v, _mm_cvtsi64_si128(static_cast<long long>(n)))}; }
+};
+} // namespace
+
+step_kernel_detail::StepWordsFn step_kernel_detail::Avx512StepWords()
+{
+    return &StepWordsGeneric<Avx512Vec>;
+}
+#else
+step_kernel_detail::StepWordsFn step_kernel_detail::Avx512StepWords()
+{
+    return nullptr;
+}
+#endif
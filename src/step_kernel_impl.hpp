@@ -0,0 +1,364 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Internals shared by the step kernel backends (step_kernel*.cpp).
+ *
+ * The backends are compiled with different instruction-set flags, so apart from the plain
+ * StepContext struct everything in this header has internal linkage: an AVX2 copy of an
+ * inline helper must never be picked by the linker for the scalar code.
+ */
+
+namespace step_kernel_detail
+{
+constexpr size_t kWordBits = 64;
+
+// Windows read for every output word, as flat-index offsets modulo the grid size.
+// The *_WRAP variants are used for cells on the first/last z of a row or the first/last y of a plane.
+enum WindowIndex
+{
+    WINDOW_XM,
+    WINDOW_XP,
+    WINDOW_YM,
+    WINDOW_YM_WRAP,
+    WINDOW_YP,
+    WINDOW_YP_WRAP,
+    WINDOW_ZM,
+    WINDOW_ZM_WRAP,
+    WINDOW_ZP,
+    WINDOW_ZP_WRAP,
+    NUM_WINDOWS
+};
+
+// Bits j of a word for which (phase + j) mod period lies in [lo, hi), where phase is the
+// flat index of the word's first cell modulo period. Periods up to 64 come with a table
+// indexed by phase, longer periods are computed on the fly.
+struct PeriodicMaskTable
+{
+    size_t period, lo, hi, step;
+    const uint64_t *table;
+};
+
+// Neighbour pairs a specialised kernel reads. The x pair is always read; the y and z pairs are
+// skipped when the rule mode ignores them (ECA) or when their axis has length 1.
+enum KernelShape
+{
+    KERNEL_X,
+    KERNEL_XY,
+    KERNEL_XZ,
+    KERNEL_XYZ
+};
+
+// Everything a backend needs to compute a range of output words. Built once per step.
+struct StepContext
+{
+    const uint64_t *in;
+    uint64_t *out;
+    size_t num_cells;
+    size_t num_words;
+    KernelShape shape;
+    size_t offsets[NUM_WINDOWS];
+    PeriodicMaskTable y_first, y_last, z_first, z_last;
+    // Leaves of the multiplexer tree over the shape's reduced rule index: the value (0 or ~0)
+    // of the reduced rule for index 2k and 2k+1.
+    uint64_t leaf_clear[64];
+    uint64_t leaf_set[64];
+};
+
+using StepWordsFn = void (*)(const StepContext &ctx, size_t word_begin, size_t word_end);
+
+// Backend entry points. The SIMD ones return nullptr when the backend wasn't compiled in.
+StepWordsFn ScalarStepWords();
+StepWordsFn Avx2StepWords();
+StepWordsFn Avx512StepWords();
+StepWordsFn NeonStepWords();
+} // namespace step_kernel_detail
+
+namespace
+{
+using namespace step_kernel_detail;
+
+// Bits [a, b) of a word, 0 <= a <= b <= 64.
+inline uint64_t RangeBits(size_t a, size_t b)
+{
+    if (a >= b)
+        return 0;
+    const uint64_t upper = b == kWordBits ? ~0ULL : ((1ULL << b) - 1);
+    return upper & ~((1ULL << a) - 1);
+}
+
+inline size_t Clamp(size_t value, size_t lo, size_t hi)
+{
+    return value < lo ? lo : (value > hi ? hi : value);
+}
+
+inline uint64_t ComputePeriodicMask(size_t period, size_t lo, size_t hi, size_t phase)
+{
+    uint64_t mask = 0;
+    // Every repetition of the period contributes the run [base + lo, base + hi), relative to the word start.
+    for (size_t base = 0; base < phase + kWordBits; base += period)
+    {
+        const size_t a = Clamp(base + lo, phase, phase + kWordBits) - phase;
+        const size_t b = Clamp(base + hi, phase, phase + kWordBits) - phase;
+        mask |= RangeBits(a, b);
+    }
+    return mask;
+}
+
+inline uint64_t MaskAt(const PeriodicMaskTable &mask, size_t phase)
+{
+    return mask.table ? mask.table[phase] : ComputePeriodicMask(mask.period, mask.lo, mask.hi, phase);
+}
+
+inline size_t AdvancePhase(const PeriodicMaskTable &mask, size_t phase)
+{
+    phase += mask.step;
+    return phase >= mask.period ? phase - mask.period : phase;
+}
+
+// 64 cells starting at flat index p, wrapping around the end of the grid.
+// Requires num_cells >= 64, so a window wraps at most once.
+inline uint64_t Window(const StepContext &ctx, size_t p)
+{
+    const size_t word = p / kWordBits;
+    const size_t shift = p % kWordBits;
+    uint64_t value = ctx.in[word] >> shift;
+    if (shift != 0 && word + 1 < ctx.num_words)
+        value |= ctx.in[word + 1] << (kWordBits - shift);
+
+    const size_t available = ctx.num_cells - p;
+    if (available < kWordBits)
+        value = (value & ((1ULL << available) - 1)) | (ctx.in[0] << available);
+    return value;
+}
+
+// One machine word as a single-lane vector, used by the scalar backend and for the
+// words a SIMD backend can't load as a full vector.
+struct ScalarVec
+{
+    static constexpr size_t kLanes = 1;
+    uint64_t v;
+
+    static ScalarVec Load(const uint64_t *p) { return {*p}; }
+    static void Store(uint64_t *p, ScalarVec a) { *p = a.v; }
+    static ScalarVec Broadcast(uint64_t x) { return {x}; }
+    static ScalarVec And(ScalarVec a, ScalarVec b) { return {a.v & b.v}; }
+    static ScalarVec AndNot(ScalarVec a, ScalarVec b) { return {~a.v & b.v}; }
+    static ScalarVec Or(ScalarVec a, ScalarVec b) { return {a.v | b.v}; }
+    static ScalarVec Xor(ScalarVec a, ScalarVec b) { return {a.v ^ b.v}; }
+    static ScalarVec ShiftRight(ScalarVec a, size_t n) { return {a.v >> n}; }
+    static ScalarVec ShiftLeft(ScalarVec a, size_t n) { return {a.v << n}; }
+};
+
+// Takes the bits of `wrapped` where `mask` is set and the bits of `value` elsewhere.
+template <class V>
+inline V Blend(V value, V wrapped, V mask)
+{
+    return V::Xor(value, V::And(V::Xor(value, wrapped), mask));
+}
+
+// V::kLanes consecutive windows starting at flat index p. The caller guarantees that none of them wraps.
+template <class V>
+inline V LoadWindow(const StepContext &ctx, size_t p)
+{
+    const size_t word = p / kWordBits;
+    const size_t shift = p % kWordBits;
+    const V lo = V::Load(ctx.in + word);
+    if (shift == 0)
+        return lo;
+    return V::Or(V::ShiftRight(lo, shift), V::ShiftLeft(V::Load(ctx.in + word + 1), kWordBits - shift));
+}
+
+/**
+ * Evaluates the rule for every cell of the input words as a tree of multiplexers over kVars
+ * input words. inputs[k] holds bit k of every cell's (reduced) rule index; the leaves of the
+ * tree are ctx.leaf_clear/leaf_set, i.e. the rule bits for index 2k and 2k+1.
+ */
+template <class V, size_t kVars>
+inline V EvaluateRule(const StepContext &ctx, const V inputs[kVars])
+{
+    constexpr size_t kLeaves = size_t(1) << (kVars - 1);
+    V level[kLeaves];
+    const V selector = inputs[0];
+    for (size_t k = 0; k < kLeaves; ++k)
+    {
+        level[k] = V::Or(V::AndNot(selector, V::Broadcast(ctx.leaf_clear[k])),
+                         V::And(selector, V::Broadcast(ctx.leaf_set[k])));
+    }
+    for (size_t var = 1, width = kLeaves / 2; var < kVars; ++var, width /= 2)
+    {
+        for (size_t k = 0; k < width; ++k)
+            level[k] = Blend(level[2 * k], level[2 * k + 1], inputs[var]);
+    }
+    return level[0];
+}
+
+// Which neighbour pairs a kernel reads. Pairs that aren't read are either ignored by the
+// rule mode (ECA) or equal to the central cell (an axis of length 1 wraps onto itself);
+// PrepareStep folds them into the rule table instead.
+template <KernelShape kShape>
+struct ShapeTraits
+{
+    static constexpr bool kUsesY = kShape == KERNEL_XY || kShape == KERNEL_XYZ;
+    static constexpr bool kUsesZ = kShape == KERNEL_XZ || kShape == KERNEL_XYZ;
+    // Reduced rule index, least significant first: [z+, z-,] [y+, y-,] x+, x-, central bit
+    static constexpr size_t kVars = 3 + (kUsesY ? 2 : 0) + (kUsesZ ? 2 : 0);
+
+    static constexpr bool UsesWindow(size_t index)
+    {
+        return index <= WINDOW_XP || (kUsesY && index <= WINDOW_YP_WRAP) ||
+               (kUsesZ && index >= WINDOW_ZM);
+    }
+};
+
+/**
+ * Builds the kernel's input words from the central word(s). window(index) returns the words at
+ * a WindowIndex offset, mask(k) the y-first, y-last, z-first and z-last masks for k = 0..3.
+ */
+template <class V, KernelShape kShape, class WindowFn, class MaskFn>
+inline void GatherInputs(V center, WindowFn window, MaskFn mask, V inputs[ShapeTraits<kShape>::kVars])
+{
+    using Traits = ShapeTraits<kShape>;
+    size_t next = 0;
+    if constexpr (Traits::kUsesZ)
+    {
+        inputs[next++] = Blend(window(WINDOW_ZP), window(WINDOW_ZP_WRAP), mask(3));
+        inputs[next++] = Blend(window(WINDOW_ZM), window(WINDOW_ZM_WRAP), mask(2));
+    }
+    if constexpr (Traits::kUsesY)
+    {
+        inputs[next++] = Blend(window(WINDOW_YP), window(WINDOW_YP_WRAP), mask(1));
+        inputs[next++] = Blend(window(WINDOW_YM), window(WINDOW_YM_WRAP), mask(0));
+    }
+    inputs[next++] = window(WINDOW_XP);
+    inputs[next++] = window(WINDOW_XM);
+    inputs[next] = center;
+}
+
+// Computes one output word, handling the wrap around the end of the grid.
+template <KernelShape kShape>
+inline void StepSingleWord(const StepContext &ctx, size_t w, size_t y_phase, size_t z_phase)
+{
+    const size_t cell = w * kWordBits;
+    auto window = [&](WindowIndex index)
+    {
+        size_t p = cell + ctx.offsets[index];
+        if (p >= ctx.num_cells)
+            p -= ctx.num_cells;
+        return ScalarVec{Window(ctx, p)};
+    };
+    auto mask = [&](size_t k)
+    {
+        const PeriodicMaskTable *masks[4] = {&ctx.y_first, &ctx.y_last, &ctx.z_first, &ctx.z_last};
+        return ScalarVec{MaskAt(*masks[k], k < 2 ? y_phase : z_phase)};
+    };
+
+    ScalarVec inputs[ShapeTraits<kShape>::kVars];
+    GatherInputs<ScalarVec, kShape>(ScalarVec{ctx.in[w]}, window, mask, inputs);
+
+    uint64_t result = EvaluateRule<ScalarVec, ShapeTraits<kShape>::kVars>(ctx, inputs).v;
+    if (cell + kWordBits > ctx.num_cells)
+        result &= (1ULL << (ctx.num_cells - cell)) - 1; // keep the padding bits of the last word zero
+    ctx.out[w] = result;
+}
+
+/**
+ * Computes output words [word_begin, word_end) V::kLanes at a time. Groups whose windows
+ * would wrap around the end of the grid, or that contain the partial last word, are
+ * computed word by word.
+ */
+template <class V, KernelShape kShape>
+void StepWordsShaped(const StepContext &ctx, size_t word_begin, size_t word_end)
+{
+    using Traits = ShapeTraits<kShape>;
+    constexpr size_t kLanes = V::kLanes;
+    size_t y_phase = Traits::kUsesY ? (word_begin * kWordBits) % ctx.y_first.period : 0;
+    size_t z_phase = Traits::kUsesZ ? (word_begin * kWordBits) % ctx.z_first.period : 0;
+    auto advance_phases = [&]
+    {
+        if constexpr (Traits::kUsesY)
+            y_phase = AdvancePhase(ctx.y_first, y_phase);
+        if constexpr (Traits::kUsesZ)
+            z_phase = AdvancePhase(ctx.z_first, z_phase);
+    };
+
+    size_t w = word_begin;
+    while (w < word_end)
+    {
+        const size_t cell = w * kWordBits;
+        size_t positions[NUM_WINDOWS] = {};
+        bool whole_group = w + kLanes <= word_end && cell + kLanes * kWordBits <= ctx.num_cells;
+        for (size_t i = 0; i < NUM_WINDOWS; ++i)
+        {
+            if (!Traits::UsesWindow(i))
+                continue;
+            size_t p = cell + ctx.offsets[i];
+            if (p >= ctx.num_cells)
+                p -= ctx.num_cells;
+            positions[i] = p;
+            whole_group = whole_group && p + kLanes * kWordBits <= ctx.num_cells &&
+                          p / kWordBits + kLanes < ctx.num_words;
+        }
+
+        if (!whole_group)
+        {
+            StepSingleWord<kShape>(ctx, w, y_phase, z_phase);
+            advance_phases();
+            ++w;
+            continue;
+        }
+
+        alignas(64) uint64_t masks[4][kLanes];
+        if constexpr (Traits::kUsesY || Traits::kUsesZ)
+        {
+            for (size_t lane = 0; lane < kLanes; ++lane)
+            {
+                if constexpr (Traits::kUsesY)
+                {
+                    masks[0][lane] = MaskAt(ctx.y_first, y_phase);
+                    masks[1][lane] = MaskAt(ctx.y_last, y_phase);
+                }
+                if constexpr (Traits::kUsesZ)
+                {
+                    masks[2][lane] = MaskAt(ctx.z_first, z_phase);
+                    masks[3][lane] = MaskAt(ctx.z_last, z_phase);
+                }
+                advance_phases();
+            }
+        }
+
+        V inputs[Traits::kVars];
+        GatherInputs<V, kShape>(
+            V::Load(ctx.in + w),
+            [&](WindowIndex index)
+            { return LoadWindow<V>(ctx, positions[index]); },
+            [&](size_t k)
+            { return V::Load(masks[k]); },
+            inputs);
+        V::Store(ctx.out + w, EvaluateRule<V, Traits::kVars>(ctx, inputs));
+        w += kLanes;
+    }
+}
+
+// Entry point of every backend: picks the kernel for the grid's shape once per call.
+template <class V>
+void StepWordsGeneric(const StepContext &ctx, size_t word_begin, size_t word_end)
+{
+    switch (ctx.shape)
+    {
+    case KERNEL_X:
+        StepWordsShaped<V, KERNEL_X>(ctx, word_begin, word_end);
+        break;
+    case KERNEL_XY:
+        StepWordsShaped<V, KERNEL_XY>(ctx, word_begin, word_end);
+        break;
+    case KERNEL_XZ:
+        StepWordsShaped<V, KERNEL_XZ>(ctx, word_begin, word_end);
+        break;
+    case KERNEL_XYZ:
+        StepWordsShaped<V, KERNEL_XYZ>(ctx, word_begin, word_end);
+        break;
+    }
+}
+} // namespace
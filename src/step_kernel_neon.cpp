@@ -0,0 +1,36 @@
+#include "step_kernel_impl.hpp"
+
+// NEON is always available on AArch64, so no extra compiler flags are needed.
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+
+namespace
+{
+struct NeonVec
+{
+    static constexpr size_t kLanes = 2;
+    uint64x2_t v;
+
+    static NeonVec Load(const uint64_t *p) { return {vld1q_u64(p)}; }
+    static void Store(uint64_t *p, NeonVec a) { vst1q_u64(p, a.v); }
+    static NeonVec Broadcast(uint64_t x) { return {vdupq_n_u64(x)}; }
+    static NeonVec And(NeonVec a, NeonVec b) { return {vandq_u64(a.v, b.v)}; }
+    static NeonVec AndNot(NeonVec a, NeonVec b) { return {vbicq_u64(b.v, a.v)}; }
+    static NeonVec Or(NeonVec a, NeonVec b) { return {vorrq_u64(a.v, b.v)}; }
+    static NeonVec Xor(NeonVec a, NeonVec b) { return {veorq_u64(a.v, b.v)}; }
+    // vshlq shifts left by a signed per-lane count; negative counts shift right
+    static NeonVec ShiftRight(NeonVec a, size_t n) { return {vshlq_u64(a.v, vdupq_n_s64(-static_cast<int64_t>(n)))}; }
+    static NeonVec ShiftLeft(NeonVec a, size_t n) { return {vshlq_u64(a.v, vdupq_n_s64(static_cast<int64_t>(n)))}; }
+};
+} // namespace
+
+step_kernel_detail::StepWordsFn step_kernel_detail::NeonStepWords()
+{
+    return &StepWordsGeneric<NeonVec>;
+}
+#else
+step_kernel_detail::StepWordsFn step_kernel_detail::NeonStepWords()
+{
+    return nullptr;
+}
+#endif
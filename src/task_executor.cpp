@@ -0,0 +1,54 @@
+#include "task_executor.hpp"
+
+#include <algorithm>
+
+TaskExecutor::TaskExecutor(size_t num_threads)
+{
+    num_threads = std::max<size_t>(num_threads, 1);
+    for (size_t i = 0; i < num_threads; ++i)
+        workers.emplace_back([this]
+                             { WorkerLoop(); });
+}
+
+TaskExecutor::~TaskExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_cv.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void TaskExecutor::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    task_cv.notify_one();
+}
+
+size_t TaskExecutor::num_threads() const
+{
+    return workers.size();
+}
+
+void TaskExecutor::WorkerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_cv.wait(lock, [this]
+                         { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return; // stopping and drained
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
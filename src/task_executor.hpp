@@ -0,0 +1,34 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads running submitted tasks in FIFO order.
+ * Used by the async server to keep stepping off the gRPC I/O threads.
+ */
+class TaskExecutor
+{
+public:
+    explicit TaskExecutor(size_t num_threads);
+    // Runs the tasks still queued, then joins the threads.
+    ~TaskExecutor();
+    TaskExecutor(const TaskExecutor &) = delete;
+    TaskExecutor &operator=(const TaskExecutor &) = delete;
+
+    void Submit(std::function<void()> task);
+    size_t num_threads() const;
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable task_cv;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+};
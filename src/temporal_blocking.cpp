@@ -0,0 +1,133 @@
+#include "temporal_blocking.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include "step_kernel.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+// Slabs per word boundary: a tile starting at a multiple of this many slabs starts on a new word
+size_t SlabAlignment(size_t slab_bits)
+{
+    return 64 / std::gcd(slab_bits, size_t(64));
+}
+
+// The two window grids of one thread, kept across tiles and passes
+struct TileWindows
+{
+    BitPackedGrid3D window{0, 0, 0};
+    BitPackedGrid3D stepped{0, 0, 0};
+
+    void Prepare(size_t slabs, size_t y_max, size_t z_max)
+    {
+        if (window.x_max == slabs && window.y_max == y_max && window.z_max == z_max)
+            return;
+        window = BitPackedGrid3D(slabs, y_max, z_max);
+        stepped = BitPackedGrid3D(slabs, y_max, z_max);
+    }
+};
+
+// Steps slabs [x0, x0 + slabs) of `current` k times into the same slabs of `next`
+void StepTile(const BitPackedGrid3D &current, BitPackedGrid3D &next, const Bitset128 &rule, RuleMode rule_mode,
+              size_t x0, size_t slabs, uint64_t k, TileWindows &windows)
+{
+    const size_t x_max = current.x_max;
+    const size_t slab_bits = current.y_max * current.z_max;
+    const size_t window_slabs = slabs + 2 * k;
+    // Slabs x0 - k .. x0 + slabs + k - 1, wrapping around x, several times over if k >= x_max. Window
+    // slabs past window_slabs keep stale data from a longer tile; only discarded outputs depend on it.
+    for (size_t i = 0; i < window_slabs;)
+    {
+        const size_t slab = (x0 + i + x_max - k % x_max) % x_max;
+        const size_t run = std::min(window_slabs - i, x_max - slab);
+        CopyBits(current.raw().data(), slab * slab_bits, windows.window.raw().data(), i * slab_bits, run * slab_bits);
+        i += run;
+    }
+    // Step s only needs slabs [s, window_slabs - s) for the tile to come out right, so the computed
+    // range shrinks by a slab at either end per step
+    for (uint64_t step = 1; step <= k; ++step)
+    {
+        const size_t word_begin = step * slab_bits / 64;
+        const size_t word_end = std::min(windows.window.raw().size(), ((window_slabs - step) * slab_bits + 63) / 64);
+        StepWords(windows.window, windows.stepped, rule, rule_mode, word_begin, word_end);
+        std::swap(windows.window, windows.stepped);
+    }
+    CopyBits(windows.window.raw().data(), k * slab_bits, next.raw().data(), x0 * slab_bits, slabs * slab_bits);
+}
+} // namespace
+
+TemporalBlockingPlan PlanTemporalBlocking(const BitPackedGrid3D &grid, uint64_t num_steps, size_t window_bytes)
+{
+    TemporalBlockingPlan plan;
+    const size_t slab_bits = grid.y_max * grid.z_max;
+    if (grid.layout() != GRID_LAYOUT_ROW_MAJOR || num_steps < 2 || slab_bits == 0)
+        return plan;
+    // Both buffers of the whole grid stay in cache anyway
+    if (2 * grid.raw().size() * sizeof(uint64_t) <= window_bytes)
+        return plan;
+
+    const size_t window_slabs = window_bytes / 2 * 8 / slab_bits;
+    const size_t align = SlabAlignment(slab_bits);
+    // A halo of an eighth of the window on either side. The computed range shrinks towards the tile step by
+    // step, so a pass costs at most 7/6 of plain steps in computation.
+    uint64_t k = std::min<uint64_t>(num_steps, window_slabs / 8);
+    size_t tile_slabs = (window_slabs - std::min<size_t>(window_slabs, 2 * k)) / align * align;
+    if (tile_slabs == 0 && window_slabs > align)
+    {
+        tile_slabs = align;
+        k = std::min<uint64_t>(num_steps, (window_slabs - align) / 2);
+    }
+    if (k < 2 || tile_slabs == 0)
+        return plan;
+
+    plan.steps_per_pass = k;
+    plan.tile_slabs = std::min(tile_slabs, (grid.x_max + align - 1) / align * align);
+    return plan;
+}
+
+void StepGridBlocked(BitPackedGrid3D &grid, BitPackedGrid3D &scratch, const Bitset128 &rule, RuleMode rule_mode,
+                     uint64_t num_steps, const TemporalBlockingPlan &plan)
+{
+    StepGridBlocked(grid, scratch, rule, rule_mode, num_steps, plan, ThreadPool::Shared());
+}
+
+void StepGridBlocked(BitPackedGrid3D &grid, BitPackedGrid3D &scratch, const Bitset128 &rule, RuleMode rule_mode,
+                     uint64_t num_steps, const TemporalBlockingPlan &plan, ThreadPool &pool)
+{
+    if (scratch.x_max != grid.x_max || scratch.y_max != grid.y_max || scratch.z_max != grid.z_max ||
+        scratch.layout() != grid.layout())
+        scratch = BitPackedGrid3D(grid.x_max, grid.y_max, grid.z_max, grid.layout());
+
+    const size_t slab_bits = grid.y_max * grid.z_max;
+    if (plan.steps_per_pass < 2 || plan.tile_slabs == 0 || grid.layout() != GRID_LAYOUT_ROW_MAJOR || slab_bits == 0)
+    {
+        for (uint64_t step = 0; step < num_steps; ++step)
+        {
+            StepGrid(grid, scratch, rule, rule_mode, pool);
+            std::swap(grid, scratch);
+        }
+        return;
+    }
+
+    // Tiles on word boundaries, so the threads never write to the same word
+    const size_t align = SlabAlignment(slab_bits);
+    const size_t tile_slabs = (plan.tile_slabs + align - 1) / align * align;
+    const size_t num_tiles = (grid.x_max + tile_slabs - 1) / tile_slabs;
+    while (num_steps > 0)
+    {
+        const uint64_t k = std::min(plan.steps_per_pass, num_steps);
+        pool.ParallelFor(0, num_tiles, 1, [&](size_t begin, size_t end)
+                         {
+            thread_local TileWindows windows;
+            windows.Prepare(tile_slabs + 2 * k, grid.y_max, grid.z_max);
+            for (size_t tile = begin; tile < end; ++tile)
+            {
+                const size_t x0 = tile * tile_slabs;
+                StepTile(grid, scratch, rule, rule_mode, x0, std::min(tile_slabs, grid.x_max - x0), k, windows);
+            } });
+        std::swap(grid, scratch);
+        num_steps -= k;
+    }
+}
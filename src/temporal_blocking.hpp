@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+
+class ThreadPool;
+
+/**
+ * Temporal blocking: advancing a grid several steps per pass over memory.
+ *
+ * A plain step streams the whole grid through the caches once per step, so grids larger than the
+ * cache are bound by memory bandwidth. Here the grid is cut into tiles of whole x-slabs; each tile
+ * is copied into a window together with k halo slabs on either side, the window is stepped k times
+ * while it stays in cache, and only the tile's own slabs are written back. The window wraps around
+ * x at its own edges, so its outer slabs go wrong, but a wrong cell only spreads one slab per step
+ * and the tile in the middle never sees one. y and z are whole in every slab and wrap exactly as in
+ * the full grid, so the result is bit-identical to k plain steps, in both rule modes.
+ *
+ * The halos are computed twice, once by each neighbouring tile: that is the price for reading
+ * the grid once per k steps instead of once per step.
+ */
+struct TemporalBlockingPlan
+{
+    // Steps per pass (k). 1 means blocking doesn't pay and the grid is stepped one step at a time.
+    uint64_t steps_per_pass = 1;
+    // x-slabs written back per tile. The tiles start on word boundaries, so they never share a word.
+    size_t tile_slabs = 0;
+};
+
+// Cache budget of the two window grids a tile is stepped in, e.g. a core's share of L2
+constexpr size_t kDefaultTemporalBlockingBytes = size_t(1) << 20;
+
+// Picks k and the tile size for advancing `grid` num_steps steps with windows of at most
+// window_bytes together. Blocking is off for brick layouts (they have no contiguous x-slabs),
+// for grids that fit the budget anyway and for slabs too large to leave room for a halo.
+TemporalBlockingPlan PlanTemporalBlocking(const BitPackedGrid3D &grid, uint64_t num_steps,
+                                          size_t window_bytes = kDefaultTemporalBlockingBytes);
+
+// Advances `grid` num_steps steps in passes of plan.steps_per_pass steps (the last pass takes the
+// remainder), using `scratch` as the second buffer; it is reallocated if its shape differs. Tiles
+// are stepped on the pool (ThreadPool::Shared() by default).
+void StepGridBlocked(BitPackedGrid3D &grid, BitPackedGrid3D &scratch, const Bitset128 &rule, RuleMode rule_mode,
+                     uint64_t num_steps, const TemporalBlockingPlan &plan);
+void StepGridBlocked(BitPackedGrid3D &grid, BitPackedGrid3D &scratch, const Bitset128 &rule, RuleMode rule_mode,
+                     uint64_t num_steps, const TemporalBlockingPlan &plan, ThreadPool &pool);
@@ -0,0 +1,165 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+// Set while a thread executes chunks of a ParallelFor, so nested loops run inline instead of deadlocking.
+thread_local bool tls_in_parallel_for = false;
+
+uint64_t PackRun(uint64_t first, uint64_t last)
+{
+    return (first << 32) | last;
+}
+} // namespace
+
+ThreadPool::ThreadPool(size_t num_threads)
+{
+    num_threads = std::max<size_t>(num_threads, 1);
+    for (size_t slot = 1; slot < num_threads; ++slot)
+        workers.emplace_back([this, slot]
+                             { WorkerLoop(slot); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake_cv.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+size_t ThreadPool::num_threads() const
+{
+    return workers.size() + 1;
+}
+
+ThreadPool &ThreadPool::Shared()
+{
+    static ThreadPool pool([]
+                           {
+        const char *configured = std::getenv("CA_STEP_THREADS");
+        if (configured != nullptr && std::atoi(configured) > 0)
+            return static_cast<size_t>(std::atoi(configured));
+        return static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())); }());
+    return pool;
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, const RangeFn &fn)
+{
+    if (begin >= end)
+        return;
+    // Chunk indices are packed into 32 bits per run
+    grain = std::max<size_t>({grain, 1, (end - begin) >> 31});
+    const size_t num_chunks = (end - begin + grain - 1) / grain;
+    if (workers.empty() || num_chunks == 1 || tls_in_parallel_for)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(submit_mutex);
+
+    Job local;
+    local.fn = &fn;
+    local.begin = begin;
+    local.end = end;
+    local.grain = grain;
+    local.num_slots = num_threads();
+    local.slots = std::make_unique<std::atomic<uint64_t>[]>(local.num_slots);
+    for (size_t slot = 0; slot < local.num_slots; ++slot)
+    {
+        const uint64_t first = num_chunks * slot / local.num_slots;
+        const uint64_t last = num_chunks * (slot + 1) / local.num_slots;
+        local.slots[slot].store(PackRun(first, last), std::memory_order_relaxed);
+    }
+    local.remaining.store(num_chunks, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &local;
+        ++generation;
+    }
+    wake_cv.notify_all();
+
+    RunJob(local, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&]
+                 { return local.remaining.load(std::memory_order_acquire) == 0 && local.participants == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(size_t slot)
+{
+    uint64_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake_cv.wait(lock, [&]
+                     { return stopping || (job != nullptr && generation != seen_generation); });
+        if (stopping)
+            return;
+
+        seen_generation = generation;
+        Job *current = job;
+        ++current->participants;
+        lock.unlock();
+
+        RunJob(*current, slot);
+
+        lock.lock();
+        if (--current->participants == 0)
+            done_cv.notify_all();
+    }
+}
+
+void ThreadPool::RunJob(Job &job, size_t slot)
+{
+    tls_in_parallel_for = true;
+    size_t chunk;
+    size_t completed = 0;
+    // Drain our own run from the front, then steal from the back of the others'
+    for (size_t offset = 0; offset < job.num_slots; ++offset)
+    {
+        const size_t victim = (slot + offset) % job.num_slots;
+        while (ClaimChunk(job, victim, offset != 0, chunk))
+        {
+            const size_t chunk_begin = job.begin + chunk * job.grain;
+            (*job.fn)(chunk_begin, std::min(job.end, chunk_begin + job.grain));
+            ++completed;
+        }
+    }
+    tls_in_parallel_for = false;
+
+    if (completed > 0 && job.remaining.fetch_sub(completed, std::memory_order_acq_rel) == completed)
+    {
+        // Last chunk done: wake the caller. Taking the mutex orders this with its predicate check.
+        std::lock_guard<std::mutex> lock(mutex);
+        done_cv.notify_all();
+    }
+}
+
+bool ThreadPool::ClaimChunk(Job &job, size_t slot, bool steal, size_t &chunk)
+{
+    std::atomic<uint64_t> &run = job.slots[slot];
+    uint64_t packed = run.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        const uint64_t first = packed >> 32;
+        const uint64_t last = packed & 0xffffffffULL;
+        if (first >= last)
+            return false;
+
+        const uint64_t claimed = steal ? PackRun(first, last - 1) : PackRun(first + 1, last);
+        if (run.compare_exchange_weak(packed, claimed, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            chunk = steal ? last - 1 : first;
+            return true;
+        }
+    }
+}
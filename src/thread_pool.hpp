@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent pool of worker threads for data-parallel loops.
+ *
+ * ParallelFor splits an index range into chunks, hands every participant (the workers plus
+ * the calling thread) a contiguous run of chunks and lets participants that run out steal
+ * chunks from the back of the others' runs. Claiming a chunk is a single CAS on the owner's
+ * packed [begin, end) slot; the loop body itself runs without any synchronisation.
+ */
+class ThreadPool
+{
+public:
+    using RangeFn = std::function<void(size_t begin, size_t end)>;
+
+    // num_threads counts the calling thread, so num_threads - 1 workers are started.
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t num_threads() const;
+
+    // Calls fn on consecutive sub-ranges of [begin, end) of at most `grain` indices and blocks until
+    // all of them are done. Runs inline when called from inside another ParallelFor.
+    void ParallelFor(size_t begin, size_t end, size_t grain, const RangeFn &fn);
+
+    // Process-wide pool, sized by CA_STEP_THREADS or the number of hardware threads.
+    static ThreadPool &Shared();
+
+private:
+    struct Job
+    {
+        const RangeFn *fn;
+        size_t begin, end, grain;
+        // One packed [first chunk, end chunk) run per participant
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        size_t num_slots;
+        std::atomic<size_t> remaining;
+        size_t participants = 0; // guarded by ThreadPool::mutex
+    };
+
+    void WorkerLoop(size_t slot);
+    void RunJob(Job &job, size_t slot);
+    bool ClaimChunk(Job &job, size_t slot, bool steal, size_t &chunk);
+
+    std::vector<std::thread> workers;
+    std::mutex submit_mutex; // one ParallelFor at a time
+    std::mutex mutex;
+    std::condition_variable wake_cv;
+    std::condition_variable done_cv;
+    Job *job = nullptr;
+    uint64_t generation = 0;
+    bool stopping = false;
+};
@@ -1,8 +1,10 @@
 #include "world_state.hpp"
 #include "random_bitset.hpp"
+#include "random_fill.hpp"
+#include "step_kernel.hpp"
 #include <sstream>
 
-WorldStateContainer::WorldStateContainer() : next_world_state_id(0), world_states() {}
+WorldStateContainer::WorldStateContainer() : next_world_state_id(0) {}
 
 /**
  * Function to generate the initial world state based on Wolfram's rule-naming scheme
@@ -10,9 +12,8 @@ WorldStateContainer::WorldStateContainer() : next_world_state_id(0), world_state
  * - For a 1D grid with 3 neighbors (including itself), there are 2^3=8 neighborhood states.
  *   Having two states {0,1} means there are 2^8 possible rules
  */
-tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> WorldStateContainer::InitWorldState1D(size_t x_max, size_t y_max, size_t z_max)
+tl::expected<BitPackedGrid3D, std::string> MakeCenterCellGrid(size_t x_max, size_t y_max, size_t z_max)
 {
-    rule_mode = RuleMode::RULE_1D_ECA;
     // By convention the x-axis is used to determine where to place the "central dot"
     const size_t central_dot_idx = x_max / 2;
     if (central_dot_idx < 2 || y_max < 1 || z_max < 1)
@@ -29,14 +30,21 @@ tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> WorldStateConta
     size_t cz = z_max / 2;
 
     world_state.set(cx, cy, cz, true);
+    return world_state;
+}
+
+tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> WorldStateContainer::InitWorldState1D(size_t x_max, size_t y_max, size_t z_max)
+{
+    auto world_state = MakeCenterCellGrid(x_max, y_max, z_max);
+    if (!world_state)
+        return tl::unexpected(world_state.error());
     uint64_t world_state_id = next_world_state_id++;
     return tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string>{
-        std::make_tuple(world_state_id, std::move(world_state))};
+        std::make_tuple(world_state_id, std::move(*world_state))};
 }
 
 tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> WorldStateContainer::InitWorldState3D(size_t x_max, size_t y_max, size_t z_max)
 {
-    rule_mode = RuleMode::RULE_3D;
     if (x_max / 2 < 2 || y_max / 2 < 2 || z_max / 2 < 2)
     {
         std::ostringstream oss;
@@ -58,63 +66,41 @@ tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> WorldStateConta
 /**
  * Function to generate the initial world state with random values (0 or 1)
  */
-tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> WorldStateContainer::InitWorldStateRandom(size_t x_max, size_t y_max, size_t z_max)
+tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> WorldStateContainer::InitWorldStateRandom(size_t x_max, size_t y_max, size_t z_max,
+                                                                                                       uint64_t seed, double density)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<uint8_t> dist(0, 1);
-
-    BitPackedGrid3D world_state(x_max, y_max, z_max);
-
-    for (size_t i = 0; i < x_max * y_max * z_max; ++i)
+    if (x_max < 1 || y_max < 1 || z_max < 1)
     {
-        world_state.set(i, dist(gen));
+        std::ostringstream oss;
+        oss << "Invalid dimensions: x=" << x_max << ", y=" << y_max << ", z=" << z_max;
+        return tl::unexpected(oss.str());
     }
+    // Also rejects NaN
+    if (!(density >= 0.0 && density <= 1.0))
+    {
+        std::ostringstream oss;
+        oss << "Invalid density: " << density << ", expected a value in [0, 1]";
+        return tl::unexpected(oss.str());
+    }
+
+    BitPackedGrid3D world_state(x_max, y_max, z_max);
+    FillRandom(world_state, seed, density);
     uint64_t world_state_id = next_world_state_id++;
     return tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string>{
         std::make_tuple(world_state_id, std::move(world_state))};
 }
 
 // Function to update the world state based on the current state and rule map
-// The grid is toroidal(wraps around in all directions)
+// The grid is toroidal(wraps around in all directions). See step_kernel.hpp for the word-parallel kernel.
 BitPackedGrid3D WorldStateContainer::UpdateWorldState(
     const BitPackedGrid3D &current_world_state,
-    const Bitset128 &rule)
+    const Bitset128 &rule,
+    RuleMode rule_mode)
 {
-    // Create a new grid for the next state. This is a deep copy of the current world state.
-    BitPackedGrid3D next_world_state = current_world_state;
-    const size_t x_max = current_world_state.x_max;
-    const size_t y_max = current_world_state.y_max;
-    const size_t z_max = current_world_state.z_max;
-
-    // Iterate over all cells including boundaries
-    for (size_t i = 0; i < x_max * y_max * z_max; ++i)
-    {
-        auto [x, y, z] = current_world_state.unpack_bit_index(i);
-        uint8_t central_bit = current_world_state.get(i);
-        // Get the neighbors, handling boundary conditions with modulo
-        // (x + x_max - 1) % x_max safely wraps around to x_max - 1 when x == 0
-        // Below, two binary neighbor values are packed into a 2-bit value, like this:
-        // uint8_t pair = (left << 1) | right;
-        uint8_t x_neighbors = (current_world_state.get((x + x_max - 1) % x_max, y, z) << 1) |
-                              current_world_state.get((x + 1) % x_max, y, z);
-        uint8_t y_neighbors = (current_world_state.get(x, (y + y_max - 1) % y_max, z) << 1) |
-                              current_world_state.get(x, (y + 1) % y_max, z);
-        uint8_t z_neighbors = (current_world_state.get(x, y, (z + z_max - 1) % z_max) << 1) |
-                              current_world_state.get(x, y, (z + 1) % z_max);
-
-        if (rule_mode == RULE_1D_ECA)
-        {
-            y_neighbors = 0;
-            z_neighbors = 0;
-        }
-
-        bool cell_lives = does_cell_live(rule, central_bit, x_neighbors, y_neighbors, z_neighbors);
-
-        // Apply the rule: update the cell state in the next_world_state based on the central bit
-        next_world_state.set(i, cell_lives);
-    }
-
+    // Every output word is written by the kernel, so the next state doesn't need to start as a copy.
+    BitPackedGrid3D next_world_state(current_world_state.x_max, current_world_state.y_max, current_world_state.z_max,
+                                     current_world_state.layout());
+    StepGrid(current_world_state, next_world_state, rule, rule_mode);
     return next_world_state;
 }
 
@@ -1,25 +1,30 @@
+#pragma once
+#include <atomic>
 #include <iostream>
 #include <random>
-#include <map>
 #include <tuple>
 #include <tl/expected.hpp>
 #include "bit_packed_grid_3d.hpp"
 #include "random_bitset.hpp"
 
+// The initial world state of InitWorldState1D, a single live cell in the middle, without allocating an id for it
+tl::expected<BitPackedGrid3D, std::string> MakeCenterCellGrid(size_t x_max, size_t y_max, size_t z_max);
+
 class WorldStateContainer
 {
 public:
-    uint64_t next_world_state_id;
-    std::map<uint64_t, BitPackedGrid3D> world_states;
-    RuleMode rule_mode;
+    // Shared by concurrent handlers, so ids are allocated atomically. The states themselves live in a WorldStateStore.
+    std::atomic<uint64_t> next_world_state_id;
 
     WorldStateContainer();
     tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> InitWorldState1D(size_t x_max, size_t y_max, size_t z_max);
     tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> InitWorldState3D(size_t x_max, size_t y_max, size_t z_max);
-    // Generate the initial world state with random values (0 or 1)
-    tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> InitWorldStateRandom(size_t x_max, size_t y_max, size_t z_max);
+    // Generate the initial world state with independent random cells, each live with probability density
+    // (in [0, 1]). The same seed and dimensions always give the same world; see random_fill.hpp.
+    tl::expected<std::tuple<uint64_t, BitPackedGrid3D>, std::string> InitWorldStateRandom(size_t x_max, size_t y_max, size_t z_max,
+                                                                                          uint64_t seed, double density = 0.5);
     // Update the world state based on the current state and rule map
-    BitPackedGrid3D UpdateWorldState(const BitPackedGrid3D &current_world_state, const Bitset128 &rule);
+    BitPackedGrid3D UpdateWorldState(const BitPackedGrid3D &current_world_state, const Bitset128 &rule, RuleMode rule_mode);
     // Print the XY slices of the 3D grid for each Z value
     void PrintSlices(const BitPackedGrid3D &world_state);
     // Check if two states are
@@ -0,0 +1,201 @@
+#include "world_state_store.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+bool StoreSteppedCopy(WorldStateEntry &entry, size_t base_step, BitPackedGrid3D &grid, size_t step)
+{
+    std::unique_lock<std::shared_mutex> lock(entry.mutex);
+    if (entry.step != base_step)
+        return false;
+    const GridLayout layout = entry.state.front().layout();
+    if (grid.layout() == layout)
+        std::swap(entry.state.mutable_front(), grid);
+    else
+        entry.state.mutable_front() = grid.WithLayout(layout);
+    entry.step = step;
+    if (entry.hashlife)
+        entry.hashlife->Load(entry.state.front());
+    return true;
+}
+
+WorldStateStore::WorldStateStore(size_t max_bytes) : max_bytes(max_bytes) {}
+
+size_t WorldStateStore::EntryBytes(const BitPackedGrid3D &grid)
+{
+    return sizeof(WorldStateEntry) + 2 * grid.raw().size() * sizeof(uint64_t);
+}
+
+WorldStateStore::Shard &WorldStateStore::ShardFor(uint64_t id)
+{
+    return shards[id % kNumShards];
+}
+
+const WorldStateStore::Shard &WorldStateStore::ShardFor(uint64_t id) const
+{
+    return shards[id % kNumShards];
+}
+
+tl::expected<std::shared_ptr<WorldStateEntry>, std::string> WorldStateStore::Insert(uint64_t id, BitPackedGrid3D grid, RuleMode rule_mode)
+{
+    const size_t entry_bytes = EntryBytes(grid);
+    // Inserts run one at a time, so the state being replaced is still there when it's swapped out
+    std::lock_guard<std::mutex> insert_lock(eviction_mutex);
+    Shard &shard = ShardFor(id);
+    size_t replaced_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(id);
+        if (it != shard.entries.end())
+            replaced_bytes = it->second->bytes;
+    }
+    // A replaced state's bytes are freed with the swap, so only a larger grid needs room
+    if (!MakeRoom(entry_bytes - std::min(entry_bytes, replaced_bytes), id))
+    {
+        return tl::unexpected("World state of " + std::to_string(entry_bytes) + " bytes doesn't fit in the " +
+                              std::to_string(max_bytes) + " byte budget");
+    }
+
+    auto entry = std::make_shared<WorldStateEntry>(std::move(grid), rule_mode, entry_bytes);
+    entry->last_access.store(access_clock.fetch_add(1), std::memory_order_relaxed);
+    total_bytes.fetch_add(entry_bytes);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::shared_ptr<WorldStateEntry> &slot = shard.entries[id];
+    if (slot != nullptr)
+        total_bytes.fetch_sub(slot->bytes);
+    slot = entry;
+    shard.ForgetEviction(id);
+    return entry;
+}
+
+tl::expected<std::shared_ptr<WorldStateEntry>, std::string> WorldStateStore::Find(uint64_t id)
+{
+    Shard &shard = ShardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(id);
+    if (it == shard.entries.end())
+        return tl::unexpected("No world state found for id: " + std::to_string(id));
+
+    it->second->last_access.store(access_clock.fetch_add(1), std::memory_order_relaxed);
+    return it->second;
+}
+
+bool WorldStateStore::Erase(uint64_t id)
+{
+    std::shared_ptr<WorldStateEntry> erased;
+    {
+        Shard &shard = ShardFor(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.ForgetEviction(id);
+        auto it = shard.entries.find(id);
+        if (it == shard.entries.end())
+            return false;
+        erased = std::move(it->second);
+        shard.entries.erase(it);
+    }
+    // A handler still holding the entry keeps it alive, but the store no longer accounts for it
+    total_bytes.fetch_sub(erased->bytes);
+    return true;
+}
+
+std::optional<size_t> WorldStateStore::EvictedStep(uint64_t id) const
+{
+    const Shard &shard = ShardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.evicted_steps.find(id);
+    if (it == shard.evicted_steps.end())
+        return std::nullopt;
+    return it->second;
+}
+
+size_t WorldStateStore::remembered_evictions() const
+{
+    size_t count = 0;
+    for (const Shard &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.evicted_steps.size();
+    }
+    return count;
+}
+
+void WorldStateStore::Shard::ForgetEviction(uint64_t id)
+{
+    if (evicted_steps.erase(id) != 0)
+        evicted_order.erase(std::find(evicted_order.begin(), evicted_order.end(), id));
+}
+
+size_t WorldStateStore::size() const
+{
+    size_t count = 0;
+    for (const Shard &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.entries.size();
+    }
+    return count;
+}
+
+size_t WorldStateStore::bytes() const
+{
+    return total_bytes.load();
+}
+
+size_t WorldStateStore::evictions() const
+{
+    return num_evictions.load();
+}
+
+bool WorldStateStore::MakeRoom(size_t incoming, uint64_t replaced_id)
+{
+    auto fits = [&]
+    { return max_bytes == 0 || total_bytes.load() + incoming <= max_bytes; };
+    if (fits())
+        return true;
+    if (incoming > max_bytes)
+        return false;
+
+    // An entry is idle when the shard's shared_ptr is the only reference: taking another one requires the shard lock.
+    std::vector<std::pair<uint64_t, uint64_t>> candidates; // (last access, id)
+    for (Shard &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto &[id, entry] : shard.entries)
+        {
+            if (entry.use_count() == 1 && id != replaced_id)
+                candidates.emplace_back(entry->last_access.load(std::memory_order_relaxed), id);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto &[last_access, id] : candidates)
+    {
+        if (fits())
+            break;
+        Shard &shard = ShardFor(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(id);
+        // Skip states that were looked up since the scan
+        if (it == shard.entries.end() || it->second.use_count() != 1 ||
+            it->second->last_access.load(std::memory_order_relaxed) != last_access)
+            continue;
+        total_bytes.fetch_sub(it->second->bytes);
+        {
+            // Idle, so this never waits
+            std::shared_lock<std::shared_mutex> entry_lock(it->second->mutex);
+            shard.evicted_steps[id] = it->second->step;
+        }
+        // An id is only evicted while stored, and storing it forgets its last eviction, so it isn't queued yet
+        shard.evicted_order.push_back(id);
+        if (shard.evicted_order.size() > kEvictedStepsKept)
+        {
+            shard.evicted_steps.erase(shard.evicted_order.front());
+            shard.evicted_order.pop_front();
+        }
+        shard.entries.erase(it);
+        num_evictions.fetch_add(1);
+    }
+    return fits();
+}
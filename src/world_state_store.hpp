@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <tl/expected.hpp>
+#include "bit_packed_grid_3d.hpp"
+#include "double_buffered_grid.hpp"
+#include "hashlife.hpp"
+#include "random_bitset.hpp"
+
+// One stored world state. Readers take `mutex` shared, anything that steps or replaces the grid takes it exclusively.
+struct WorldStateEntry
+{
+    WorldStateEntry(BitPackedGrid3D grid, RuleMode rule_mode, size_t bytes)
+        : state(std::move(grid)), rule_mode(rule_mode), bytes(bytes) {}
+
+    std::shared_mutex mutex;
+    DoubleBufferedGrid state; // guarded by mutex, stepped in place
+    // Set for states stepped by HashLife, whose result is then extracted into state.front(). Guarded by mutex.
+    std::unique_ptr<HashLifeEngine> hashlife;
+    size_t step = 0;      // guarded by mutex
+    const RuleMode rule_mode;
+    const size_t bytes; // counted against the store's budget; steps never change the grids' size
+    // Value of the store's access clock when the entry was last looked up, for LRU eviction
+    std::atomic<uint64_t> last_access{0};
+};
+
+// Stores a grid stepped to `step` from a private copy of the entry's state taken at `base_step`, converted to
+// the entry's layout. Returns false, leaving the entry alone, if the entry was stepped since the copy was taken.
+bool StoreSteppedCopy(WorldStateEntry &entry, size_t base_step, BitPackedGrid3D &grid, size_t step);
+
+/**
+ * Thread-safe map from world state id (allocated by WorldStateContainer) to WorldStateEntry.
+ *
+ * Ids are spread over kNumShards independently locked maps, so lookups of different states
+ * rarely contend. Entries are handed out as shared_ptrs: erasing or evicting a state never
+ * invalidates one a handler is still working on.
+ *
+ * With a byte budget, inserting a state evicts the least recently used idle states (ones no
+ * handler holds) until the stored grids fit again. The store remembers the step each evicted
+ * state had reached, so a caller restoring it from elsewhere can tell an older copy from it. Only
+ * the last kEvictedStepsKept evictions per shard are remembered; that record, a few bytes per id,
+ * isn't counted against the budget.
+ */
+class WorldStateStore
+{
+public:
+    static constexpr size_t kNumShards = 16;
+    static constexpr size_t kEvictedStepsKept = 1024;
+
+    // max_bytes == 0 means unlimited
+    explicit WorldStateStore(size_t max_bytes = 0);
+
+    // Stores a new state under `id`. Fails if it doesn't fit in the budget even after evicting every idle state.
+    tl::expected<std::shared_ptr<WorldStateEntry>, std::string> Insert(uint64_t id, BitPackedGrid3D grid, RuleMode rule_mode);
+    tl::expected<std::shared_ptr<WorldStateEntry>, std::string> Find(uint64_t id);
+    // Returns false if there was no state with this id. Also forgets an eviction of the id.
+    bool Erase(uint64_t id);
+    // Step the state had reached when it was evicted, unless it was inserted again or erased since, or the
+    // eviction is too old to be remembered
+    std::optional<size_t> EvictedStep(uint64_t id) const;
+
+    size_t size() const;
+    // Memory held by the stored grids
+    size_t bytes() const;
+    size_t evictions() const;
+    // Evicted ids whose step is remembered
+    size_t remembered_evictions() const;
+
+    // Approximate memory footprint of a stored state, including its back buffer
+    static size_t EntryBytes(const BitPackedGrid3D &grid);
+
+private:
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, std::shared_ptr<WorldStateEntry>> entries;
+        std::unordered_map<uint64_t, size_t> evicted_steps;
+        std::deque<uint64_t> evicted_order; // ids of evicted_steps, oldest eviction first
+
+        void ForgetEviction(uint64_t id);
+    };
+
+    Shard &ShardFor(uint64_t id);
+    const Shard &ShardFor(uint64_t id) const;
+    // Evicts idle states other than `replaced_id`, oldest first, until `incoming` more bytes fit. Returns false if they can't.
+    bool MakeRoom(size_t incoming, uint64_t replaced_id);
+
+    const size_t max_bytes;
+    std::array<Shard, kNumShards> shards;
+    std::atomic<uint64_t> access_clock{0};
+    std::atomic<size_t> total_bytes{0};
+    std::atomic<size_t> num_evictions{0};
+    std::mutex eviction_mutex; // one Insert at a time, so concurrent inserts don't overshoot the budget together
+};
@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <set>
+#include "bit_packed_grid_3d.hpp"
+
+TEST_CASE("Brick layout needs power-of-two dimensions of at least 4")
+{
+    REQUIRE(BitPackedGrid3D::SupportsLayout(GRID_LAYOUT_ROW_MAJOR, 3, 5, 7));
+    REQUIRE(BitPackedGrid3D::SupportsLayout(GRID_LAYOUT_BRICK, 4, 16, 64));
+    REQUIRE_FALSE(BitPackedGrid3D::SupportsLayout(GRID_LAYOUT_BRICK, 4, 2, 4));
+    REQUIRE_FALSE(BitPackedGrid3D::SupportsLayout(GRID_LAYOUT_BRICK, 12, 4, 4));
+}
+
+TEST_CASE("Brick layout indexes every cell exactly once")
+{
+    const BitPackedGrid3D grid(8, 16, 4, GRID_LAYOUT_BRICK);
+    REQUIRE(grid.raw().size() == 8 * 16 * 4 / 64);
+
+    std::set<size_t> seen;
+    for (size_t x = 0; x < 8; ++x)
+        for (size_t y = 0; y < 16; ++y)
+            for (size_t z = 0; z < 4; ++z)
+            {
+                const size_t index = grid.index(x, y, z);
+                REQUIRE(index < grid.size_in_bits());
+                REQUIRE(seen.insert(index).second);
+                REQUIRE(grid.unpack_bit_index(index) == std::make_tuple(x, y, z));
+            }
+}
+
+TEST_CASE("Bricks are stored in Morton order")
+{
+    const BitPackedGrid3D grid(16, 16, 16, GRID_LAYOUT_BRICK);
+    const BrickOrder &order = *grid.brick_order();
+    // z varies fastest, then y, then x, one bit at a time
+    REQUIRE(order.Word(0, 0, 1) == 1);
+    REQUIRE(order.Word(0, 1, 0) == 2);
+    REQUIRE(order.Word(1, 0, 0) == 4);
+    REQUIRE(order.Word(0, 0, 2) == 8);
+    REQUIRE(order.Word(3, 3, 3) == 63);
+
+    // Bit (x % 4) * 16 + (y % 4) * 4 + z % 4 of the brick's word
+    REQUIRE(grid.index(5, 2, 3) == order.Word(1, 0, 0) * 64 + 1 * 16 + 2 * 4 + 3);
+}
+
+TEST_CASE("Converting between layouts keeps every cell")
+{
+    std::mt19937_64 gen(3);
+    BitPackedGrid3D row_major(16, 8, 32);
+    for (size_t i = 0; i < row_major.size_in_bits(); ++i)
+        row_major.set(i, gen() & 1);
+
+    const BitPackedGrid3D bricks = row_major.WithLayout(GRID_LAYOUT_BRICK);
+    REQUIRE(bricks.layout() == GRID_LAYOUT_BRICK);
+    REQUIRE(bricks.population() == row_major.population());
+    for (size_t x = 0; x < 16; ++x)
+        for (size_t y = 0; y < 8; ++y)
+            for (size_t z = 0; z < 32; ++z)
+                REQUIRE(bricks.get(x, y, z) == row_major.get(x, y, z));
+
+    REQUIRE(bricks == row_major);
+    REQUIRE(bricks.WithLayout(GRID_LAYOUT_ROW_MAJOR).raw() == row_major.raw());
+}
+
+TEST_CASE("CopyBits copies arbitrary unaligned bit ranges")
+{
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> src(6), dst(6);
+    for (int round = 0; round < 200; ++round)
+    {
+        for (uint64_t &word : src)
+            word = rng();
+        for (uint64_t &word : dst)
+            word = rng();
+        const std::vector<uint64_t> before = dst;
+        const size_t count = rng() % 200;
+        const size_t src_bit = rng() % (src.size() * 64 - count + 1);
+        const size_t dst_bit = rng() % (dst.size() * 64 - count + 1);
+        CopyBits(src.data(), src_bit, dst.data(), dst_bit, count);
+
+        for (size_t bit = 0; bit < dst.size() * 64; ++bit)
+        {
+            const bool in_range = bit >= dst_bit && bit < dst_bit + count;
+            const size_t from = in_range ? src_bit + bit - dst_bit : bit;
+            const std::vector<uint64_t> &expected = in_range ? src : before;
+            REQUIRE(((dst[bit / 64] >> (bit % 64)) & 1) == ((expected[from / 64] >> (from % 64)) & 1));
+        }
+    }
+}
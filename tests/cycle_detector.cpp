@@ -0,0 +1,105 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+#include "cycle_detector.hpp"
+#include "double_buffered_grid.hpp"
+#include "step_kernel.hpp"
+
+namespace
+{
+// Transient and period found by keeping every state
+std::pair<uint64_t, uint64_t> BruteForceCycle(const BitPackedGrid3D &initial, const Bitset128 &rule, RuleMode mode)
+{
+    std::vector<BitPackedGrid3D> history{initial};
+    for (;;)
+    {
+        BitPackedGrid3D next(initial.x_max, initial.y_max, initial.z_max);
+        StepGridReference(history.back(), next, rule, mode);
+        for (size_t seen = 0; seen < history.size(); ++seen)
+            if (history[seen] == next)
+                return {seen, history.size() - seen};
+        history.push_back(std::move(next));
+    }
+}
+} // namespace
+
+TEST_CASE("Incremental fingerprints match fingerprints of the full grid")
+{
+    BitPackedGrid3D initial(64, 32, 33);
+    initial.set(32, 16, 16, true);
+    DoubleBufferedGrid buffers(initial);
+    REQUIRE(buffers.fingerprint() == FingerprintGrid(initial));
+
+    const Bitset128 rule = build_from_eca(90);
+    for (int step = 0; step < 20; ++step)
+    {
+        buffers.Step(rule, RULE_3D);
+        REQUIRE(buffers.fingerprint() == FingerprintGrid(buffers.front()));
+    }
+    buffers.mutable_front().set(0, 0, 0, true);
+    REQUIRE(buffers.fingerprint() == FingerprintGrid(buffers.front()));
+}
+
+TEST_CASE("Cycle detection reports the exact transient and period")
+{
+    const Bitset128 random_rule = (Bitset128(0x0123456789abcdefULL) << 64) | Bitset128(0xfedcba9876543210ULL);
+    struct Case
+    {
+        BitPackedGrid3D initial;
+        Bitset128 rule;
+        RuleMode mode;
+    };
+    std::vector<Case> cases;
+    {
+        BitPackedGrid3D ring(8, 1, 1); // rule 90 on a power-of-two ring dies out
+        ring.set(3, 0, 0, true);
+        cases.push_back({ring, build_from_eca(90), RULE_1D_ECA});
+    }
+    {
+        BitPackedGrid3D ring(7, 1, 1);
+        ring.set(0, 0, 0, true);
+        cases.push_back({ring, build_from_eca(150), RULE_1D_ECA});
+    }
+    {
+        BitPackedGrid3D block(3, 2, 2); // 4096 states, so some state repeats
+        block.set(0, 0, 0, true);
+        block.set(2, 1, 0, true);
+        cases.push_back({block, random_rule, RULE_3D});
+    }
+
+    for (const Case &c : cases)
+    {
+        const auto [transient, period] = BruteForceCycle(c.initial, c.rule, c.mode);
+
+        DoubleBufferedGrid buffers(c.initial);
+        CycleDetector detector(buffers.front(), buffers.fingerprint());
+        uint64_t steps = 0;
+        do
+        {
+            buffers.Step(c.rule, c.mode);
+            ++steps;
+            REQUIRE(steps <= 2 * (transient + period) + 2);
+        } while (!detector.Observe(buffers.front(), buffers.fingerprint()));
+
+        REQUIRE(detector.period() == period);
+        REQUIRE(steps >= transient + period);
+        auto found = FindTransientLength(c.initial, c.rule, c.mode, period, []
+                                         { return true; });
+        REQUIRE(found.has_value());
+        REQUIRE(*found == transient);
+
+        // As if only every third state had been observed
+        auto exact = FindPeriod(buffers.front(), c.rule, c.mode, 3 * period, []
+                                { return true; });
+        REQUIRE(exact.has_value());
+        REQUIRE(*exact == period);
+    }
+}
+
+TEST_CASE("Transient search stops when told to")
+{
+    BitPackedGrid3D ring(7, 1, 1);
+    ring.set(0, 0, 0, true);
+    REQUIRE_FALSE(FindTransientLength(ring, build_from_eca(150), RULE_1D_ECA, 1000, []
+                                      { return false; })
+                      .has_value());
+}
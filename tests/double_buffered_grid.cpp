@@ -0,0 +1,95 @@
+#include <catch2/catch_test_macros.hpp>
+#include "double_buffered_grid.hpp"
+#include "step_kernel.hpp"
+
+TEST_CASE("Double-buffered stepping reuses its two buffers")
+{
+    BitPackedGrid3D initial(40, 12, 9);
+    for (size_t i = 0; i < initial.size_in_bits(); i += 3)
+        initial.set(i, true);
+    const Bitset128 rule = (Bitset128(0x0123456789abcdefULL) << 64) | Bitset128(0xfedcba9876543210ULL);
+
+    DoubleBufferedGrid buffers(initial);
+    const uint64_t *first = buffers.front().raw().data();
+    const uint64_t *second = buffers.back().raw().data();
+
+    BitPackedGrid3D expected = initial;
+    for (int step = 0; step < 5; ++step)
+    {
+        BitPackedGrid3D next(expected.x_max, expected.y_max, expected.z_max);
+        StepGridReference(expected, next, rule, RULE_3D);
+        buffers.Step(rule, RULE_3D);
+        REQUIRE(buffers.back() == expected); // previous state
+        expected = next;
+        REQUIRE(buffers.front() == expected);
+
+        const uint64_t *front = buffers.front().raw().data();
+        REQUIRE((front == first || front == second));
+        REQUIRE(front != buffers.back().raw().data());
+    }
+}
+
+TEST_CASE("Active-region stepping skips quiescent blocks without changing results")
+{
+    const Bitset128 sparse_rule = build_from_eca(90);
+    Bitset128 dense_rule = sparse_rule;
+    dense_rule.set(0); // all-zero neighbourhoods come alive
+
+    for (RuleMode mode : {RULE_1D_ECA, RULE_3D})
+    {
+        BitPackedGrid3D initial(64, 32, 33);
+        initial.set(32, 16, 16, true);
+        DoubleBufferedGrid buffers(initial);
+        BitPackedGrid3D expected = initial;
+        BitPackedGrid3D next = initial;
+
+        for (int step = 0; step < 40; ++step)
+        {
+            // Switch rules and poke the state mid-run; both must reset the tracking
+            const Bitset128 &rule = step < 20 || step >= 25 ? sparse_rule : dense_rule;
+            if (step == 30)
+            {
+                buffers.mutable_front().set(5, 5, 5, true);
+                expected.set(5, 5, 5, true);
+            }
+
+            StepGridReference(expected, next, rule, mode);
+            std::swap(expected, next);
+            buffers.Step(rule, mode);
+
+            CAPTURE(mode, step);
+            REQUIRE(buffers.front() == expected);
+            const ActiveStepStats &stats = buffers.last_step_stats();
+            REQUIRE(stats.blocks_computed + stats.blocks_skipped == NumActiveBlocks(initial));
+            if (step == 1 || step == 31)
+                CHECK(stats.blocks_skipped > 0);
+        }
+    }
+}
+
+TEST_CASE("Active-region stepping tracks brick layout grids")
+{
+    const Bitset128 rule = build_from_eca(90);
+    for (RuleMode mode : {RULE_1D_ECA, RULE_3D})
+    {
+        BitPackedGrid3D initial(64, 32, 32);
+        initial.set(32, 16, 16, true);
+        DoubleBufferedGrid buffers(initial.WithLayout(GRID_LAYOUT_BRICK));
+        BitPackedGrid3D expected = initial;
+        BitPackedGrid3D next = initial;
+
+        for (int step = 0; step < 12; ++step)
+        {
+            StepGrid(expected, next, rule, mode);
+            std::swap(expected, next);
+            buffers.Step(rule, mode);
+
+            CAPTURE(mode, step);
+            REQUIRE(buffers.front().layout() == GRID_LAYOUT_BRICK);
+            REQUIRE(buffers.front() == expected);
+            REQUIRE(buffers.fingerprint() == FingerprintGrid(buffers.front()));
+            if (step >= 1)
+                CHECK(buffers.last_step_stats().blocks_skipped > 0);
+        }
+    }
+}
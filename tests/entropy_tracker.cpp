@@ -0,0 +1,88 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include "entropy_tracker.hpp"
+#include "random_grid.hpp"
+
+namespace
+{
+bool Near(double a, double b)
+{
+    return std::abs(a - b) < 1e-9;
+}
+
+BitPackedGrid3D GridWithCell(size_t x)
+{
+    BitPackedGrid3D grid(16, 8, 8);
+    grid.set(x, 3, 5, true);
+    return grid;
+}
+} // namespace
+
+TEST_CASE("Exact entropy tracking counts states by fingerprint")
+{
+    EntropyTracker tracker;
+    REQUIRE(tracker.entropy() == 0.0);
+
+    tracker.observe(GridWithCell(1));
+    tracker.observe(GridWithCell(1));
+    tracker.observe(GridWithCell(2));
+    tracker.observe(FingerprintGrid(GridWithCell(3)));
+    // p = 1/2, 1/4, 1/4
+    REQUIRE(Near(tracker.entropy(), 1.5));
+    REQUIRE(tracker.tracked_states() == 3);
+    REQUIRE(tracker.total_observations() == 4);
+    REQUIRE_FALSE(tracker.approximate());
+
+    tracker.reset();
+    tracker.observe(GridWithCell(4));
+    REQUIRE(tracker.entropy() == 0.0);
+}
+
+TEST_CASE("Approximate entropy tracking stays within its counter budget")
+{
+    EntropyTracker exact;
+    EntropyTracker approximate(4);
+    REQUIRE(approximate.approximate());
+
+    // A frequent state interleaved with many one-off states
+    for (size_t i = 0; i < 12; ++i)
+    {
+        for (EntropyTracker *tracker : {&exact, &approximate})
+        {
+            tracker->observe(GridWithCell(0));
+            tracker->observe(GridWithCell(1 + i));
+        }
+    }
+
+    REQUIRE(approximate.tracked_states() <= 4);
+    REQUIRE(approximate.total_observations() == exact.total_observations());
+    REQUIRE(Near(exact.entropy(), 1.0 + 0.5 * std::log2(12.0)));
+    // Merging rare states can only lower the entropy
+    REQUIRE(approximate.entropy() <= exact.entropy() + 1e-9);
+    REQUIRE(approximate.entropy() >= 1.0 - 1e-9);
+}
+
+TEST_CASE("Block pattern entropy measures 8-cell patterns")
+{
+    BitPackedGrid3D empty(16, 8, 8);
+    REQUIRE(BlockPatternEntropy(empty) == 0.0);
+
+    // 2048 cells: each of the 256 byte values once
+    BitPackedGrid3D all_patterns(16, 16, 8);
+    for (size_t i = 0; i < all_patterns.size_in_bits(); ++i)
+        all_patterns.set(i, ((i / 8) % 256 >> (i % 8)) & 1);
+    REQUIRE(Near(BlockPatternEntropy(all_patterns), 8.0));
+
+    BitPackedGrid3D halves(16, 8, 8);
+    for (size_t i = 0; i < halves.size_in_bits(); i += 16)
+        halves.set(i, true); // every other byte is 0x01
+    REQUIRE(Near(BlockPatternEntropy(halves), 1.0));
+}
+
+TEST_CASE("Block pattern entropy doesn't depend on the grid's layout")
+{
+    const BitPackedGrid3D row_major = RandomGrid(16, 8, 32, 7);
+    const BitPackedGrid3D brick = row_major.WithLayout(GRID_LAYOUT_BRICK);
+    REQUIRE(brick.raw() != row_major.raw());
+    REQUIRE(Near(BlockPatternEntropy(brick), BlockPatternEntropy(row_major)));
+}
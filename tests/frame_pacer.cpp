@@ -0,0 +1,72 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "frame_pacer.hpp"
+
+TEST_CASE("Frame pacing sends every Nth step and the last one")
+{
+    FramePacer pacer(4, false);
+    std::vector<uint64_t> sent;
+    for (uint64_t step = 1; step <= 10; ++step)
+        if (pacer.ShouldSend(step, step == 10, false))
+            sent.push_back(step);
+    const std::vector<uint64_t> expected = {4, 8, 10};
+    REQUIRE(sent == expected);
+    REQUIRE(pacer.frames_dropped() == 0);
+
+    REQUIRE(pacer.StepsToNextDue(0) == 4);
+    REQUIRE(pacer.StepsToNextDue(5) == 3);
+    REQUIRE(pacer.StepsToNextDue(8) == 4);
+    REQUIRE(FramePacer(0, false).StepsToNextDue(7) == 1);
+}
+
+TEST_CASE("Latest-only pacing drops due frames while the client is busy")
+{
+    FramePacer pacer(2, true);
+    REQUIRE_FALSE(pacer.ShouldSend(1, false, true)); // not due
+    REQUIRE_FALSE(pacer.ShouldSend(2, false, false));
+    REQUIRE_FALSE(pacer.ShouldSend(3, false, false)); // not due, so not dropped either
+    REQUIRE_FALSE(pacer.ShouldSend(4, false, false));
+    REQUIRE(pacer.ShouldSend(6, false, true));
+    REQUIRE(pacer.ShouldSend(7, true, false)); // the last frame is never dropped
+    REQUIRE(pacer.frames_dropped() == 2);
+}
+
+TEST_CASE("Threaded frame sink overlaps writes with the producer but holds at most one frame")
+{
+    std::atomic<int> written{0};
+    std::atomic<bool> in_order{true};
+    std::atomic<bool> release{false};
+    ThreadedFrameSink<int> sink([&](const int &frame)
+                                {
+        while (!release)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        // Catch2 assertions aren't thread-safe, so the order is checked afterwards
+        in_order = in_order && frame == written + 1;
+        ++written;
+        return true; });
+
+    REQUIRE(sink.Ready());
+    REQUIRE(sink.Send(1)); // returns while the write is stuck
+    REQUIRE_FALSE(sink.Ready());
+    REQUIRE(written == 0);
+
+    release = true;
+    REQUIRE(sink.Send(2)); // waits for the first write
+    REQUIRE(written >= 1);
+    REQUIRE(sink.Flush());
+    REQUIRE(written == 2);
+    REQUIRE(in_order);
+    REQUIRE(sink.Ready());
+}
+
+TEST_CASE("Threaded frame sink reports a broken stream")
+{
+    ThreadedFrameSink<int> sink([](const int &frame)
+                                { return frame != 2; });
+    REQUIRE(sink.Send(1));
+    REQUIRE(sink.Send(2));
+    REQUIRE_FALSE(sink.Flush());
+    REQUIRE_FALSE(sink.Send(3));
+}
@@ -0,0 +1,82 @@
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include "grid_region.hpp"
+#include "random_grid.hpp"
+
+namespace
+{
+GridBox RandomBox(const BitPackedGrid3D &grid, std::mt19937 &rng)
+{
+    GridBox box;
+    box.x = rng() % grid.x_max;
+    box.y = rng() % grid.y_max;
+    box.z = rng() % grid.z_max;
+    box.size_x = 1 + rng() % (grid.x_max - box.x);
+    box.size_y = 1 + rng() % (grid.y_max - box.y);
+    box.size_z = 1 + rng() % (grid.z_max - box.z);
+    return box;
+}
+} // namespace
+
+TEST_CASE("Boxes must be non-empty and within the grid")
+{
+    const BitPackedGrid3D grid(8, 4, 5);
+    REQUIRE(BoxWithinGrid(grid, GridBox{0, 0, 0, 8, 4, 5}));
+    REQUIRE(BoxWithinGrid(grid, GridBox{7, 3, 4, 1, 1, 1}));
+    REQUIRE_FALSE(BoxWithinGrid(grid, GridBox{7, 3, 4, 2, 1, 1}));
+    REQUIRE_FALSE(BoxWithinGrid(grid, GridBox{8, 0, 0, 1, 1, 1}));
+    REQUIRE_FALSE(BoxWithinGrid(grid, GridBox{0, 0, 0, 8, 0, 5}));
+}
+
+TEST_CASE("Extracted regions hold the box's cells in either layout")
+{
+    std::mt19937 rng(3);
+    const BitPackedGrid3D row_major = RandomGrid(16, 8, 32, 1);
+    for (GridLayout layout : {GRID_LAYOUT_ROW_MAJOR, GRID_LAYOUT_BRICK})
+    {
+        const BitPackedGrid3D grid = row_major.WithLayout(layout);
+        for (int round = 0; round < 50; ++round)
+        {
+            const GridBox box = RandomBox(grid, rng);
+            const BitPackedGrid3D region = ExtractRegion(grid, box);
+            REQUIRE(region.layout() == GRID_LAYOUT_ROW_MAJOR);
+            REQUIRE(region.size_in_bits() == box.cells());
+            for (size_t x = 0; x < box.size_x; ++x)
+                for (size_t y = 0; y < box.size_y; ++y)
+                    for (size_t z = 0; z < box.size_z; ++z)
+                        REQUIRE(region.get(x, y, z) == grid.get(box.x + x, box.y + y, box.z + z));
+        }
+    }
+}
+
+TEST_CASE("Block populations count the live cells of every block")
+{
+    std::mt19937 rng(4);
+    const BitPackedGrid3D row_major = RandomGrid(32, 16, 64, 2);
+    for (GridLayout layout : {GRID_LAYOUT_ROW_MAJOR, GRID_LAYOUT_BRICK})
+    {
+        const BitPackedGrid3D grid = row_major.WithLayout(layout);
+        // Aligned boxes with block sizes of whole bricks take the brick layout's fast path
+        std::vector<std::pair<GridBox, size_t>> cases = {{GridBox{0, 0, 0, 32, 16, 64}, 8}, {GridBox{4, 8, 16, 16, 8, 32}, 4}};
+        for (int round = 0; round < 30; ++round)
+            cases.push_back({RandomBox(grid, rng), 1 + rng() % 9});
+
+        for (const auto &[box, block_size] : cases)
+        {
+            const BlockPopulations populations = CountBlockPopulations(grid, box, block_size);
+            REQUIRE(populations.blocks_x == (box.size_x + block_size - 1) / block_size);
+            REQUIRE(populations.blocks_y == (box.size_y + block_size - 1) / block_size);
+            REQUIRE(populations.blocks_z == (box.size_z + block_size - 1) / block_size);
+
+            std::vector<uint64_t> expected(populations.counts.size(), 0);
+            for (size_t x = 0; x < box.size_x; ++x)
+                for (size_t y = 0; y < box.size_y; ++y)
+                    for (size_t z = 0; z < box.size_z; ++z)
+                    {
+                        const size_t block = ((x / block_size) * populations.blocks_y + y / block_size) * populations.blocks_z + z / block_size;
+                        expected[block] += grid.get(box.x + x, box.y + y, box.z + z);
+                    }
+            REQUIRE(populations.counts == expected);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "metrics.hpp"
+
+namespace
+{
+// Histogram quantiles are bucket midpoints, accurate to within one bucket (12.5%)
+bool WithinBucket(double estimate, double exact)
+{
+    return std::abs(estimate - exact) <= exact / 8;
+}
+} // namespace
+
+TEST_CASE("Sharded counters sum the updates of every thread")
+{
+    ShardedCounter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 32; ++t)
+        threads.emplace_back([&counter]
+                             {
+            for (int i = 0; i < 1000; ++i)
+                counter.Add(2); });
+    for (std::thread &thread : threads)
+        thread.join();
+    REQUIRE(counter.Value() == 32 * 1000 * 2);
+}
+
+TEST_CASE("Histogram buckets cover every duration in increasing order")
+{
+    for (uint64_t nanos : {0ULL, 1ULL, 7ULL, 8ULL, 9ULL, 15ULL, 16ULL, 1000ULL, 123456789ULL, (1ULL << 41) - 1})
+    {
+        const size_t bucket = LatencyHistogram::BucketFor(nanos);
+        REQUIRE(bucket < LatencyHistogram::kNumBuckets);
+        REQUIRE(LatencyHistogram::BucketLowerBound(bucket) <= nanos);
+        if (bucket + 1 < LatencyHistogram::kNumBuckets)
+            REQUIRE(nanos < LatencyHistogram::BucketLowerBound(bucket + 1));
+    }
+    REQUIRE(LatencyHistogram::BucketFor(~0ULL) == LatencyHistogram::kNumBuckets - 1);
+}
+
+TEST_CASE("Histogram quantiles follow the recorded distribution")
+{
+    LatencyHistogram histogram;
+    REQUIRE(histogram.Summarize().count == 0);
+
+    // 1..10000 us
+    for (uint64_t i = 1; i <= 10000; ++i)
+        histogram.Record(i * 1000);
+    const LatencyHistogram::Summary summary = histogram.Summarize();
+    REQUIRE(summary.count == 10000);
+    REQUIRE(summary.max_ns == 10000 * 1000);
+    REQUIRE(WithinBucket(summary.p50_ns, 5000 * 1000));
+    REQUIRE(WithinBucket(summary.p99_ns, 9900 * 1000));
+    REQUIRE(WithinBucket(summary.p999_ns, 9990 * 1000));
+    REQUIRE(summary.p999_ns <= summary.max_ns);
+}
+
+TEST_CASE("Scoped timers record once")
+{
+    LatencyHistogram histogram;
+    ShardedCounter nanos;
+    {
+        ScopedTimer latency(histogram);
+        ScopedTimer total(nanos);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        total.Stop();
+        total.Stop();
+    }
+    REQUIRE(histogram.Summarize().count == 1);
+    REQUIRE(nanos.Value() >= 2000000);
+}
+
+TEST_CASE("Prometheus text has a sample per metric")
+{
+    ServerMetrics metrics;
+    metrics.rpc_latency[METRIC_RPC_UPDATE_RULE].Record(1000);
+    metrics.steps.Add(3);
+    metrics.timeouts.Add(1);
+    metrics.frames_dropped.Add(3);
+
+    const std::string text = metrics.PrometheusText(2, 4096);
+    REQUIRE(text.find("ca_rpc_latency_seconds_count{rpc=\"UpdateRule\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("ca_rpc_latency_seconds{rpc=\"InitWorldState\",quantile=\"0.99\"} 0\n") != std::string::npos);
+    REQUIRE(text.find("# TYPE ca_steps_total counter\nca_steps_total 3\n") != std::string::npos);
+    REQUIRE(text.find("ca_simulation_timeouts_total 1\n") != std::string::npos);
+    REQUIRE(text.find("ca_stream_frames_dropped_total 3\n") != std::string::npos);
+    REQUIRE(text.find("ca_world_states 2\n") != std::string::npos);
+    REQUIRE(text.find("ca_world_state_bytes 4096\n") != std::string::npos);
+}
@@ -0,0 +1,103 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "mapped_file.hpp"
+#include "out_of_core_stepper.hpp"
+#include "random_grid.hpp"
+#include "snapshot_store.hpp"
+#include "step_kernel.hpp"
+
+namespace
+{
+struct TempDirectory
+{
+    TempDirectory()
+        : path(std::filesystem::temp_directory_path() / ("out_of_core_test_" + std::to_string(std::random_device()())))
+    {
+        std::filesystem::create_directories(path);
+    }
+    ~TempDirectory() { std::filesystem::remove_all(path); }
+    std::filesystem::path path;
+};
+
+} // namespace
+
+TEST_CASE("Out-of-core stepping matches in-memory stepping")
+{
+    const Bitset128 rule = (Bitset128(0x0123456789abcdefULL) << 64) | Bitset128(0xfedcba9876543210ULL);
+    struct Case
+    {
+        size_t x, y, z;
+        size_t window_bytes;
+        RuleMode mode;
+    };
+    // Slabs that aren't word-aligned, uneven chunks, single-slab chunks, and worlds of 1 or 2 slabs
+    const Case cases[] = {
+        {23, 7, 9, 64, RULE_3D},
+        {40, 8, 8, 48, RULE_3D},
+        {17, 5, 3, 1, RULE_3D},
+        {1, 9, 11, 1 << 20, RULE_3D},
+        {2, 6, 7, 1, RULE_3D},
+        {64, 3, 5, 30, RULE_1D_ECA},
+    };
+
+    TempDirectory dir;
+    auto store = SnapshotStore::Open(dir.path.string());
+    REQUIRE(store.has_value());
+    uint64_t id = 0;
+    for (const Case &c : cases)
+    {
+        const BitPackedGrid3D initial = RandomGrid(c.x, c.y, c.z, static_cast<uint32_t>(id));
+        REQUIRE((*store)->Save(id, Snapshot{initial, 5, c.mode, false}).has_value());
+        const std::string input = (dir.path / (std::to_string(id) + ".snap")).string();
+        const std::string output = (dir.path / "stepped").string();
+
+        OutOfCoreStepper stepper(c.window_bytes);
+        auto stats = stepper.Step(input, output, rule, c.mode, 3);
+        REQUIRE(stats.has_value());
+        REQUIRE(stats->chunks * stats->chunk_slabs >= c.x);
+
+        BitPackedGrid3D expected = initial;
+        for (int step = 0; step < 3; ++step)
+        {
+            BitPackedGrid3D next(c.x, c.y, c.z);
+            StepGrid(expected, next, rule, c.mode);
+            expected = next;
+        }
+
+        auto mapped = MappedFile::OpenReadOnly(output);
+        REQUIRE(mapped.has_value());
+        auto header = SnapshotHeader::Parse(mapped->data(), mapped->size(), output);
+        REQUIRE(header.has_value());
+        REQUIRE(header->step == 8);
+        REQUIRE(header->rule_mode() == c.mode);
+        BitPackedGrid3D stepped(c.x, c.y, c.z);
+        std::memcpy(stepped.raw().data(), mapped->data() + sizeof(SnapshotHeader), stepped.raw().size() * sizeof(uint64_t));
+        REQUIRE(stepped == expected);
+        REQUIRE(header->fingerprint_lo == FingerprintGrid(expected).lo);
+        REQUIRE(header->fingerprint_hi == FingerprintGrid(expected).hi);
+        REQUIRE_FALSE(std::filesystem::exists(output + ".tmp0"));
+        ++id;
+    }
+}
+
+TEST_CASE("Out-of-core stepping rejects a corrupt input")
+{
+    TempDirectory dir;
+    auto store = SnapshotStore::Open(dir.path.string());
+    REQUIRE(store.has_value());
+    REQUIRE((*store)->Save(0, Snapshot{RandomGrid(8, 8, 8, 1), 0, RULE_3D, false}).has_value());
+    const std::string input = (dir.path / "0.snap").string();
+    {
+        std::fstream file(input, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(64 + 10);
+        file.put('\x33');
+    }
+
+    OutOfCoreStepper stepper(64);
+    const std::string output = (dir.path / "stepped").string();
+    REQUIRE_FALSE(stepper.Step(input, output, build_from_eca(30), RULE_3D).has_value());
+    REQUIRE_FALSE(std::filesystem::exists(output));
+}
@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+#include <bitset>
+#include <cmath>
+#include "random_fill.hpp"
+#include "thread_pool.hpp"
+#include "world_state.hpp"
+
+namespace
+{
+uint64_t Population(const BitPackedGrid3D &grid)
+{
+    uint64_t population = 0;
+    for (uint64_t word : grid.raw())
+        population += std::bitset<64>(word).count();
+    return population;
+}
+} // namespace
+
+TEST_CASE("Random fills depend only on the seed, not on the pool size")
+{
+    ThreadPool one(1);
+    ThreadPool four(4);
+    BitPackedGrid3D a(40, 33, 70);
+    BitPackedGrid3D b(40, 33, 70);
+    FillRandom(a, 7, 0.3, one);
+    FillRandom(b, 7, 0.3, four);
+    REQUIRE(a.raw() == b.raw());
+
+    FillRandom(b, 8, 0.3, four);
+    REQUIRE(a.raw() != b.raw());
+}
+
+TEST_CASE("Random fills give the same world in either layout")
+{
+    BitPackedGrid3D row_major(16, 32, 8);
+    BitPackedGrid3D brick(16, 32, 8, GRID_LAYOUT_BRICK);
+    FillRandom(row_major, 3, 0.5);
+    FillRandom(brick, 3, 0.5);
+    REQUIRE(brick.layout() == GRID_LAYOUT_BRICK);
+    REQUIRE(brick.WithLayout(GRID_LAYOUT_ROW_MAJOR).raw() == row_major.raw());
+}
+
+TEST_CASE("Random fills hit the requested density and leave the padding clear")
+{
+    // 3 x 5 x 7 cells don't fill the last word
+    BitPackedGrid3D small(3, 5, 7);
+    FillRandom(small, 1, 1.0);
+    REQUIRE(Population(small) == small.size_in_bits());
+    FillRandom(small, 1, 0.0);
+    REQUIRE(Population(small) == 0);
+
+    BitPackedGrid3D grid(64, 64, 64);
+    for (double density : {0.5, 0.25, 0.75, 0.3, 0.01})
+    {
+        FillRandom(grid, 11, density);
+        const double cells = static_cast<double>(grid.size_in_bits());
+        // Within five standard deviations of the binomial mean
+        const double tolerance = 5 * std::sqrt(cells * density * (1 - density));
+        REQUIRE(std::abs(static_cast<double>(Population(grid)) - cells * density) < tolerance);
+    }
+}
+
+TEST_CASE("Random cell words use the binary expansion of the density")
+{
+    // A density of one half is a single random word; three quarters ORs in a second one
+    REQUIRE(RandomCellsWord(5, 9, 1u << 15) == RandomWord(5, 9 * kRandomFillDensityBits + 15));
+    REQUIRE(RandomCellsWord(5, 9, 3u << 14) ==
+            (RandomWord(5, 9 * kRandomFillDensityBits + 14) | RandomWord(5, 9 * kRandomFillDensityBits + 15)));
+    REQUIRE(DensityNumerator(0.25) == 1u << 14);
+    REQUIRE(DensityNumerator(1.0) == 1u << kRandomFillDensityBits);
+}
+
+TEST_CASE("Random world states are reproducible and validate their density")
+{
+    WorldStateContainer states;
+    auto a = states.InitWorldStateRandom(10, 20, 30, 42, 0.4);
+    auto b = states.InitWorldStateRandom(10, 20, 30, 42, 0.4);
+    REQUIRE(a.has_value());
+    REQUIRE(b.has_value());
+    REQUIRE(std::get<0>(*a) != std::get<0>(*b));
+    REQUIRE(std::get<1>(*a).raw() == std::get<1>(*b).raw());
+
+    REQUIRE_FALSE(states.InitWorldStateRandom(10, 20, 30, 42, 1.5).has_value());
+    REQUIRE_FALSE(states.InitWorldStateRandom(10, 20, 30, 42, std::nan("")).has_value());
+    REQUIRE_FALSE(states.InitWorldStateRandom(0, 20, 30, 42).has_value());
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include "bit_packed_grid_3d.hpp"
+#include "random_bitset.hpp"
+#include "random_fill.hpp"
+
+// Test grid with about a third of its cells live, the same for the same seed and dimensions
+inline BitPackedGrid3D RandomGrid(size_t x, size_t y, size_t z, uint64_t seed)
+{
+    BitPackedGrid3D grid(x, y, z);
+    FillRandom(grid, seed, 1.0 / 3);
+    return grid;
+}
+
+// Rule with each of its 128 bits set with probability 1/2, the same for the same seed
+inline Bitset128 RandomRule(uint64_t seed)
+{
+    std::mt19937_64 gen(seed);
+    return (Bitset128(gen()) << 64) | Bitset128(gen());
+}
@@ -0,0 +1,78 @@
+#include <catch2/catch_test_macros.hpp>
+#include "rule_compiler.hpp"
+
+TEST_CASE("Compiled ECA rules only read the x pair")
+{
+    const auto plan = CompileRule(build_from_eca(110), RULE_1D_ECA);
+    REQUIRE(plan->kind == RULE_PLAN_GENERAL);
+    REQUIRE(plan->reads_center);
+    REQUIRE(plan->reads_x);
+    REQUIRE_FALSE(plan->reads_y);
+    REQUIRE_FALSE(plan->reads_z);
+    REQUIRE_FALSE(plan->symmetric); // rule 110 isn't left-right symmetric
+    REQUIRE_FALSE(plan->totalistic);
+
+    // XOR of the two x neighbours: symmetric and totalistic, and it ignores the central cell
+    const auto rule90 = CompileRule(build_from_eca(90), RULE_1D_ECA);
+    REQUIRE_FALSE(rule90->reads_center);
+    REQUIRE(rule90->symmetric);
+    REQUIRE(rule90->totalistic);
+}
+
+TEST_CASE("ECA-derived rules ignore y and z in 3D mode too")
+{
+    // build_from_eca only sets bits with y = z = 0, so in 3D any live y or z neighbour kills the cell
+    const auto plan = CompileRule(build_from_eca(90), RULE_3D);
+    REQUIRE(plan->reads_y);
+
+    Bitset128 x_only;
+    for (size_t index = 0; index < 128; ++index)
+        x_only[index] = ((index >> 5) ^ (index >> 4)) & 1; // xm XOR xp, whatever y and z
+    const auto x_plan = CompileRule(x_only, RULE_3D);
+    REQUIRE(x_plan->reads_x);
+    REQUIRE_FALSE(x_plan->reads_y);
+    REQUIRE_FALSE(x_plan->reads_z);
+    REQUIRE_FALSE(x_plan->reads_center);
+}
+
+TEST_CASE("Constant and identity rules are recognised")
+{
+    REQUIRE(CompileRule(Bitset128(), RULE_3D)->kind == RULE_PLAN_ALL_DEAD);
+    REQUIRE(CompileRule(Bitset128().set(), RULE_3D)->kind == RULE_PLAN_ALL_LIVE);
+
+    Bitset128 identity;
+    for (size_t index = 64; index < 128; ++index)
+        identity.set(index);
+    REQUIRE(CompileRule(identity, RULE_3D)->kind == RULE_PLAN_IDENTITY);
+    REQUIRE(CompileRule(build_from_eca(204), RULE_1D_ECA)->kind == RULE_PLAN_IDENTITY);
+    // Under ECA only indices with y = z = 0 count
+    REQUIRE(CompileRule(Bitset128(0xEEEEULL), RULE_1D_ECA)->kind == RULE_PLAN_ALL_DEAD);
+}
+
+TEST_CASE("Outer-totalistic 3D rules are recognised")
+{
+    // Live with exactly 2 live neighbours, or 3 when alive
+    Bitset128 rule;
+    for (size_t index = 0; index < 128; ++index)
+    {
+        const int neighbours = __builtin_popcount(static_cast<unsigned>(index & 0x3F));
+        const bool alive = (index >> 6) & 1;
+        rule[index] = neighbours == 2 || (alive && neighbours == 3);
+    }
+    const auto plan = CompileRule(rule, RULE_3D);
+    REQUIRE(plan->totalistic);
+    REQUIRE(plan->symmetric);
+    REQUIRE(plan->reads_x);
+    REQUIRE(plan->reads_y);
+    REQUIRE(plan->reads_z);
+}
+
+TEST_CASE("Compiled plans are cached by rule and mode")
+{
+    const Bitset128 rule = build_from_eca(30);
+    const auto first = CompileRule(rule, RULE_1D_ECA);
+    const size_t cached = CompiledRuleCacheSize();
+    REQUIRE(CompileRule(rule, RULE_1D_ECA) == first);
+    REQUIRE(CompiledRuleCacheSize() == cached);
+    REQUIRE(CompileRule(rule, RULE_3D) != first);
+}
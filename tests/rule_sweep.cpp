@@ -0,0 +1,66 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+#include "rule_sweep.hpp"
+#include "step_kernel.hpp"
+
+TEST_CASE("Rule sweeps match stepping every rule separately")
+{
+    BitPackedGrid3D initial(37, 1, 1);
+    initial.set(18, 0, 0, true);
+    initial.set(20, 0, 0, true);
+
+    std::vector<Bitset128> rules;
+    for (int number = 0; number < 256; number += 5)
+        rules.push_back(build_from_eca(static_cast<uint8_t>(number)));
+
+    RuleSweepOptions options;
+    options.num_steps = 300;
+    options.track_states = true;
+    const std::vector<RuleSummary> summaries = SweepRules(initial, rules, RULE_1D_ECA, options, []
+                                                          { return true; },
+                                                          4);
+    REQUIRE(summaries.size() == rules.size());
+
+    for (size_t i = 0; i < rules.size(); ++i)
+    {
+        BitPackedGrid3D expected = initial;
+        for (uint64_t step = 0; step < options.num_steps; ++step)
+        {
+            BitPackedGrid3D next(expected.x_max, expected.y_max, expected.z_max);
+            StepGridReference(expected, next, rules[i], RULE_1D_ECA);
+            expected = next;
+        }
+
+        const RuleSummary &summary = summaries[i];
+        REQUIRE(summary.steps == options.num_steps);
+        REQUIRE(summary.final_population == expected.population());
+        REQUIRE(summary.state_changed == !(expected == initial));
+        if (summary.cycle_period != 0)
+        {
+            REQUIRE(summary.transient_length >= 0);
+            REQUIRE(summary.cycle_detected_at_step <= options.num_steps);
+        }
+    }
+
+    // Rule 0 clears the world in one step and stays there
+    REQUIRE(summaries[0].final_population == 0);
+    REQUIRE(summaries[0].cycle_period == 1);
+    REQUIRE(summaries[0].transient_length == 1);
+}
+
+TEST_CASE("Rule sweeps stop when told to")
+{
+    BitPackedGrid3D initial(64, 1, 1);
+    initial.set(5, 0, 0, true);
+    RuleSweepOptions options;
+    options.num_steps = 1000;
+    const std::vector<RuleSummary> summaries = SweepRules(initial, {build_from_eca(30), build_from_eca(110)}, RULE_1D_ECA, options, []
+                                                          { return false; },
+                                                          2);
+    for (const RuleSummary &summary : summaries)
+    {
+        REQUIRE(summary.steps == 0);
+        REQUIRE(summary.final_population == 1);
+        REQUIRE_FALSE(summary.state_changed);
+    }
+}
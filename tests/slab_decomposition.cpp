@@ -0,0 +1,141 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "random_grid.hpp"
+#include "slab_decomposition.hpp"
+#include "step_kernel.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+// Workers in one process: a plane goes straight into the neighbour's mailbox
+class LocalTransport : public HaloTransport
+{
+public:
+    LocalTransport(std::vector<HaloMailbox> &mailboxes, size_t self) : mailboxes(mailboxes), self(self) {}
+
+    bool Send(HaloSide to, uint64_t step, std::vector<uint64_t> plane) override
+    {
+        const size_t n = mailboxes.size();
+        const size_t neighbour = to == HALO_SIDE_LOW ? (self + n - 1) % n : (self + 1) % n;
+        mailboxes[neighbour].Deliver(OppositeSide(to), step, std::move(plane));
+        return true;
+    }
+
+    tl::expected<std::vector<uint64_t>, std::string> Receive(HaloSide side, uint64_t step) override
+    {
+        return mailboxes[self].Take(side, step, std::chrono::seconds(10));
+    }
+
+    bool Flush() override
+    {
+        return true;
+    }
+
+private:
+    std::vector<HaloMailbox> &mailboxes;
+    const size_t self;
+};
+
+// Steps the grid with one thread per slab range and puts the slabs back together
+BitPackedGrid3D StepDecomposed(const BitPackedGrid3D &grid, const Bitset128 &rule, RuleMode rule_mode,
+                               uint64_t num_steps, size_t num_workers)
+{
+    const std::vector<SlabRange> ranges = PartitionSlabs(grid.x_max, num_workers);
+    const size_t slab_bits = grid.y_max * grid.z_max;
+    std::vector<HaloMailbox> mailboxes(num_workers);
+    std::vector<std::unique_ptr<SlabStepper>> steppers;
+    for (const SlabRange &range : ranges)
+    {
+        BitPackedGrid3D owned(range.slabs(), grid.y_max, grid.z_max);
+        CopyBits(grid.raw().data(), range.x_begin * slab_bits, owned.raw().data(), 0, range.slabs() * slab_bits);
+        steppers.push_back(std::make_unique<SlabStepper>(owned));
+    }
+
+    // Catch2 assertions aren't thread-safe, so failed workers come back as an empty grid
+    std::atomic<int> failures{0};
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < num_workers; ++i)
+        workers.emplace_back([&, i]
+                             {
+            ThreadPool pool(2);
+            LocalTransport transport(mailboxes, i);
+            if (!steppers[i]->Advance(rule, rule_mode, num_steps, transport, pool) || steppers[i]->step() != num_steps)
+                ++failures; });
+    for (std::thread &worker : workers)
+        worker.join();
+    if (failures != 0)
+        return BitPackedGrid3D(0, 0, 0);
+
+    BitPackedGrid3D result(grid.x_max, grid.y_max, grid.z_max);
+    for (size_t i = 0; i < num_workers; ++i)
+    {
+        const BitPackedGrid3D owned = steppers[i]->Owned();
+        CopyBits(owned.raw().data(), 0, result.raw().data(), ranges[i].x_begin * slab_bits, ranges[i].slabs() * slab_bits);
+    }
+    return result;
+}
+} // namespace
+
+TEST_CASE("Slab partitions cover the grid with near-equal ranges")
+{
+    const std::vector<SlabRange> ranges = PartitionSlabs(10, 4);
+    REQUIRE(ranges.size() == 4);
+    REQUIRE(ranges.front().x_begin == 0);
+    REQUIRE(ranges.back().x_end == 10);
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        REQUIRE((ranges[i].slabs() == 2 || ranges[i].slabs() == 3));
+        if (i > 0)
+            REQUIRE(ranges[i].x_begin == ranges[i - 1].x_end);
+    }
+}
+
+TEST_CASE("Slabs stepped by separate workers match the whole grid")
+{
+    // y * z = 35 cells per slab, so slabs and words don't line up
+    const BitPackedGrid3D grid = RandomGrid(23, 5, 7, 1);
+    for (RuleMode rule_mode : {RULE_1D_ECA, RULE_3D})
+    {
+        const Bitset128 rule = RandomRule(rule_mode == RULE_3D ? 2 : 3);
+        BitPackedGrid3D expected = grid;
+        BitPackedGrid3D scratch = grid;
+        for (int step = 0; step < 6; ++step)
+        {
+            StepGrid(expected, scratch, rule, rule_mode);
+            std::swap(expected, scratch);
+        }
+        // One worker is its own neighbour on both sides; 23 workers own a slab each
+        for (size_t num_workers : {1, 2, 3, 5, 23})
+            REQUIRE(StepDecomposed(grid, rule, rule_mode, 6, num_workers).raw() == expected.raw());
+    }
+}
+
+TEST_CASE("Slab workers match the whole grid on large word-aligned slabs")
+{
+    const BitPackedGrid3D grid = RandomGrid(16, 64, 64, 4);
+    const Bitset128 rule = RandomRule(5);
+    BitPackedGrid3D expected = grid;
+    BitPackedGrid3D scratch = grid;
+    for (int step = 0; step < 3; ++step)
+    {
+        StepGrid(expected, scratch, rule, RULE_3D);
+        std::swap(expected, scratch);
+    }
+    REQUIRE(StepDecomposed(grid, rule, RULE_3D, 3, 4).raw() == expected.raw());
+}
+
+TEST_CASE("Halo mailboxes hold early planes and time out on missing ones")
+{
+    HaloMailbox mailbox;
+    mailbox.Deliver(HALO_SIDE_HIGH, 1, std::vector<uint64_t>{7});
+    REQUIRE_FALSE(mailbox.Take(HALO_SIDE_HIGH, 0, std::chrono::milliseconds(1)).has_value());
+    REQUIRE_FALSE(mailbox.Take(HALO_SIDE_LOW, 1, std::chrono::milliseconds(1)).has_value());
+    auto plane = mailbox.Take(HALO_SIDE_HIGH, 1, std::chrono::milliseconds(1));
+    REQUIRE(plane.has_value());
+    REQUIRE(plane->size() == 1);
+    REQUIRE((*plane)[0] == 7);
+    // Taken planes are gone
+    REQUIRE_FALSE(mailbox.Take(HALO_SIDE_HIGH, 1, std::chrono::milliseconds(1)).has_value());
+}
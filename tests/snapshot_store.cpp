@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "snapshot_store.hpp"
+
+namespace
+{
+// Fresh directory under the system temp dir, removed again at the end of the test
+struct TempDirectory
+{
+    TempDirectory()
+        : path(std::filesystem::temp_directory_path() / ("snapshot_store_test_" + std::to_string(std::random_device()())))
+    {
+        std::filesystem::remove_all(path);
+    }
+    ~TempDirectory() { std::filesystem::remove_all(path); }
+    std::filesystem::path path;
+};
+
+BitPackedGrid3D PatternGrid(size_t x, size_t y, size_t z)
+{
+    BitPackedGrid3D grid(x, y, z);
+    for (size_t i = 0; i < grid.size_in_bits(); i += 7)
+        grid.set(i, true);
+    return grid;
+}
+} // namespace
+
+TEST_CASE("Snapshots round-trip and survive reopening the store")
+{
+    TempDirectory dir;
+    const BitPackedGrid3D grid = PatternGrid(13, 9, 5);
+    {
+        auto store = SnapshotStore::Open(dir.path.string());
+        REQUIRE(store.has_value());
+        REQUIRE((*store)->size() == 0);
+        REQUIRE_FALSE((*store)->max_id().has_value());
+
+        auto saved = (*store)->Save(7, Snapshot{grid, 42, RULE_3D, false});
+        REQUIRE(saved.has_value());
+        REQUIRE(*saved == 64 + grid.raw().size() * sizeof(uint64_t));
+        REQUIRE((*store)->Save(3, Snapshot{PatternGrid(8, 8, 8), 1, RULE_1D_ECA, true}).has_value());
+        // Saving again replaces the snapshot
+        REQUIRE((*store)->Save(7, Snapshot{grid, 43, RULE_3D, false}).has_value());
+    }
+
+    auto reopened = SnapshotStore::Open(dir.path.string());
+    REQUIRE(reopened.has_value());
+    SnapshotStore &store = **reopened;
+    REQUIRE(store.size() == 2);
+    REQUIRE(store.max_id() == 7);
+    REQUIRE(store.Contains(3));
+    REQUIRE_FALSE(store.Load(5).has_value());
+
+    auto loaded = store.Load(7);
+    REQUIRE(loaded.has_value());
+    REQUIRE(loaded->grid == grid);
+    REQUIRE(loaded->step == 43);
+    REQUIRE(loaded->rule_mode == RULE_3D);
+    REQUIRE_FALSE(loaded->hashlife);
+    REQUIRE(store.Load(3)->hashlife);
+
+    REQUIRE(store.Erase(3));
+    REQUIRE_FALSE(store.Erase(3));
+    REQUIRE_FALSE(std::filesystem::exists(dir.path / "3.snap"));
+}
+
+TEST_CASE("Corrupt or truncated snapshots are rejected")
+{
+    TempDirectory dir;
+    auto store = SnapshotStore::Open(dir.path.string());
+    REQUIRE(store.has_value());
+    REQUIRE((*store)->Save(1, Snapshot{PatternGrid(16, 4, 4), 0, RULE_1D_ECA, false}).has_value());
+    REQUIRE((*store)->Save(2, Snapshot{PatternGrid(16, 4, 4), 0, RULE_1D_ECA, false}).has_value());
+
+    {
+        // Flip a cell in the words
+        std::fstream file(dir.path / "1.snap", std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(64 + 3);
+        file.put('\x5a');
+    }
+    auto corrupt = (*store)->Load(1);
+    REQUIRE_FALSE(corrupt.has_value());
+    REQUIRE(corrupt.error().find("checksum") != std::string::npos);
+
+    std::filesystem::resize_file(dir.path / "2.snap", 64 + 8);
+    REQUIRE_FALSE((*store)->Load(2).has_value());
+}
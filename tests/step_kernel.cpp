@@ -0,0 +1,139 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+#include <array>
+#include "random_grid.hpp"
+#include "step_kernel.hpp"
+
+TEST_CASE("Word-parallel kernel matches the reference kernel")
+{
+    uint64_t seed = 42;
+    const std::vector<std::array<size_t, 3>> shapes = {
+        {100, 1, 1}, {257, 1, 1}, {8, 8, 8}, {3, 5, 7}, {17, 9, 13}, {5, 1, 70}, {6, 70, 1}, {2, 3, 130}, {1, 9, 9}, {4, 4, 4}, {3, 3, 3}};
+
+    for (const auto &[x, y, z] : shapes)
+    {
+        for (RuleMode mode : {RULE_1D_ECA, RULE_3D})
+        {
+            for (int trial = 0; trial < 3; ++trial)
+            {
+                const BitPackedGrid3D current = RandomGrid(x, y, z, seed++);
+                const Bitset128 rule = RandomRule(seed++);
+
+                BitPackedGrid3D expected(x, y, z);
+                StepGridReference(current, expected, rule, mode);
+                BitPackedGrid3D actual(x, y, z);
+                StepGrid(current, actual, rule, mode);
+
+                CAPTURE(x, y, z, mode, trial);
+                REQUIRE(actual == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("All available step backends produce identical results")
+{
+    uint64_t seed = 7;
+    const StepBackend original = ActiveStepBackend();
+    const std::vector<std::array<size_t, 3>> shapes = {{300, 1, 1}, {16, 16, 16}, {9, 11, 70}, {33, 65, 3}};
+
+    for (const auto &[x, y, z] : shapes)
+    {
+        for (RuleMode mode : {RULE_1D_ECA, RULE_3D})
+        {
+            const BitPackedGrid3D current = RandomGrid(x, y, z, seed++);
+            const Bitset128 rule = RandomRule(seed++);
+            BitPackedGrid3D expected(x, y, z);
+            StepGridReference(current, expected, rule, mode);
+
+            for (StepBackend backend : AvailableStepBackends())
+            {
+                REQUIRE(SetStepBackend(backend));
+                BitPackedGrid3D actual(x, y, z);
+                StepGrid(current, actual, rule, mode);
+                CAPTURE(x, y, z, mode, StepBackendName(backend));
+                REQUIRE(actual == expected);
+            }
+        }
+    }
+    SetStepBackend(original);
+}
+
+TEST_CASE("Brick layout kernel matches the row-major kernel")
+{
+    uint64_t seed = 11;
+    const std::vector<std::array<size_t, 3>> shapes = {{4, 4, 4}, {8, 4, 16}, {32, 8, 64}, {64, 64, 64}};
+
+    for (const auto &[x, y, z] : shapes)
+    {
+        for (RuleMode mode : {RULE_1D_ECA, RULE_3D})
+        {
+            const BitPackedGrid3D current = RandomGrid(x, y, z, seed++);
+            const Bitset128 rule = RandomRule(seed++);
+            BitPackedGrid3D expected(x, y, z);
+            StepGrid(current, expected, rule, mode);
+
+            const BitPackedGrid3D bricks = current.WithLayout(GRID_LAYOUT_BRICK);
+            BitPackedGrid3D actual(x, y, z, GRID_LAYOUT_BRICK);
+            StepGrid(bricks, actual, rule, mode);
+            BitPackedGrid3D reference(x, y, z, GRID_LAYOUT_BRICK);
+            StepGridReference(bricks, reference, rule, mode);
+
+            CAPTURE(x, y, z, mode);
+            REQUIRE(actual.layout() == GRID_LAYOUT_BRICK);
+            REQUIRE(actual.WithLayout(GRID_LAYOUT_ROW_MAJOR).raw() == expected.raw());
+            REQUIRE(reference == actual);
+        }
+    }
+}
+
+TEST_CASE("Rules that ignore neighbours step like the reference kernel")
+{
+    uint64_t seed = 5;
+    Bitset128 x_only;
+    Bitset128 identity;
+    Bitset128 negation;
+    for (size_t index = 0; index < 128; ++index)
+    {
+        x_only[index] = ((index >> 5) & 1) && !((index >> 4) & 1);
+        identity[index] = (index >> 6) & 1;
+        negation[index] = !((index >> 6) & 1);
+    }
+    const std::vector<Bitset128> rules = {Bitset128(), Bitset128().set(), x_only, identity, negation, build_from_eca(90)};
+    const std::vector<std::array<size_t, 3>> shapes = {{100, 1, 1}, {17, 9, 13}, {8, 8, 8}};
+
+    for (const auto &[x, y, z] : shapes)
+    {
+        for (GridLayout layout : {GRID_LAYOUT_ROW_MAJOR, GRID_LAYOUT_BRICK})
+        {
+            if (!BitPackedGrid3D::SupportsLayout(layout, x, y, z))
+                continue;
+            const BitPackedGrid3D current = RandomGrid(x, y, z, seed++).WithLayout(layout);
+            for (size_t r = 0; r < rules.size(); ++r)
+            {
+                for (RuleMode mode : {RULE_1D_ECA, RULE_3D})
+                {
+                    BitPackedGrid3D expected(x, y, z, layout);
+                    StepGridReference(current, expected, rules[r], mode);
+                    BitPackedGrid3D actual(x, y, z, layout);
+                    StepGrid(current, actual, rules[r], mode);
+
+                    CAPTURE(x, y, z, layout, r, mode);
+                    REQUIRE(actual.raw() == expected.raw());
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Word-parallel kernel reproduces elementary cellular automata")
+{
+    // Rule 90 from a single seed draws a Sierpinski triangle: after one step the seed's neighbours are live.
+    BitPackedGrid3D current(101, 1, 1);
+    current.set(50, 0, 0, true);
+    BitPackedGrid3D next(101, 1, 1);
+    StepGrid(current, next, build_from_eca(90), RULE_1D_ECA);
+
+    for (size_t x = 0; x < 101; ++x)
+        REQUIRE(next.get(x, 0, 0) == (x == 49 || x == 51));
+}
@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include "double_buffered_grid.hpp"
+#include "random_grid.hpp"
+#include "step_kernel.hpp"
+#include "temporal_blocking.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+BitPackedGrid3D StepPlainly(BitPackedGrid3D grid, const Bitset128 &rule, RuleMode mode, uint64_t num_steps)
+{
+    BitPackedGrid3D next(grid.x_max, grid.y_max, grid.z_max);
+    for (uint64_t step = 0; step < num_steps; ++step)
+    {
+        StepGrid(grid, next, rule, mode);
+        std::swap(grid, next);
+    }
+    return grid;
+}
+} // namespace
+
+TEST_CASE("Temporal blocking matches plain stepping")
+{
+    const Bitset128 rule = (Bitset128(0x0123456789abcdefULL) << 64) | Bitset128(0xfedcba9876543210ULL);
+    struct Case
+    {
+        size_t x, y, z;
+        TemporalBlockingPlan plan;
+        uint64_t num_steps;
+        RuleMode mode;
+    };
+    // Word-aligned and unaligned slabs, a shorter last tile, a halo wider than the grid, a single
+    // tile wrapping onto itself and a remainder pass shorter than the others
+    const Case cases[] = {
+        {20, 8, 8, {5, 4}, 11, RULE_3D},
+        {50, 4, 4, {4, 4}, 9, RULE_3D},
+        {37, 5, 7, {3, 64}, 7, RULE_3D},
+        {6, 8, 8, {9, 2}, 20, RULE_3D},
+        {300, 1, 1, {7, 64}, 23, RULE_1D_ECA},
+        {40, 3, 5, {6, 64}, 12, RULE_1D_ECA},
+    };
+
+    ThreadPool pool(3);
+    for (const Case &c : cases)
+    {
+        const BitPackedGrid3D initial = RandomGrid(c.x, c.y, c.z, static_cast<uint32_t>(c.x * 31 + c.y));
+        const BitPackedGrid3D expected = StepPlainly(initial, rule, c.mode, c.num_steps);
+
+        BitPackedGrid3D grid = initial;
+        BitPackedGrid3D scratch(0, 0, 0);
+        StepGridBlocked(grid, scratch, rule, c.mode, c.num_steps, c.plan, pool);
+        REQUIRE(grid == expected);
+
+        grid = initial;
+        StepGridBlocked(grid, scratch, rule, c.mode, c.num_steps, c.plan);
+        REQUIRE(grid == expected);
+    }
+}
+
+TEST_CASE("Temporal blocking plans only pay off for grids larger than the window")
+{
+    const BitPackedGrid3D grid(64, 32, 32); // 1 KiB slabs, 8 KiB in all
+
+    // 16 slabs per window: a halo of 2 slabs on either side leaves 12 for the tile
+    const TemporalBlockingPlan plan = PlanTemporalBlocking(grid, 100, 4096);
+    REQUIRE(plan.steps_per_pass == 2);
+    REQUIRE(plan.tile_slabs == 12);
+
+    REQUIRE(PlanTemporalBlocking(grid, 1, 4096).steps_per_pass == 1);
+    REQUIRE(PlanTemporalBlocking(grid, 100, 1 << 14).steps_per_pass == 1);
+    REQUIRE(PlanTemporalBlocking(BitPackedGrid3D(64, 32, 32, GRID_LAYOUT_BRICK), 100, 4096).steps_per_pass == 1);
+    // 512-byte slabs leave no room for a halo of two
+    REQUIRE(PlanTemporalBlocking(BitPackedGrid3D(64, 64, 64), 100, 4096).steps_per_pass == 1);
+}
+
+TEST_CASE("Advance matches single steps whether or not it blocks")
+{
+    const Bitset128 rule = (Bitset128(0x0123456789abcdefULL) << 64) | Bitset128(0xfedcba9876543210ULL);
+    // Larger than half the default window budget, so blocking takes over if the shared pool has threads
+    const BitPackedGrid3D initial = RandomGrid(160, 256, 128, 5);
+    REQUIRE(PlanTemporalBlocking(initial, 6).steps_per_pass > 1);
+
+    DoubleBufferedGrid blocked(initial);
+    DoubleBufferedGrid stepped(initial);
+    const ActiveStepStats stats = blocked.Advance(rule, RULE_3D, 6);
+    for (int step = 0; step < 6; ++step)
+        stepped.Step(rule, RULE_3D);
+    REQUIRE(blocked.front() == stepped.front());
+    REQUIRE(stats.blocks_computed + stats.blocks_skipped == 6 * NumActiveBlocks(initial));
+    REQUIRE(blocked.fingerprint() == FingerprintGrid(blocked.front()));
+
+    // Single steps after a blocked run start over with full change tracking
+    blocked.Step(rule, RULE_3D);
+    stepped.Step(rule, RULE_3D);
+    REQUIRE(blocked.front() == stepped.front());
+    REQUIRE(blocked.fingerprint() == stepped.fingerprint());
+}
@@ -0,0 +1,52 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "thread_pool.hpp"
+#include "step_kernel.hpp"
+
+TEST_CASE("ParallelFor visits every index exactly once")
+{
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> visits(10007);
+    // Uneven chunks: the first few are slow, so the other participants have to steal them
+    pool.ParallelFor(0, visits.size(), 64, [&](size_t begin, size_t end)
+                     {
+        if (begin < 256)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        for (size_t i = begin; i < end; ++i)
+            visits[i].fetch_add(1); });
+
+    for (const auto &count : visits)
+        REQUIRE(count.load() == 1);
+}
+
+TEST_CASE("Nested ParallelFor runs inline")
+{
+    ThreadPool pool(3);
+    std::atomic<size_t> total{0};
+    pool.ParallelFor(0, 8, 1, [&](size_t, size_t)
+                     { pool.ParallelFor(0, 100, 10, [&](size_t begin, size_t end)
+                                        { total.fetch_add(end - begin); }); });
+    REQUIRE(total.load() == 800);
+}
+
+TEST_CASE("Multi-threaded stepping matches a single thread")
+{
+    std::mt19937_64 gen(3);
+    BitPackedGrid3D current(95, 80, 71);
+    for (uint64_t &word : current.raw())
+        word = gen();
+    current.raw().back() &= (1ULL << (current.size_in_bits() % 64)) - 1; // padding bits stay zero
+    const Bitset128 rule = (Bitset128(gen()) << 64) | Bitset128(gen());
+
+    ThreadPool single(1);
+    ThreadPool many(5);
+    BitPackedGrid3D expected(95, 80, 71);
+    BitPackedGrid3D actual(95, 80, 71);
+    StepGrid(current, expected, rule, RULE_3D, single);
+    StepGrid(current, actual, rule, RULE_3D, many);
+    REQUIRE(actual == expected);
+}
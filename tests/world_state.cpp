@@ -1,6 +1,20 @@
 #include <catch2/catch_test_macros.hpp>
+#include "world_state.hpp"
 
 TEST_CASE("Basic sanity check")
 {
     REQUIRE(1 + 1 == 2);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Center cell grids match InitWorldState1D without allocating an id")
+{
+    WorldStateContainer container;
+    auto grid = MakeCenterCellGrid(9, 4, 5);
+    REQUIRE(grid);
+    REQUIRE(container.next_world_state_id == 0);
+    auto initial = container.InitWorldState1D(9, 4, 5);
+    REQUIRE(initial);
+    REQUIRE(std::get<1>(*initial) == *grid);
+    REQUIRE(grid->get(4, 2, 2));
+    REQUIRE(!MakeCenterCellGrid(3, 4, 5));
+}
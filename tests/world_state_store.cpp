@@ -0,0 +1,170 @@
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+#include "world_state_store.hpp"
+
+TEST_CASE("World state store finds and erases states")
+{
+    WorldStateStore store;
+    REQUIRE(store.Insert(7, BitPackedGrid3D(10, 10, 10), RULE_3D));
+    REQUIRE(store.size() == 1);
+
+    auto entry = store.Find(7);
+    REQUIRE(entry);
+    REQUIRE((*entry)->rule_mode == RULE_3D);
+    REQUIRE(!store.Find(8));
+
+    REQUIRE(store.Erase(7));
+    REQUIRE(!store.Erase(7));
+    REQUIRE(!store.Find(7));
+    REQUIRE(store.bytes() == 0);
+    // Handlers holding an erased entry can keep using it
+    REQUIRE((*entry)->state.front().x_max == 10);
+}
+
+TEST_CASE("World state store evicts the least recently used idle states")
+{
+    const size_t entry_bytes = WorldStateStore::EntryBytes(BitPackedGrid3D(64, 8, 8));
+    WorldStateStore store(3 * entry_bytes);
+    for (uint64_t id = 0; id < 3; ++id)
+        REQUIRE(store.Insert(id, BitPackedGrid3D(64, 8, 8), RULE_3D));
+
+    SECTION("oldest lookup goes first")
+    {
+        REQUIRE(store.Find(0)); // 1 is now the least recently used
+        REQUIRE(store.Insert(3, BitPackedGrid3D(64, 8, 8), RULE_3D));
+        CHECK(store.Find(0));
+        CHECK(!store.Find(1));
+        CHECK(store.Find(2));
+        CHECK(store.evictions() == 1);
+        CHECK(store.bytes() <= 3 * entry_bytes);
+    }
+
+    SECTION("evictions remember the step reached until the id is stored again")
+    {
+        (*store.Find(0))->step = 7;
+        REQUIRE(store.Find(1));
+        REQUIRE(store.Find(2));
+        REQUIRE(store.Insert(3, BitPackedGrid3D(64, 8, 8), RULE_3D));
+        REQUIRE(!store.Find(0));
+        REQUIRE(store.EvictedStep(0) == std::optional<size_t>(7));
+        CHECK(!store.EvictedStep(1));
+
+        REQUIRE(store.Insert(0, BitPackedGrid3D(64, 8, 8), RULE_3D));
+        CHECK(!store.EvictedStep(0));
+    }
+
+    SECTION("states in use are never evicted")
+    {
+        std::vector<std::shared_ptr<WorldStateEntry>> held;
+        for (uint64_t id = 0; id < 3; ++id)
+            held.push_back(*store.Find(id));
+        REQUIRE(!store.Insert(3, BitPackedGrid3D(64, 8, 8), RULE_3D));
+        CHECK(store.size() == 3);
+
+        held.pop_back(); // releases state 2
+        REQUIRE(store.Insert(3, BitPackedGrid3D(64, 8, 8), RULE_3D));
+        CHECK(!store.Find(2));
+    }
+
+    SECTION("replacing a state only needs room for the difference")
+    {
+        REQUIRE(store.Find(1)); // 0 is now the least recently used
+        REQUIRE(store.Insert(0, BitPackedGrid3D(64, 8, 8), RULE_3D));
+        CHECK(store.evictions() == 0);
+        CHECK(store.size() == 3);
+        CHECK(store.bytes() == 3 * entry_bytes);
+    }
+
+    SECTION("states larger than the budget are rejected")
+    {
+        REQUIRE(!store.Insert(3, BitPackedGrid3D(256, 64, 64), RULE_3D));
+        CHECK(store.size() == 3);
+    }
+}
+
+TEST_CASE("World state store replaces states larger than half its budget")
+{
+    const size_t entry_bytes = WorldStateStore::EntryBytes(BitPackedGrid3D(64, 64, 64));
+    WorldStateStore store(entry_bytes + entry_bytes / 2);
+    REQUIRE(store.Insert(0, BitPackedGrid3D(64, 64, 64), RULE_3D));
+    REQUIRE(store.Insert(0, BitPackedGrid3D(64, 64, 64), RULE_3D));
+    CHECK(store.size() == 1);
+    CHECK(store.bytes() == entry_bytes);
+}
+
+TEST_CASE("World state store only remembers the latest evictions")
+{
+    // Room for one state, so every insert evicts the previous one
+    WorldStateStore store(WorldStateStore::EntryBytes(BitPackedGrid3D(4, 4, 4)));
+    const uint64_t num_states = 2 * WorldStateStore::kNumShards * WorldStateStore::kEvictedStepsKept;
+    for (uint64_t id = 0; id < num_states; ++id)
+        REQUIRE(store.Insert(id, BitPackedGrid3D(4, 4, 4), RULE_3D));
+
+    REQUIRE(store.evictions() == num_states - 1);
+    REQUIRE(store.remembered_evictions() == WorldStateStore::kNumShards * WorldStateStore::kEvictedStepsKept);
+    REQUIRE(store.EvictedStep(num_states - 2));
+    REQUIRE(!store.EvictedStep(0));
+}
+
+TEST_CASE("World state store handles concurrent inserts and lookups")
+{
+    WorldStateStore store;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&store, t]
+                             {
+            for (uint64_t i = 0; i < 200; ++i)
+            {
+                const uint64_t id = t * 1000 + i;
+                store.Insert(id, BitPackedGrid3D(4, 4, 4), RULE_1D_ECA);
+                store.Find(id);
+                if (i % 2 == 0)
+                    store.Erase(id);
+            } });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    REQUIRE(store.size() == 400);
+    REQUIRE(store.bytes() == 400 * WorldStateStore::EntryBytes(BitPackedGrid3D(4, 4, 4)));
+}
+
+TEST_CASE("Stepped copies are only stored if the state wasn't stepped meanwhile")
+{
+    WorldStateStore store;
+    BitPackedGrid3D start(8, 8, 8);
+    start.set(1, 2, 3, true);
+    auto entry = *store.Insert(0, start, RULE_3D);
+    entry->step = 5;
+
+    // A stream copies the state at step 5 and steps the copy to 15
+    BitPackedGrid3D streamed = entry->state.front();
+    streamed.set(4, 4, 4, true);
+
+    SECTION("unchanged state takes the copy")
+    {
+        REQUIRE(StoreSteppedCopy(*entry, 5, streamed, 15));
+        CHECK(entry->step == 15);
+        CHECK(entry->state.front().get(4, 4, 4));
+    }
+
+    SECTION("a forward step during the stream wins")
+    {
+        Bitset128 rule;
+        entry->state.Advance(rule, RULE_3D, 1);
+        entry->step += 1;
+        REQUIRE(!StoreSteppedCopy(*entry, 5, streamed, 15));
+        CHECK(entry->step == 6);
+        CHECK(!entry->state.front().get(4, 4, 4));
+    }
+
+    SECTION("copies go back to the entry's layout")
+    {
+        auto bricked = *store.Insert(1, start.WithLayout(GRID_LAYOUT_BRICK), RULE_3D);
+        REQUIRE(StoreSteppedCopy(*bricked, 0, streamed, 10));
+        CHECK(bricked->state.front().layout() == GRID_LAYOUT_BRICK);
+        CHECK(bricked->state.front().get(4, 4, 4));
+    }
+}